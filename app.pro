@@ -60,16 +60,21 @@ INCLUDEPATH += \
 
 HEADERS += \
     src/QrCodeDecoder.h \
+    src/QrCodeFrameDecoder.h \
+    src/QrCodeImageDecoder.h \
+    src/QrCodeLuma.h \
     src/QrCodeScanner.h \
     src/YubiKey.h \
     src/YubiKeyAppSettings.h \
     src/YubiKeyAuth.h \
     src/YubiKeyAuthDataModel.h \
+    src/YubiKeyBackupReader.h \
     src/YubiKeyDefs.h \
     src/YubiKeyConstants.h \
     src/YubiKeyImportModel.h \
     src/YubiKeyIo.h \
     src/YubiKeyIoManager.h \
+    src/YubiKeyMigrationPayload.h \
     src/YubiKeyNdefHandler.h \
     src/YubiKeyNfcIo.h \
     src/YubiKeyOp.h \
@@ -77,6 +82,7 @@ HEADERS += \
     src/YubiKeyOpTracker.h \
     src/YubiKeyOtp.h \
     src/YubiKeyOtpListModel.h \
+    src/YubiKeyPeriodClock.h \
     src/YubiKeySettings.h \
     src/YubiKeyToken.h \
     src/YubiKeyTypes.h \
@@ -85,14 +91,19 @@ HEADERS += \
 SOURCES += \
     src/main.cpp \
     src/QrCodeDecoder.cpp \
+    src/QrCodeFrameDecoder.cpp \
+    src/QrCodeImageDecoder.cpp \
+    src/QrCodeLuma.cpp \
     src/QrCodeScanner.cpp \
     src/YubiKey.cpp \
     src/YubiKeyAppSettings.cpp \
     src/YubiKeyAuth.cpp \
     src/YubiKeyAuthDataModel.cpp \
+    src/YubiKeyBackupReader.cpp \
     src/YubiKeyImportModel.cpp \
     src/YubiKeyIo.cpp \
     src/YubiKeyIoManager.cpp \
+    src/YubiKeyMigrationPayload.cpp \
     src/YubiKeyNdefHandler.cpp \
     src/YubiKeyNfcIo.cpp \
     src/YubiKeyOp.cpp \
@@ -100,6 +111,7 @@ SOURCES += \
     src/YubiKeyOpTracker.cpp \
     src/YubiKeyOtp.cpp \
     src/YubiKeyOtpListModel.cpp \
+    src/YubiKeyPeriodClock.cpp \
     src/YubiKeySettings.cpp \
     src/YubiKeyToken.cpp \
     src/YubiKeyUtil.cpp
@@ -265,13 +277,11 @@ HEADERS += \
     $${HARBOUR_LIB_INCLUDE}/HarbourBase32.h \
     $${HARBOUR_LIB_INCLUDE}/HarbourDebug.h \
     $${HARBOUR_LIB_INCLUDE}/HarbourParentSignalQueueObject.h \
-    $${HARBOUR_LIB_INCLUDE}/HarbourProtoBuf.h \
     $${HARBOUR_LIB_INCLUDE}/HarbourSingleImageProvider.h \
     $${HARBOUR_LIB_INCLUDE}/HarbourUtil.h
 
 SOURCES += \
     $${HARBOUR_LIB_SRC}/HarbourBase32.cpp \
-    $${HARBOUR_LIB_SRC}/HarbourProtoBuf.cpp \
     $${HARBOUR_LIB_SRC}/HarbourSingleImageProvider.cpp \
     $${HARBOUR_LIB_SRC}/HarbourUtil.cpp
 
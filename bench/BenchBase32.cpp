@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "BenchBase32.h"
+#include "BenchAlloc.h"
+
+#include "YubiKeyUtil.h"
+
+#include "HarbourBase32.h"
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QUrl>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// ==========================================================================
+// BenchBase32::Private
+// ==========================================================================
+
+class BenchBase32::Private
+{
+public:
+    static const int DefaultIterations = 100000;
+
+    // Each case is measured for the old and the new way
+    enum Case {
+        CaseValidate,   // QML validates the secret on every keystroke
+        CaseDecodeText, // Secret typed into the edit dialog
+        CaseDecodeUri   // Secret from an otpauth URI
+    };
+
+    // Not only the way the secrets usually come. The results for all
+    // of these are compared between the old and the new way.
+    enum Shape {
+        ShapeUpper,     // Unpadded, upper case
+        ShapeLower,     // Unpadded, lower case
+        ShapeSpaced,    // Groups of 4 separated by spaces
+        ShapePadded,    // Upper case, padded with '='
+        ShapeTruncated  // Invalid length, the last group is cut short
+    };
+
+    struct Stat {
+        Stat() : iNanos(0), iAllocs(0), iResult(0) {}
+        qint64 iNanos;
+        quint64 iAllocs;
+        int iResult;    // Checksum of sorts, to compare the two
+    };
+
+    Private(int);
+
+    Stat measure(Case, bool, const QByteArray&);
+
+    static int before(Case, const QString&, const QByteArray&);
+    static int after(Case, const QString&, const QByteArray&);
+    static QByteArray secret(int, Shape);
+
+public:
+    const int iIterations;
+};
+
+BenchBase32::Private::Private(
+    int aIterations) :
+    iIterations(aIterations)
+{
+}
+
+/* static */
+int
+BenchBase32::Private::before(
+    Case aCase,
+    const QString& aText,
+    const QByteArray& aUtf8)
+{
+    switch (aCase) {
+    case CaseValidate:
+        return HarbourBase32::isValidBase32(aText);
+    case CaseDecodeText:
+        return HarbourBase32::isValidBase32(aText) ?
+            HarbourBase32::fromBase32(aText).size() : -1;
+    case CaseDecodeUri:
+        return HarbourBase32::fromBase32(QUrl::fromPercentEncoding(aUtf8)).
+            size();
+    }
+    return 0;
+}
+
+/* static */
+int
+BenchBase32::Private::after(
+    Case aCase,
+    const QString& aText,
+    const QByteArray& aUtf8)
+{
+    switch (aCase) {
+    case CaseValidate:
+        return YubiKeyUtil::isValidBase32(aText);
+    case CaseDecodeText:
+        {
+            const QByteArray bytes(YubiKeyUtil::fromBase32(aText));
+
+            return bytes.isEmpty() ? -1 : bytes.size();
+        }
+    case CaseDecodeUri:
+        return YubiKeyUtil::fromBase32(aUtf8).size();
+    }
+    return 0;
+}
+
+BenchBase32::Private::Stat
+BenchBase32::Private::measure(
+    Case aCase,
+    bool aNew,
+    const QByteArray& aSecret)
+{
+    // The string is created outside of the loop, the way it arrives
+    // from QML or from the URI parser
+    const QString text(QString::fromLatin1(aSecret));
+    const quint64 allocs = BenchAlloc::count();
+    QElapsedTimer timer;
+    Stat stat;
+
+    timer.start();
+    for (int i = 0; i < iIterations; i++) {
+        stat.iResult += aNew ? after(aCase, text, aSecret) :
+            before(aCase, text, aSecret);
+    }
+    stat.iNanos = timer.nsecsElapsed() / iIterations;
+    stat.iAllocs = (BenchAlloc::count() - allocs) / iIterations;
+    return stat;
+}
+
+/* static */
+QByteArray
+BenchBase32::Private::secret(
+    int aBytes,
+    Shape aShape)
+{
+    static const char upper[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+    static const char lower[] = "abcdefghijklmnopqrstuvwxyz234567";
+    const char* alphabet = (aShape == ShapeLower) ? lower : upper;
+    int len = (aBytes * 8 + 4) / 5;
+    QByteArray out;
+
+    if (aShape == ShapeTruncated) {
+        // No encoder leaves 1, 3 or 6 characters in the last group
+        static const int tails[] = { 1, 3, 6 };
+
+        len = (len / 8) * 8 + tails[(len / 8) % 3];
+    }
+
+    out.reserve(len + len / 4 + 8);
+    for (int i = 0; i < len; i++) {
+        if (aShape == ShapeSpaced && i && !(i % 4)) {
+            out.append(' ');
+        }
+        out.append(alphabet[qrand() % 32]);
+    }
+    if (aShape == ShapePadded) {
+        while (out.size() % 8) {
+            out.append('=');
+        }
+    }
+    return out;
+}
+
+// ==========================================================================
+// BenchBase32
+// ==========================================================================
+
+int
+BenchBase32::run(
+    int aArgc,
+    char* aArgv[])
+{
+    // base32 [ITERATIONS]
+    static const int sizes[] = { 10, 20, 32, 64 };
+    static const struct {
+        Private::Case value;
+        const char* name;
+    } cases[] = {
+        { Private::CaseValidate, "validate" },
+        { Private::CaseDecodeText, "decode text" },
+        { Private::CaseDecodeUri, "decode uri" }
+    };
+    static const struct {
+        Private::Shape value;
+        const char* name;
+    } shapes[] = {
+        { Private::ShapeUpper, "upper" },
+        { Private::ShapeLower, "lower" },
+        { Private::ShapeSpaced, "spaced" },
+        { Private::ShapePadded, "padded" },
+        { Private::ShapeTruncated, "truncated" }
+    };
+    const int iterations = (aArgc > 0) ? atoi(aArgv[0]) :
+        Private::DefaultIterations;
+    int mismatches = 0;
+
+    if (iterations <= 0) {
+        fprintf(stderr, "Invalid number of iterations\n");
+        return 2;
+    }
+
+    Private bench(iterations);
+
+    printf("%-12s %-9s %5s | %-23s | %-23s\n", "case", "input", "bytes",
+        "HarbourBase32 ns/allocs", "YubiKeyUtil ns/allocs");
+    for (uint i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+        for (uint j = 0; j < sizeof(shapes)/sizeof(shapes[0]); j++) {
+            for (uint k = 0; k < sizeof(sizes)/sizeof(sizes[0]); k++) {
+                const QByteArray secret(Private::secret(sizes[k],
+                    shapes[j].value));
+                const Private::Stat before(bench.measure(cases[i].value,
+                    false, secret));
+                const Private::Stat after(bench.measure(cases[i].value,
+                    true, secret));
+                const bool mismatch = (before.iResult != after.iResult);
+
+                printf("%-12s %-9s %5d | %14.1f %8llu | %14.1f %8llu%s\n",
+                    cases[i].name, shapes[j].name, sizes[k],
+                    (double)before.iNanos, (unsigned long long)before.iAllocs,
+                    (double)after.iNanos, (unsigned long long)after.iAllocs,
+                    mismatch ? " MISMATCH" : "");
+                if (mismatch) {
+                    mismatches++;
+                }
+            }
+        }
+    }
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "BenchImages.h"
+#include "BenchAlloc.h"
+
+#include "QrCodeFrameDecoder.h"
+#include "QrCodeImageDecoder.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFileInfo>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtGui/QImageReader>
+#include <QtMultimedia/QVideoFrame>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ==========================================================================
+// BenchImages::Private
+// ==========================================================================
+
+class BenchImages::Private
+{
+public:
+    // Same as the initial working resolution of the scanner
+    static const int DefaultWidth = 600;
+    static const int DefaultRepeat = 5;
+
+    struct Stat {
+        Stat() : iNanos(0), iAllocs(0), iOk(false), iWinner(-1) {}
+        qint64 iNanos;
+        quint64 iAllocs;
+        bool iOk;
+        int iWinner;    // Hypothesis which won the last pass
+    };
+
+    Private(int, int);
+
+    Stat scan(const QImage&, bool);
+    Stat import(const QImage&);
+    static QStringList imageFiles(const QDir&);
+    static const char* hypothesisName(int);
+
+public:
+    const int iWidth;
+    const int iRepeat;
+    QThreadPool iPool;
+    QrCodeFrameDecoder iDecoder;
+};
+
+BenchImages::Private::Private(
+    int aWidth,
+    int aRepeat) :
+    iWidth(aWidth),
+    iRepeat(aRepeat),
+    iDecoder(&iPool)
+{
+    // Same as the scanner's decoding pool
+    iPool.setMaxThreadCount(qMax(QThread::idealThreadCount(), 1));
+    iDecoder.allocate();
+}
+
+BenchImages::Private::Stat
+BenchImages::Private::scan(
+    const QImage& aImage,
+    bool aTracked)
+{
+    // What the scan thread does with a grabbed picture, through the same
+    // QrCodeFrameDecoder. Each pass starts over at the given working
+    // width with nothing tracked, i.e. it's the first picture of a scan.
+    // With aTracked, the picture is decoded once more after that and
+    // only the second pass (around the known location) is measured.
+    const QRect crop(QPoint(0, 0), aImage.size());
+    const QSet<QString> ignore;
+    QElapsedTimer timer;
+    quint64 allocs = 0;
+    int ok = 0;
+    Stat stat;
+
+    for (int i = 0; i < iRepeat; i++) {
+        iDecoder.reset(iWidth);
+        if (aTracked && !iDecoder.decode(aImage, QVideoFrame(), crop, 0,
+            ignore).isValid()) {
+            // Nothing to track
+            return stat;
+        }
+        iDecoder.clearStats();
+
+        const quint64 before = BenchAlloc::count();
+
+        timer.start();
+        if (iDecoder.decode(aImage, QVideoFrame(), crop, 0,
+            ignore).isValid()) {
+            ok++;
+        }
+        stat.iNanos += timer.nsecsElapsed();
+        allocs += BenchAlloc::count() - before;
+
+        const QrCodeFrameDecoder::Stats& stats = iDecoder.stats();
+        for (int k = 0; k < QrCodeFrameDecoder::HypothesisCount; k++) {
+            if (stats.iWins[k]) {
+                stat.iWinner = k;
+            }
+        }
+    }
+    stat.iOk = (ok == iRepeat);
+    stat.iNanos /= iRepeat;
+    stat.iAllocs = allocs / iRepeat;
+    return stat;
+}
+
+BenchImages::Private::Stat
+BenchImages::Private::import(
+    const QImage& aImage)
+{
+    // What the import page does with a picture file
+    const quint64 allocs = BenchAlloc::count();
+    QElapsedTimer timer;
+    Stat stat;
+
+    timer.start();
+    for (int i = 0; i < iRepeat; i++) {
+        stat.iOk = !QrCodeImageDecoder::decodeImage(aImage).isEmpty();
+    }
+    stat.iNanos = timer.nsecsElapsed() / iRepeat;
+    stat.iAllocs = (BenchAlloc::count() - allocs) / iRepeat;
+    return stat;
+}
+
+/* static */
+const char*
+BenchImages::Private::hypothesisName(
+    int aHypothesis)
+{
+    switch (aHypothesis) {
+    case QrCodeFrameDecoder::HypothesisScaled: return "scaled";
+    case QrCodeFrameDecoder::HypothesisNative: return "native";
+    case QrCodeFrameDecoder::HypothesisHalf: return "half";
+    case QrCodeFrameDecoder::HypothesisStretched: return "stretch";
+    case QrCodeFrameDecoder::HypothesisInverted: return "invert";
+    case QrCodeFrameDecoder::HypothesisTracked: return "tracked";
+    }
+    return "-";
+}
+
+/* static */
+QStringList
+BenchImages::Private::imageFiles(
+    const QDir& aDir)
+{
+    const QList<QByteArray> formats(QImageReader::supportedImageFormats());
+    QStringList filters;
+
+    for (int i = 0; i < formats.count(); i++) {
+        filters.append(QStringLiteral("*.") +
+            QString::fromLatin1(formats.at(i)));
+    }
+    return aDir.entryList(filters, QDir::Files | QDir::Readable, QDir::Name);
+}
+
+// ==========================================================================
+// BenchImages
+// ==========================================================================
+
+int
+BenchImages::run(
+    int aArgc,
+    char* aArgv[])
+{
+    // images DIR [WIDTH [REPEAT]]
+    if (aArgc < 1) {
+        fprintf(stderr, "Usage: images DIR [WIDTH [REPEAT]]\n");
+        return 2;
+    }
+
+    const QDir dir(QString::fromLocal8Bit(aArgv[0]));
+    const int width = (aArgc > 1) ? atoi(aArgv[1]) : Private::DefaultWidth;
+    const int repeat = (aArgc > 2) ? atoi(aArgv[2]) : Private::DefaultRepeat;
+    const QStringList files(Private::imageFiles(dir));
+
+    if (width <= 0 || repeat <= 0) {
+        fprintf(stderr, "Invalid width or repeat count\n");
+        return 2;
+    } else if (files.isEmpty()) {
+        fprintf(stderr, "No pictures in %s\n", aArgv[0]);
+        return 2;
+    }
+
+    // The governor makes it portrait 3:4
+    Private bench(width, repeat);
+    qint64 scanNanos = 0, importNanos = 0;
+    int scanOk = 0, importOk = 0, count = 0;
+
+    printf("%-32s %11s | %9s %3s %7s %-7s | %9s | %9s %3s %7s\n", "image",
+        "size", "scan ms", "ok", "allocs", "winner", "track ms",
+        "import ms", "ok", "allocs");
+    for (int i = 0; i < files.count(); i++) {
+        const QString path(dir.filePath(files.at(i)));
+        QImageReader reader(path);
+        const QImage image(reader.read());
+
+        if (image.isNull()) {
+            fprintf(stderr, "%s: %s\n", qPrintable(files.at(i)),
+                qPrintable(reader.errorString()));
+            continue;
+        }
+
+        const Private::Stat scan(bench.scan(image, false));
+        const Private::Stat track(bench.scan(image, true));
+        const Private::Stat import(bench.import(image));
+        const QByteArray size(QByteArray::number(image.width()) + 'x' +
+            QByteArray::number(image.height()));
+
+        printf("%-32s %11s | %9.2f %3s %7llu %-7s | ",
+            qPrintable(files.at(i)), size.constData(),
+            scan.iNanos / 1e6, scan.iOk ? "yes" : "no",
+            (unsigned long long)scan.iAllocs,
+            Private::hypothesisName(scan.iWinner));
+        if (track.iOk) {
+            printf("%9.2f | ", track.iNanos / 1e6);
+        } else {
+            printf("%9s | ", "-");
+        }
+        printf("%9.2f %3s %7llu\n", import.iNanos / 1e6,
+            import.iOk ? "yes" : "no", (unsigned long long)import.iAllocs);
+
+        count++;
+        scanNanos += scan.iNanos;
+        importNanos += import.iNanos;
+        if (scan.iOk) scanOk++;
+        if (import.iOk) importOk++;
+    }
+
+    if (count) {
+        printf("%d image(s), scan: %d%% ok, %.2f ms avg; "
+            "import: %d%% ok, %.2f ms avg\n", count,
+            scanOk * 100 / count, scanNanos / 1e6 / count,
+            importOk * 100 / count, importNanos / 1e6 / count);
+    }
+    return count ? 0 : 1;
+}
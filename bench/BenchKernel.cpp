@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "BenchKernel.h"
+#include "BenchAlloc.h"
+
+#include "QrCodeDecoder.h"
+#include "QrCodeLuma.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtGui/QImageReader>
+#include <QtGui/QTransform>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// ==========================================================================
+// BenchKernel::Private
+// ==========================================================================
+
+class BenchKernel::Private
+{
+public:
+    static const int DefaultWidth = 600;
+    static const int DefaultRepeat = 10;
+
+    struct Stat {
+        Stat() : iNanos(0), iDecodeNanos(0), iAllocs(0), iOk(false) {}
+        qint64 iNanos;          // Preprocessing only
+        qint64 iDecodeNanos;    // Preprocessing and decoding
+        quint64 iAllocs;
+        bool iOk;
+    };
+
+    Private(const QSize&, int);
+
+    Stat legacy(const QImage&, const QRect&, int);
+    Stat fused(const QImage&, const QRect&, int);
+
+    static QImage legacyChain(const QImage&, const QRect&, int, const QSize&);
+    static QRect cropRect(const QSize&, int);
+
+public:
+    const QSize iMaxSize;
+    const int iRepeat;
+    QrCodeDecoder iDecoder;
+    QImage iLumaPool;
+};
+
+BenchKernel::Private::Private(
+    const QSize& aMaxSize,
+    int aRepeat) :
+    iMaxSize(aMaxSize),
+    iRepeat(aRepeat),
+    iDecoder(QrCodeDecoder::ProfileQrCode)
+{
+}
+
+/* static */
+QRect
+BenchKernel::Private::cropRect(
+    const QSize& aSize,
+    int aRotation)
+{
+    // Viewfinder-like area in the middle of the (portrait) screenshot,
+    // mapped the same way as QrCodeScanner::Private::cropRect does it
+    const int w = aSize.width();
+    const int h = aSize.height();
+    const QRect viewFinder((aRotation % 180) ?
+        QRect(h / 8, w / 8, h * 3 / 4, w * 3 / 4) :
+        QRect(w / 8, h / 8, w * 3 / 4, h * 3 / 4));
+
+    switch (aRotation) {
+    case 90:
+        return QRect(w - viewFinder.bottom(), viewFinder.left(),
+            viewFinder.height(), viewFinder.width());
+    case 180:
+        return QRect(w - viewFinder.right(), h - viewFinder.bottom(),
+            viewFinder.width(), viewFinder.height());
+    case 270:
+        return QRect(viewFinder.top(), h - viewFinder.right(),
+            viewFinder.height(), viewFinder.width());
+    default:
+        return viewFinder;
+    }
+}
+
+/* static */
+QImage
+BenchKernel::Private::legacyChain(
+    const QImage& aImage,
+    const QRect& aCrop,
+    int aRotation,
+    const QSize& aMaxSize)
+{
+    // Crop, rotate, smooth downscale and convert, the way the scanner
+    // did it before QrCodeLuma. Y800 conversion happens in the decoder.
+    QImage image(aImage.copy(aCrop));
+
+    if (aRotation) {
+        image = image.transformed(QTransform().rotate(-aRotation));
+    }
+    if (image.width() > aMaxSize.width() ||
+        image.height() > aMaxSize.height()) {
+        const Qt::TransformationMode mode = Qt::SmoothTransformation;
+
+        if (aMaxSize.width() * image.height() >
+            aMaxSize.height() * image.width()) {
+            image = image.scaledToHeight(aMaxSize.height(), mode);
+        } else {
+            image = image.scaledToWidth(aMaxSize.width(), mode);
+        }
+    }
+    if (image.format() != QImage::Format_Grayscale8) {
+        image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    return image;
+}
+
+BenchKernel::Private::Stat
+BenchKernel::Private::legacy(
+    const QImage& aImage,
+    const QRect& aCrop,
+    int aRotation)
+{
+    const quint64 allocs = BenchAlloc::count();
+    QElapsedTimer timer;
+    Stat stat;
+
+    for (int i = 0; i < iRepeat; i++) {
+        timer.start();
+        const QImage image(legacyChain(aImage, aCrop, aRotation, iMaxSize));
+
+        stat.iNanos += timer.nsecsElapsed();
+        stat.iOk = iDecoder.decode(image).isValid();
+        stat.iDecodeNanos += timer.nsecsElapsed();
+    }
+    stat.iNanos /= iRepeat;
+    stat.iDecodeNanos /= iRepeat;
+    stat.iAllocs = (BenchAlloc::count() - allocs) / iRepeat;
+    return stat;
+}
+
+BenchKernel::Private::Stat
+BenchKernel::Private::fused(
+    const QImage& aImage,
+    const QRect& aCrop,
+    int aRotation)
+{
+    const quint64 allocs = BenchAlloc::count();
+    QElapsedTimer timer;
+    Stat stat;
+
+    for (int i = 0; i < iRepeat; i++) {
+        timer.start();
+        const QImage image(QrCodeLuma::extract(aImage, aCrop, aRotation,
+            iMaxSize, Q_NULLPTR, &iLumaPool));
+
+        stat.iNanos += timer.nsecsElapsed();
+        stat.iOk = iDecoder.decode(image).isValid();
+        stat.iDecodeNanos += timer.nsecsElapsed();
+    }
+    stat.iNanos /= iRepeat;
+    stat.iDecodeNanos /= iRepeat;
+    stat.iAllocs = (BenchAlloc::count() - allocs) / iRepeat;
+    return stat;
+}
+
+// ==========================================================================
+// BenchKernel
+// ==========================================================================
+
+int
+BenchKernel::run(
+    int aArgc,
+    char* aArgv[])
+{
+    // kernel DIR [WIDTH [REPEAT]]
+    if (aArgc < 1) {
+        fprintf(stderr, "Usage: kernel DIR [WIDTH [REPEAT]]\n");
+        return 2;
+    }
+
+    const QDir dir(QString::fromLocal8Bit(aArgv[0]));
+    const int width = (aArgc > 1) ? atoi(aArgv[1]) : Private::DefaultWidth;
+    const int repeat = (aArgc > 2) ? atoi(aArgv[2]) : Private::DefaultRepeat;
+    const QList<QByteArray> formats(QImageReader::supportedImageFormats());
+    QStringList filters;
+
+    if (width <= 0 || repeat <= 0) {
+        fprintf(stderr, "Invalid width or repeat count\n");
+        return 2;
+    }
+    for (int i = 0; i < formats.count(); i++) {
+        filters.append(QStringLiteral("*.") +
+            QString::fromLatin1(formats.at(i)));
+    }
+
+    const QStringList files(dir.entryList(filters, QDir::Files |
+        QDir::Readable, QDir::Name));
+    Private bench(QSize(width, width * 4 / 3), repeat);
+    qint64 legacyNanos = 0, fusedNanos = 0;
+    int legacyOk = 0, fusedOk = 0, count = 0;
+
+    printf("%-32s %3s | %-22s %7s | %-22s %7s\n", "image", "rot",
+        "legacy ms (+decode)", "allocs", "fused ms (+decode)", "allocs");
+    for (int i = 0; i < files.count(); i++) {
+        QImageReader reader(dir.filePath(files.at(i)));
+        QImage image(reader.read());
+
+        if (image.isNull()) {
+            fprintf(stderr, "%s: %s\n", qPrintable(files.at(i)),
+                qPrintable(reader.errorString()));
+            continue;
+        }
+
+        // Screenshots come in as RGB32
+        image = image.convertToFormat(QImage::Format_RGB32);
+        for (int rotation = 0; rotation < 360; rotation += 90) {
+            const QRect crop(Private::cropRect(image.size(), rotation));
+            const Private::Stat before(bench.legacy(image, crop, rotation));
+            const Private::Stat after(bench.fused(image, crop, rotation));
+
+            printf("%-32s %3d | %8.2f (%8.2f) %-3s %7llu | "
+                "%8.2f (%8.2f) %-3s %7llu\n", qPrintable(files.at(i)),
+                rotation, before.iNanos / 1e6, before.iDecodeNanos / 1e6,
+                before.iOk ? "ok" : "-", (unsigned long long)before.iAllocs,
+                after.iNanos / 1e6, after.iDecodeNanos / 1e6,
+                after.iOk ? "ok" : "-", (unsigned long long)after.iAllocs);
+
+            count++;
+            legacyNanos += before.iDecodeNanos;
+            fusedNanos += after.iDecodeNanos;
+            if (before.iOk) legacyOk++;
+            if (after.iOk) fusedOk++;
+        }
+    }
+
+    if (!count) {
+        fprintf(stderr, "No pictures in %s\n", aArgv[0]);
+        return 1;
+    }
+    printf("%d frame(s), legacy: %d ok, %.2f ms avg; "
+        "fused: %d ok, %.2f ms avg\n", count, legacyOk,
+        legacyNanos / 1e6 / count, fusedOk, fusedNanos / 1e6 / count);
+    return 0;
+}
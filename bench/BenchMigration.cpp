@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "BenchMigration.h"
+#include "BenchAlloc.h"
+
+#include "YubiKeyMigrationPayload.h"
+#include "YubiKeyToken.h"
+
+#include <QtCore/QElapsedTimer>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// ==========================================================================
+// BenchMigration::Private
+// ==========================================================================
+
+class BenchMigration::Private
+{
+public:
+    typedef YubiKeyMigrationPayload::OtpParameters OtpParameters;
+
+    static const int DefaultEntries = 5000;
+    static const int DefaultRepeat = 20;
+    static const int SecretSize = 20;
+
+    struct Stat {
+        Stat() : iNanos(0), iAllocs(0), iCount(0) {}
+        qint64 iNanos;
+        quint64 iAllocs;
+        int iCount;     // Entries per pass, must match the input
+    };
+
+    Private(int, int);
+
+    Stat measure(bool);
+
+    static void appendVarInt(QByteArray*, quint64);
+    static void appendDelimited(QByteArray*, uchar, const QByteArray&);
+    static void appendVarIntField(QByteArray*, uchar, quint64);
+    static QByteArray entry(int);
+    static QByteArray payload(int);
+
+public:
+    const int iEntries;
+    const int iRepeat;
+    const QByteArray iPayload;
+};
+
+BenchMigration::Private::Private(
+    int aEntries,
+    int aRepeat) :
+    iEntries(aEntries),
+    iRepeat(aRepeat),
+    iPayload(payload(aEntries))
+{
+}
+
+/* static */
+void
+BenchMigration::Private::appendVarInt(
+    QByteArray* aOut,
+    quint64 aValue)
+{
+    while (aValue >= 0x80) {
+        aOut->append((char)((aValue & 0x7f) | 0x80));
+        aValue >>= 7;
+    }
+    aOut->append((char)aValue);
+}
+
+/* static */
+void
+BenchMigration::Private::appendDelimited(
+    QByteArray* aOut,
+    uchar aTag,
+    const QByteArray& aValue)
+{
+    aOut->append((char)aTag);
+    appendVarInt(aOut, aValue.size());
+    aOut->append(aValue);
+}
+
+/* static */
+void
+BenchMigration::Private::appendVarIntField(
+    QByteArray* aOut,
+    uchar aTag,
+    quint64 aValue)
+{
+    aOut->append((char)aTag);
+    appendVarInt(aOut, aValue);
+}
+
+/* static */
+QByteArray
+BenchMigration::Private::entry(
+    int aIndex)
+{
+    // A mix of algorithms, digits and types, same as a real export
+    QByteArray secret;
+    QByteArray out;
+
+    secret.reserve(SecretSize);
+    for (int i = 0; i < SecretSize; i++) {
+        secret.append((char)qrand());
+    }
+
+    appendDelimited(&out, OtpParameters::SECRET_TAG, secret);
+    appendDelimited(&out, OtpParameters::NAME_TAG,
+        QString("user%1@example.com").arg(aIndex).toUtf8());
+    appendDelimited(&out, OtpParameters::ISSUER_TAG,
+        QString("Issuer %1").arg(aIndex % 100).toUtf8());
+    appendVarIntField(&out, OtpParameters::ALGORITHM_TAG,
+        OtpParameters::ALGORITHM_SHA1 + aIndex % 3);
+    appendVarIntField(&out, OtpParameters::DIGITS_TAG, (aIndex % 4) ?
+        OtpParameters::DIGIT_COUNT_SIX : OtpParameters::DIGIT_COUNT_EIGHT);
+    if (aIndex % 5) {
+        appendVarIntField(&out, OtpParameters::TYPE_TAG,
+            OtpParameters::OTP_TYPE_TOTP);
+    } else {
+        appendVarIntField(&out, OtpParameters::TYPE_TAG,
+            OtpParameters::OTP_TYPE_HOTP);
+        appendVarIntField(&out, OtpParameters::COUNTER_TAG, aIndex);
+    }
+    return out;
+}
+
+/* static */
+QByteArray
+BenchMigration::Private::payload(
+    int aEntries)
+{
+    QByteArray out;
+
+    for (int i = 0; i < aEntries; i++) {
+        appendDelimited(&out, OtpParameters::OTP_PARAMETERS_TAG, entry(i));
+    }
+    appendVarIntField(&out, OtpParameters::VERSION_TAG,
+        OtpParameters::VERSION);
+    appendVarIntField(&out, OtpParameters::BATCH_SIZE_TAG, 1);
+    appendVarIntField(&out, OtpParameters::BATCH_INDEX_TAG, 0);
+    appendVarIntField(&out, OtpParameters::BATCH_ID_TAG, 12345);
+    return out;
+}
+
+BenchMigration::Private::Stat
+BenchMigration::Private::measure(
+    bool aTokens)
+{
+    const quint64 allocs = BenchAlloc::count();
+    QElapsedTimer timer;
+    Stat stat;
+
+    timer.start();
+    for (int i = 0; i < iRepeat; i++) {
+        YubiKeyMigrationPayload payload;
+        QList<YubiKeyToken> tokens;
+
+        if (payload.parse(iPayload.constData(), iPayload.size())) {
+            const int n = payload.iOtpParameters.count();
+
+            if (aTokens) {
+                // Same conversion as YubiKeyImportModel::ModelData
+                tokens.reserve(n);
+                for (int k = 0; k < n; k++) {
+                    const OtpParameters* otp = &payload.iOtpParameters.at(k);
+
+                    tokens.append(YubiKeyToken(otp->yubiKeyTokenType(),
+                        otp->yubiKeyAlgorithm(),
+                        QString::fromUtf8((const char*) otp->iName.bytes,
+                            otp->iName.size),
+                        QString::fromUtf8((const char*) otp->iIssuer.bytes,
+                            otp->iIssuer.size),
+                        QByteArray((const char*) otp->iSecret.bytes,
+                            otp->iSecret.size),
+                        otp->numDigits(), otp->counter()));
+                }
+                stat.iCount = tokens.count();
+            } else {
+                stat.iCount = n;
+            }
+        }
+    }
+    stat.iNanos = timer.nsecsElapsed() / iRepeat;
+    stat.iAllocs = (BenchAlloc::count() - allocs) / iRepeat;
+    return stat;
+}
+
+// ==========================================================================
+// BenchMigration
+// ==========================================================================
+
+int
+BenchMigration::run(
+    int aArgc,
+    char* aArgv[])
+{
+    // migration [ENTRIES [REPEAT]]
+    const int entries = (aArgc > 0) ? atoi(aArgv[0]) :
+        Private::DefaultEntries;
+    const int repeat = (aArgc > 1) ? atoi(aArgv[1]) :
+        Private::DefaultRepeat;
+
+    if (entries <= 0 || repeat <= 0) {
+        fprintf(stderr, "Invalid number of entries or repeat count\n");
+        return 2;
+    }
+
+    Private bench(entries, repeat);
+    const double bytes = bench.iPayload.size();
+    const Private::Stat parse(bench.measure(false));
+    const Private::Stat tokens(bench.measure(true));
+    const bool mismatch = (parse.iCount != entries ||
+        tokens.iCount != entries);
+
+    printf("%d entries, %d bytes\n", entries, bench.iPayload.size());
+    printf("%-8s %10s %10s %12s %10s %10s\n", "case", "us/pass",
+        "MB/s", "entries/s", "allocs", "per entry");
+    printf("%-8s %10.1f %10.1f %12.0f %10llu %10.2f\n", "parse",
+        parse.iNanos / 1e3, bytes * 1e3 / parse.iNanos,
+        entries * 1e9 / parse.iNanos, (unsigned long long)parse.iAllocs,
+        (double)parse.iAllocs / entries);
+    printf("%-8s %10.1f %10.1f %12.0f %10llu %10.2f\n", "tokens",
+        tokens.iNanos / 1e3, bytes * 1e3 / tokens.iNanos,
+        entries * 1e9 / tokens.iNanos, (unsigned long long)tokens.iAllocs,
+        (double)tokens.iAllocs / entries);
+    if (mismatch) {
+        printf("MISMATCH: expected %d entries, got %d/%d\n", entries,
+            parse.iCount, tokens.iCount);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+# Headless benchmarks. Not built by default, enable with
+#
+#   qmake CONFIG+=yubikey_bench
+#
+# and run bench/harbour-yubikey-bench from the build directory.
+
+TEMPLATE = app
+TARGET = harbour-yubikey-bench
+CONFIG += console link_pkgconfig
+CONFIG -= app_bundle
+PKGCONFIG += glib-2.0 gobject-2.0
+QT += qml multimedia concurrent
+
+QMAKE_CXXFLAGS += -Wno-unused-parameter
+QMAKE_CFLAGS += -Wno-unused-parameter
+LIBS += -ldl
+
+CONFIG(debug, debug|release) {
+    DEFINES += DEBUG HARBOUR_DEBUG
+}
+
+equals(QT_ARCH, arm64){
+    PKGCONFIG += libcrypto
+}
+
+# Directories
+
+TOP_DIR = $${_PRO_FILE_PWD_}/..
+SRC_DIR = $${TOP_DIR}/src
+HARBOUR_LIB_DIR = $${TOP_DIR}/harbour-lib
+LIBGLIBUTIL_DIR = $${TOP_DIR}/libglibutil
+FOIL_DIR = $${TOP_DIR}/foil
+ZBAR_DIR = $${TOP_DIR}/zbar/zbar
+
+# Bench
+
+HEADERS += \
+    BenchAlloc.h \
+    BenchBase32.h \
+    BenchImages.h \
+    BenchKernel.h \
+    BenchMigration.h
+
+SOURCES += \
+    BenchAlloc.cpp \
+    BenchBase32.cpp \
+    BenchImages.cpp \
+    BenchKernel.cpp \
+    BenchMigration.cpp \
+    main.cpp
+
+# App
+
+INCLUDEPATH += \
+    $${SRC_DIR}
+
+HEADERS += \
+    $${SRC_DIR}/QrCodeDecoder.h \
+    $${SRC_DIR}/QrCodeFrameDecoder.h \
+    $${SRC_DIR}/QrCodeImageDecoder.h \
+    $${SRC_DIR}/QrCodeLuma.h \
+    $${SRC_DIR}/YubiKeyMigrationPayload.h \
+    $${SRC_DIR}/YubiKeyToken.h \
+    $${SRC_DIR}/YubiKeyUtil.h
+
+SOURCES += \
+    $${SRC_DIR}/QrCodeDecoder.cpp \
+    $${SRC_DIR}/QrCodeFrameDecoder.cpp \
+    $${SRC_DIR}/QrCodeImageDecoder.cpp \
+    $${SRC_DIR}/QrCodeLuma.cpp \
+    $${SRC_DIR}/YubiKeyMigrationPayload.cpp \
+    $${SRC_DIR}/YubiKeyToken.cpp \
+    $${SRC_DIR}/YubiKeyUtil.cpp
+
+# libfoil
+
+LIBFOIL_DIR = $${FOIL_DIR}/libfoil
+LIBFOIL_INCLUDE = $${LIBFOIL_DIR}/include
+LIBFOIL_SRC = $${LIBFOIL_DIR}/src
+LIBFOIL_OPENSSL_SRC = $${LIBFOIL_SRC}/openssl
+
+INCLUDEPATH += \
+    $${LIBFOIL_INCLUDE} \
+    $${LIBFOIL_SRC}
+
+SOURCES += \
+    $${LIBFOIL_SRC}/foil_digest.c \
+    $${LIBFOIL_SRC}/foil_digest_sha1.c \
+    $${LIBFOIL_SRC}/foil_digest_sha256.c \
+    $${LIBFOIL_SRC}/foil_digest_sha512.c \
+    $${LIBFOIL_SRC}/foil_input.c \
+    $${LIBFOIL_SRC}/foil_input_mem.c \
+    $${LIBFOIL_SRC}/foil_output.c \
+    $${LIBFOIL_SRC}/foil_random.c \
+    $${LIBFOIL_SRC}/foil_util.c \
+    $${LIBFOIL_OPENSSL_SRC}/foil_openssl_digest_sha1.c \
+    $${LIBFOIL_OPENSSL_SRC}/foil_openssl_digest_sha256.c \
+    $${LIBFOIL_OPENSSL_SRC}/foil_openssl_digest_sha512.c \
+    $${LIBFOIL_OPENSSL_SRC}/foil_openssl_random.c
+
+# libglibutil
+
+LIBGLIBUTIL_SRC = $${LIBGLIBUTIL_DIR}/src
+LIBGLIBUTIL_INCLUDE = $${LIBGLIBUTIL_DIR}/include
+
+INCLUDEPATH += \
+    $${LIBGLIBUTIL_INCLUDE}
+
+SOURCES += \
+    $${LIBGLIBUTIL_SRC}/gutil_log.c \
+    $${LIBGLIBUTIL_SRC}/gutil_misc.c \
+    $${LIBGLIBUTIL_SRC}/gutil_strv.c
+
+# harbour-lib
+
+HARBOUR_LIB_INCLUDE = $${HARBOUR_LIB_DIR}/include
+HARBOUR_LIB_SRC = $${HARBOUR_LIB_DIR}/src
+
+INCLUDEPATH += \
+    $${HARBOUR_LIB_INCLUDE}
+
+HEADERS += \
+    $${HARBOUR_LIB_INCLUDE}/HarbourBase32.h \
+    $${HARBOUR_LIB_INCLUDE}/HarbourUtil.h
+
+SOURCES += \
+    $${HARBOUR_LIB_SRC}/HarbourBase32.cpp \
+    $${HARBOUR_LIB_SRC}/HarbourUtil.cpp
+
+!equals(QT_ARCH, arm64){
+SOURCES += \
+    $${HARBOUR_LIB_SRC}/libcrypto.c
+}
+
+# zbar
+
+INCLUDEPATH += \
+    $${ZBAR_DIR}/include \
+    $${ZBAR_DIR}/zbar
+
+LIBS += ../zbar/libzbar.a
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "BenchBase32.h"
+#include "BenchImages.h"
+#include "BenchKernel.h"
+#include "BenchMigration.h"
+
+#include <QtCore/QCoreApplication>
+
+#include <stdio.h>
+#include <string.h>
+
+// Headless benchmarks, no camera or display is needed
+static int usage(const char* aName)
+{
+    fprintf(stderr, "Usage: %s images DIR [WIDTH [REPEAT]]\n"
+        "       %s kernel DIR [WIDTH [REPEAT]]\n"
+        "       %s base32 [ITERATIONS]\n"
+        "       %s migration [ENTRIES [REPEAT]]\n", aName, aName, aName,
+        aName);
+    return 2;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    if (argc > 1 && !strcmp(argv[1], "images")) {
+        return BenchImages::run(argc - 2, argv + 2);
+    } else if (argc > 1 && !strcmp(argv[1], "kernel")) {
+        return BenchKernel::run(argc - 2, argv + 2);
+    } else if (argc > 1 && !strcmp(argv[1], "base32")) {
+        return BenchBase32::run(argc - 2, argv + 2);
+    } else if (argc > 1 && !strcmp(argv[1], "migration")) {
+        return BenchMigration::run(argc - 2, argv + 2);
+    }
+    return usage(argv[0]);
+}
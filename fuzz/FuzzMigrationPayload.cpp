@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "YubiKeyMigrationPayload.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// libFuzzer entry point for the otpauth-migration payload parser. Every
+// entry which gets through must be valid and must point inside the input,
+// which is what the sanitizers need to see to catch an overrun.
+
+static
+uint
+fuzz_check_view(
+    const GUtilData* aView,
+    const uint8_t* aData,
+    size_t aSize)
+{
+    uint sum = 0;
+
+    if (aView->size) {
+        if (aView->bytes < aData || aView->size > aSize ||
+            aView->bytes + aView->size > aData + aSize) {
+            abort();
+        }
+        for (gsize i = 0; i < aView->size; i++) {
+            sum += aView->bytes[i];
+        }
+    }
+    return sum;
+}
+
+extern "C"
+int
+LLVMFuzzerTestOneInput(
+    const uint8_t* aData,
+    size_t aSize)
+{
+    YubiKeyMigrationPayload payload;
+    const bool complete = payload.parse(aData, aSize);
+    const int n = payload.iOtpParameters.count();
+    volatile uint sum = 0;
+
+    if (complete != payload.iComplete ||
+        (payload.hasValidBatch() && !complete)) {
+        abort();
+    }
+    for (int i = 0; i < n; i++) {
+        const YubiKeyMigrationPayload::OtpParameters* otp =
+            &payload.iOtpParameters.at(i);
+
+        if (!otp->isValid() || !otp->numDigits() || otp->counter() < 0 ||
+            otp->yubiKeyAlgorithm() == YubiKeyAlgorithm_Unknown ||
+            otp->yubiKeyTokenType() == YubiKeyTokenType_Unknown) {
+            abort();
+        }
+        sum += fuzz_check_view(&otp->iSecret, aData, aSize);
+        sum += fuzz_check_view(&otp->iName, aData, aSize);
+        sum += fuzz_check_view(&otp->iIssuer, aData, aSize);
+    }
+    return 0;
+}
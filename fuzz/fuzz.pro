@@ -0,0 +1,40 @@
+# libFuzzer target for the otpauth-migration payload parser. Not built by
+# default, requires clang. Enable with
+#
+#   qmake CONFIG+=yubikey_fuzz QMAKE_CC=clang QMAKE_CXX=clang++ \
+#       QMAKE_LINK=clang++
+#
+# and run fuzz/harbour-yubikey-fuzz-migration [CORPUS_DIR] from the
+# build directory.
+
+TEMPLATE = app
+TARGET = harbour-yubikey-fuzz-migration
+CONFIG += console link_pkgconfig
+CONFIG -= app_bundle
+PKGCONFIG += glib-2.0
+QT = core
+
+FUZZ_FLAGS = -g -O1 -fno-omit-frame-pointer \
+    -fsanitize=fuzzer,address,undefined
+
+QMAKE_CXXFLAGS += $${FUZZ_FLAGS}
+QMAKE_LFLAGS += $${FUZZ_FLAGS}
+
+# Directories
+
+TOP_DIR = $${_PRO_FILE_PWD_}/..
+SRC_DIR = $${TOP_DIR}/src
+HARBOUR_LIB_DIR = $${TOP_DIR}/harbour-lib
+LIBGLIBUTIL_DIR = $${TOP_DIR}/libglibutil
+
+INCLUDEPATH += \
+    $${SRC_DIR} \
+    $${HARBOUR_LIB_DIR}/include \
+    $${LIBGLIBUTIL_DIR}/include
+
+HEADERS += \
+    $${SRC_DIR}/YubiKeyMigrationPayload.h
+
+SOURCES += \
+    FuzzMigrationPayload.cpp \
+    $${SRC_DIR}/YubiKeyMigrationPayload.cpp
@@ -7,4 +7,15 @@ app.depends = zbar-target
 zbar.file = zbar/zbar.pro
 zbar.target = zbar-target
 
+CONFIG(yubikey_bench) {
+    SUBDIRS += bench
+    bench.file = bench/bench.pro
+    bench.depends = zbar-target
+}
+
+CONFIG(yubikey_fuzz) {
+    SUBDIRS += fuzz
+    fuzz.file = fuzz/fuzz.pro
+}
+
 OTHER_FILES += LICENSE README.md rpm/*.spec
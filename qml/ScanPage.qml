@@ -2,6 +2,7 @@ import QtQuick 2.0
 import QtMultimedia 5.4
 import Sailfish.Silica 1.0
 import Sailfish.Media 1.0
+import Sailfish.Pickers 1.0
 import org.nemomobile.notifications 1.0
 import org.nemomobile.policy 1.0
 import harbour.yubikey 1.0
@@ -75,32 +76,79 @@ Page {
 
     YubiKeyImportModel {
         id: importModel
+
+        // Row count after the previous parse
+        property int parsedCount
+
+        // URIs are parsed asynchronously
+        onParsingFinished: {
+            var added = count > parsedCount
+            parsedCount = count
+            if (added) {
+                unsupportedCodeNotification.close()
+                if (!missingBatchCount) {
+                    // Multi-part exports are collected until all parts are there
+                    hideMarkTimer.stop()
+                    scanner.stop()
+                    pageStackPopTimer.start()
+                }
+            } else {
+                unsupportedCodeNotification.publish()
+            }
+        }
     }
 
     QrCodeScanner {
         id: scanner
 
-        property string lastInvalidCode
         viewFinderItem: viewFinderContainer
+        videoOutput: _viewFinder
         rotation: orientationAngle()
+        continuous: true
 
-        onScanFinished: {
-            importModel.otpUri = result.text
-            if (importModel.count > 0) {
-                markImageProvider.image = image
-                markImage.visible = true
-                unsupportedCodeNotification.close()
-                pageStackPopTimer.start()
-            } else if (lastInvalidCode !== result.text) {
-                lastInvalidCode = result.text
-                markImageProvider.image = image
-                markImage.visible = true
-                unsupportedCodeNotification.publish()
-                restartScanTimer.start()
+        // Continuous scan reports each code with codeDetected. It never
+        // finishes with a valid result, and stop() doesn't finish it at all.
+        onCodeDetected: addCode(result.text, image)
+
+        function addCode(text, image) {
+            importModel.otpUris = importModel.otpUris.concat(text)
+            markImageProvider.image = image
+            markImage.visible = true
+            hideMarkTimer.restart()
+        }
+    }
+
+    QrCodeImageDecoder {
+        id: imageDecoder
+
+        onDecodeFinished: {
+            if (results.length) {
+                // Replaces whatever has been scanned
+                importModel.parsedCount = 0
+                importModel.otpUris = results
             } else {
-                if (thisPage.canScan) {
-                    scanner.start()
-                }
+                unsupportedCodeNotification.publish()
+            }
+        }
+    }
+
+    Component {
+        id: imagePickerComponent
+
+        ImagePickerPage {
+            onSelectedContentPropertiesChanged: imageDecoder.decodeFile(selectedContentProperties.filePath)
+        }
+    }
+
+    Component {
+        id: backupPickerComponent
+
+        FilePickerPage {
+            nameFilters: [ "*.txt", "*.json" ]
+            onSelectedContentPropertiesChanged: {
+                // Replaces whatever has been scanned
+                importModel.parsedCount = 0
+                importModel.importFile(selectedContentProperties.filePath)
             }
         }
     }
@@ -120,15 +168,12 @@ Page {
     }
 
     Timer {
-        id: restartScanTimer
+        id: hideMarkTimer
 
         interval:  1000
         onTriggered: {
             markImage.visible = false
             markImageProvider.clear()
-            if (thisPage.canScan) {
-                scanner.start()
-            }
         }
     }
 
@@ -163,9 +208,41 @@ Page {
         fontSizeMode: Text.Fit
         verticalAlignment: Text.AlignVCenter
 
-        //: Page title (suggestion to scan QR code)
-        //% "Scan QR code"
-        text: qsTrId("yubikey-scan-title")
+        text: importModel.missingBatchCount ?
+            //: Page title (progress of scanning a multi-part export)
+            //% "Scanned %1 of %2"
+            qsTrId("yubikey-scan-batch_progress")
+                .arg(importModel.batchCount - importModel.missingBatchCount)
+                .arg(importModel.batchCount) :
+            //: Page title (suggestion to scan QR code)
+            //% "Scan QR code"
+            qsTrId("yubikey-scan-title")
+    }
+
+    Row {
+        anchors {
+            right: parent.right
+            rightMargin: Theme.horizontalPageMargin
+            verticalCenter: titleLabel.verticalCenter
+        }
+
+        IconButton {
+            icon.source: "image://theme/icon-m-document"
+            enabled: !imageDecoder.busy && !importModel.parsing
+            onClicked: pageStack.push(backupPickerComponent)
+        }
+
+        IconButton {
+            icon.source: "image://theme/icon-m-image"
+            enabled: !imageDecoder.busy && !importModel.parsing
+            onClicked: pageStack.push(imagePickerComponent)
+        }
+    }
+
+    BusyIndicator {
+        anchors.centerIn: parent
+        size: BusyIndicatorSize.Large
+        running: imageDecoder.busy || importModel.parsing
     }
 
     Item {
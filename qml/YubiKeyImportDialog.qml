@@ -10,7 +10,6 @@ Dialog {
     canAccept: model && model.haveSelectedTokens
 
     property alias model: list.model
-    readonly property var selectedTokens: model.selectedTokens
 
     readonly property color _selectionBackground: Theme.rgba(Theme.highlightBackgroundColor, 0.1)
 
@@ -68,7 +67,15 @@ Dialog {
                     color: Theme.secondaryHighlightColor
                     truncationMode: TruncationMode.Fade
                     font.pixelSize: Theme.fontSizeExtraSmall
-                    text: model.type === YubiKey.TypeTOTP ? "TOTP" : "HOTP"
+                    text: (model.type === YubiKey.TypeTOTP ? "TOTP" : "HOTP") +
+                        (model.duplicate === YubiKeyImportModel.DuplicateOnYubiKey ?
+                            //: Import list item suffix (a token with this name is already on the YubiKey)
+                            //% "already on YubiKey"
+                            " \u2022 " + qsTrId("yubikey-select_dialog-duplicate_on_yubikey") :
+                        model.duplicate === YubiKeyImportModel.DuplicateInList ?
+                            //: Import list item suffix (another token in the list has the same name)
+                            //% "duplicate name"
+                            " \u2022 " + qsTrId("yubikey-select_dialog-duplicate_in_list") : "")
                 }
             }
 
@@ -14,7 +14,7 @@ Page {
     property string yubiKeyFirmware
 
     readonly property bool yubiKeyPresent: yubiKey.present
-    readonly property int totpTimeLeft: yubiKey.totpTimeLeft
+    readonly property real totpTimeLeft: yubiKey.totpTimeLeft
     readonly property string favoriteName: otpListModel.favoriteName
     readonly property int favoriteTokenType: otpListModel.favoriteTokenType
     readonly property string favoritePassword: otpListModel.favoritePassword
@@ -242,6 +242,8 @@ Page {
     }
 
     function _putTokens(model) {
+        // Tokens which would collide with the existing ones get flagged
+        model.yubiKey = yubiKey
         var dialog = pageStack.push("YubiKeyImportDialog.qml", {
             "allowedOrientations": allowedOrientations,
             "model": model,
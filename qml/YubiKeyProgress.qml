@@ -7,7 +7,7 @@ ShaderEffectSource {
 
     property bool busy
     property real timeLeft
-    property real progressValue: 1.0 - timeLeft / YubiKey.TotpPeriod
+    property real progressValue: 1.0 - _timeLeft / YubiKey.TotpPeriod
     property real busyProgress: invertColors ? 0.75 : 0.25
     property color backgroundColor: "transparent"
     property color progressColor: "#f8bc56"
@@ -16,6 +16,38 @@ ShaderEffectSource {
     property bool active: opacity > 0 && visible && Qt.application.active
     readonly property int imageMargins: 2 * Theme.paddingSmall
 
+    // timeLeft only changes when the countdown starts or stops,
+    // the countdown itself is animated
+    property real _timeLeft
+    property real _endTime
+
+    onTimeLeftChanged: _startCountdown()
+    onActiveChanged: _updateCountdown()
+    Component.onCompleted: _startCountdown()
+
+    function _startCountdown() {
+        _endTime = Date.now() + timeLeft * 1000
+        _updateCountdown()
+    }
+
+    function _updateCountdown() {
+        countdown.stop()
+        var msecsLeft = Math.max(_endTime - Date.now(), 0)
+        _timeLeft = msecsLeft / 1000
+        if (active && msecsLeft > 0) {
+            countdown.duration = msecsLeft
+            countdown.start()
+        }
+    }
+
+    NumberAnimation {
+        id: countdown
+
+        target: thisItem
+        property: "_timeLeft"
+        to: 0
+    }
+
     width: Theme.iconSizeExtraLarge + 2 * imageMargins
     height: Theme.iconSizeExtraLarge + 2 * imageMargins
 
@@ -47,7 +79,7 @@ ShaderEffectSource {
             }
 
             Behavior on value {
-                enabled: active
+                enabled: active && !countdown.running
                 NumberAnimation { duration: 500 }
             }
         }
@@ -40,7 +40,7 @@ YubiKeyWaitPage {
             var op = yubiKey.getOp(opIds[_currentOp])
             if (op) {
                 tracker.op = op
-                progressValue = busyProgress + _currentOp * (1 - busyProgress) / opIds.length
+                _updateProgress()
                 return true
             }
         }
@@ -48,12 +48,24 @@ YubiKeyWaitPage {
         return false
     }
 
+    function _updateProgress() {
+        // Batch ops report their own progress
+        var op = tracker.op
+        var opProgress = op ? op.opProgress / op.opCount : 0
+        progressValue = busyProgress + (_currentOp + opProgress) * (1 - busyProgress) / opIds.length
+    }
+
     function _cancelRemainingOps() {
         for (_currentOp++; _currentOp < opIds.length; _currentOp++) {
             yubiKey.cancelOp(opIds[_currentOp])
         }
     }
 
+    Connections {
+        target: tracker.op
+        onOpProgressChanged: _updateProgress()
+    }
+
     YubiKeyOpTracker {
         id: tracker
 
@@ -149,17 +149,39 @@ QrCodeDecoder::Result::getFormatName() const
 class QrCodeDecoder::Private
 {
 public:
-    Private();
+    Private(Profile aProfile);
     ~Private();
 
+    QImage packedLuma(const QImage&);
+    QList<Result> scan(const QImage&, bool);
+
 public:
+    const Profile iProfile;
     zbar::ImageScanner* iReader;
+    zbar::Image iImage;
+    QImage iLuma;
 };
 
-QrCodeDecoder::Private::Private() :
-    iReader(new zbar::ImageScanner)
+QrCodeDecoder::Private::Private(
+    Profile aProfile) :
+    iProfile(aProfile),
+    iReader(new zbar::ImageScanner),
+    iImage(0, 0, "Y800")
 {
-    iReader->set_config(zbar::ZBAR_NONE, zbar::ZBAR_CFG_ENABLE, 1);
+    switch (aProfile) {
+    case ProfileQrCode:
+        iReader->set_config(zbar::ZBAR_NONE, zbar::ZBAR_CFG_ENABLE, 0);
+        iReader->set_config(zbar::ZBAR_QRCODE, zbar::ZBAR_CFG_ENABLE, 1);
+        // The QR finder pattern is at least 7 modules tall and wide.
+        // Scanning every other row and column still finds it in the
+        // downscaled pictures and takes half the time.
+        iReader->set_config(zbar::ZBAR_NONE, zbar::ZBAR_CFG_X_DENSITY, 2);
+        iReader->set_config(zbar::ZBAR_NONE, zbar::ZBAR_CFG_Y_DENSITY, 2);
+        break;
+    case ProfileAll:
+        iReader->set_config(zbar::ZBAR_NONE, zbar::ZBAR_CFG_ENABLE, 1);
+        break;
+    }
 }
 
 QrCodeDecoder::Private::~Private()
@@ -167,33 +189,58 @@ QrCodeDecoder::Private::~Private()
     delete iReader;
 }
 
-// ==========================================================================
-// QrCodeDecoder
-// ==========================================================================
-
-QrCodeDecoder::QrCodeDecoder() :
-    iPrivate(new Private)
+QImage
+QrCodeDecoder::Private::packedLuma(
+    const QImage& aImage)
 {
-    qRegisterMetaType<Result>();
-}
+    // zbar wants Y800 without any padding at the end of the lines
+    const int w = aImage.width();
+    const int h = aImage.height();
 
-QrCodeDecoder::~QrCodeDecoder()
-{
-    delete iPrivate;
+    if (aImage.bytesPerLine() == w) {
+        return aImage;
+    }
+
+    // Reuse the buffer if nobody else is using it
+    if (iLuma.width() != w || iLuma.height() != h || !iLuma.isDetached()) {
+        iLuma = QImage(w, h, QImage::Format_Grayscale8);
+    }
+
+    uchar* dest = iLuma.bits();
+    for (int y = 0; y < h; y++, dest += w) {
+        memcpy(dest, aImage.constScanLine(y), w);
+    }
+    return iLuma;
 }
 
-QrCodeDecoder::Result
-QrCodeDecoder::decode(
-    const QImage aImage)
+QList<QrCodeDecoder::Result>
+QrCodeDecoder::Private::scan(
+    const QImage& aImage,
+    bool aAll)
 {
+    QList<Result> results;
+
     try {
-        zbar::Image img(zbar::QZBarImage(aImage).convert(zbar_fourcc('Y','8','0','0')));
+        zbar::Image converted;
+        QImage luma;
+
+        if (aImage.format() == QImage::Format_Grayscale8) {
+            // Luminance is exactly what zbar wants, feed it directly
+            // to the pooled image. The data must stay alive while zbar
+            // is looking at it.
+            luma = packedLuma(aImage);
+            iImage.set_size(luma.width(), luma.height());
+            iImage.set_data(luma.constBits(), luma.width() * luma.height());
+        } else {
+            converted = zbar::QZBarImage(aImage).convert(zbar_fourcc('Y','8','0','0'));
+        }
 
-        iPrivate->iReader->scan(img);
+        zbar::Image& img(luma.isNull() ? converted : iImage);
+        iReader->scan(img);
 
         const zbar::SymbolSet symbols(img.get_symbols());
         zbar::SymbolIterator sym = symbols.symbol_begin();
-        if (sym != symbols.symbol_end()) {
+        while (sym != symbols.symbol_end()) {
             QList<QPointF> points;
             const zbar::Symbol symbol(*sym);
             zbar::Symbol::PointIterator it = symbol.point_begin();
@@ -205,12 +252,54 @@ QrCodeDecoder::decode(
                 ++it;
             }
 
-            return Result(QString::fromStdString(symbol.get_data()), points,
-                QString::fromStdString(symbol.get_type_name()));
+            results.append(Result(QString::fromStdString(symbol.get_data()),
+                points, QString::fromStdString(symbol.get_type_name())));
+            if (!aAll) {
+                break;
+            }
+            ++sym;
         }
     } catch (std::exception& x) {
         HWARN(x.what());
     }
 
-    return Result();
+    return results;
+}
+
+// ==========================================================================
+// QrCodeDecoder
+// ==========================================================================
+
+QrCodeDecoder::QrCodeDecoder(
+    Profile aProfile) :
+    iPrivate(new Private(aProfile))
+{
+    qRegisterMetaType<Result>();
+}
+
+QrCodeDecoder::~QrCodeDecoder()
+{
+    delete iPrivate;
+}
+
+QrCodeDecoder::Profile
+QrCodeDecoder::profile() const
+{
+    return iPrivate->iProfile;
+}
+
+QrCodeDecoder::Result
+QrCodeDecoder::decode(
+    const QImage aImage)
+{
+    const QList<Result> results(iPrivate->scan(aImage, false));
+
+    return results.isEmpty() ? Result() : results.first();
+}
+
+QList<QrCodeDecoder::Result>
+QrCodeDecoder::decodeAll(
+    const QImage aImage)
+{
+    return iPrivate->scan(aImage, true);
 }
@@ -51,10 +51,17 @@ class QrCodeDecoder
 public:
     class Result;
 
-    QrCodeDecoder();
+    enum Profile {
+        ProfileAll,     // All symbologies supported by zbar
+        ProfileQrCode   // QR codes only, linear decoders are disabled
+    };
+
+    QrCodeDecoder(Profile aProfile = ProfileAll);
     ~QrCodeDecoder();
 
+    Profile profile() const;
     Result decode(const QImage);
+    QList<Result> decodeAll(const QImage);
 
 private:
     class Private;
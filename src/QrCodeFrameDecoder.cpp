@@ -0,0 +1,794 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "QrCodeFrameDecoder.h"
+#include "QrCodeLuma.h"
+
+#include "HarbourDebug.h"
+
+#include <QtConcurrent>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QTransform>
+#include <QWaitCondition>
+#include <QtMultimedia/QVideoFrame>
+
+// ==========================================================================
+// QrCodeFrameDecoder::Private
+// ==========================================================================
+
+class QrCodeFrameDecoder::Private
+{
+public:
+    class DecodeJob;
+    class Governor;
+
+    // How many pictures to decode around the last known location
+    // before going back to the whole picture
+    static const int TrackMaxMisses = 8;
+
+    // Limits the native hypothesis to this many times the governor's
+    // working size in each dimension, so that its cost (which every
+    // picture without a code pays in full) follows the governor
+    static const int NativeMaxFactor = 2;
+
+    Private(QThreadPool*);
+    ~Private();
+
+    void waitForPending();
+    QrCodeDecoder::Result decodeJob(QSharedPointer<DecodeJob>, int*);
+    void track(const QList<QPointF>&, const QSize&, int);
+    QrCodeDecoder::Result decode(const QImage&, const QVideoFrame&,
+        const QRect&, int, const QSet<QString>&);
+
+    static QImage extractLuma(const QImage&, const QVideoFrame&,
+        const QRect&, int, const QSize&, qreal*, QImage*);
+
+public:
+    QThreadPool* iPool;
+    QrCodeDecoder* iDecoder[HypothesisCount];
+    Governor* iGovernor;
+    int iBudget;
+    bool iTryRotated;
+    bool iFrameUnreadable;
+    bool iGovernorUpdated;
+    QSharedPointer<DecodeJob> iJob;  // The last one
+    QImage iLumaPool;
+    QImage iNativePool;
+    QImage iHalfPool;
+    QRect iTrackRect;
+    QSize iTrackPictureSize;
+    int iTrackAngle;
+    int iTrackMisses;
+    Stats iStats;
+};
+
+// ==========================================================================
+// QrCodeFrameDecoder::Private::Governor
+//
+// Picks the working resolution and the pause between pictures so that
+// decoding a picture stays within the latency budget. Slow devices get
+// fewer pixels and fewer pictures, fast devices get more pixels for
+// denser codes if nothing is being found at the current resolution.
+// ==========================================================================
+
+class QrCodeFrameDecoder::Private::Governor
+{
+public:
+    static const int MinWidth = 300;        // 300x400
+    static const int MaxWidth = 1200;       // 1200x1600
+    static const int InitialWidth = 600;    // 600x800
+    static const int WidthStep = 100;
+    static const int MaxFrameInterval = 500;
+    static const int FrameIntervalStep = 50;
+    static const int Window = 4;            // Pictures per adjustment
+
+    Governor(int);
+
+    QSize decodeSize() const;
+    bool update(int, int, bool);
+
+public:
+    int iWidth;
+    int iFrameInterval;
+    int iAverageMs;
+    int iFrames;
+    int iMisses;
+};
+
+QrCodeFrameDecoder::Private::Governor::Governor(
+    int aWidth) :
+    iWidth(aWidth > 0 ? qBound((int)MinWidth, aWidth, (int)MaxWidth) :
+        InitialWidth),
+    iFrameInterval(0),
+    iAverageMs(0),
+    iFrames(0),
+    iMisses(0)
+{
+}
+
+QSize
+QrCodeFrameDecoder::Private::Governor::decodeSize() const
+{
+    // Portrait, 3:4
+    return QSize(iWidth, iWidth * 4 / 3);
+}
+
+// Returns true when it's time to report the state
+bool
+QrCodeFrameDecoder::Private::Governor::update(
+    int aBudget,
+    int aMs,
+    bool aDecoded)
+{
+    // Exponential moving average
+    iAverageMs = iFrames ? ((3 * iAverageMs + aMs) / 4) : aMs;
+    iMisses = aDecoded ? 0 : (iMisses + 1);
+    if (++iFrames < Window) {
+        return false;
+    }
+
+    iFrames = 0;
+    if (iAverageMs > aBudget) {
+        // Falling behind, give up pixels first and then frames
+        if (iWidth > MinWidth) {
+            iWidth = qMax(iWidth - WidthStep, (int)MinWidth);
+        } else if (iFrameInterval < MaxFrameInterval) {
+            iFrameInterval += FrameIntervalStep;
+        }
+    } else if (iAverageMs < aBudget / 2) {
+        // Plenty of time left, take frames back first
+        if (iFrameInterval > 0) {
+            iFrameInterval = qMax(iFrameInterval - FrameIntervalStep, 0);
+        } else if (iMisses >= Window && iWidth < MaxWidth) {
+            // Nothing found, the code may be too dense for this resolution
+            iWidth = qMin(iWidth + WidthStep, (int)MaxWidth);
+        }
+    }
+    HDEBUG("avg" << iAverageMs << "ms, budget" << aBudget << "ms, size" <<
+        decodeSize() << "interval" << iFrameInterval << "ms");
+    return true;
+}
+
+// ==========================================================================
+// QrCodeFrameDecoder::Private::DecodeJob
+// ==========================================================================
+
+class QrCodeFrameDecoder::Private::DecodeJob
+{
+public:
+    DecodeJob();
+
+    void setScaled(const QImage&, qreal);
+    void setImage(Hypothesis, const QImage&, qreal aScale = 1,
+        const QPoint& aOffset = QPoint());
+
+    void waitForPending();
+
+    static void run(QSharedPointer<DecodeJob>, QrCodeDecoder*, int);
+    static QImage stretched(const QImage&);
+    static QImage inverted(const QImage&);
+
+public:
+    QImage iImage[HypothesisCount];
+    qreal iScale[HypothesisCount];
+    QPoint iOffset[HypothesisCount];
+    QMutex iMutex;
+    QWaitCondition iEvent;
+    int iPending;
+    int iWinner;
+    QrCodeDecoder::Result iResult;
+};
+
+QrCodeFrameDecoder::Private::DecodeJob::DecodeJob() :
+    iPending(0),
+    iWinner(-1)
+{
+    for (int i = 0; i < HypothesisCount; i++) {
+        iScale[i] = 1;
+    }
+}
+
+void
+QrCodeFrameDecoder::Private::DecodeJob::setImage(
+    Hypothesis aHypothesis,
+    const QImage& aImage,
+    qreal aScale,
+    const QPoint& aOffset)
+{
+    iImage[aHypothesis] = aImage;
+    iScale[aHypothesis] = aScale;
+    iOffset[aHypothesis] = aOffset;
+}
+
+void
+QrCodeFrameDecoder::Private::DecodeJob::setScaled(
+    const QImage& aImage,
+    qreal aScale)
+{
+    // Stretched and inverted images are derived from the scaled one
+    setImage(HypothesisScaled, aImage, aScale);
+    iScale[HypothesisStretched] = aScale;
+    iScale[HypothesisInverted] = aScale;
+}
+
+void
+QrCodeFrameDecoder::Private::DecodeJob::waitForPending()
+{
+    // The losing hypotheses may still be using the decoders and the
+    // pooled luma buffers, wait until they are all done
+    iMutex.lock();
+    while (iPending > 0) {
+        iEvent.wait(&iMutex);
+    }
+    iMutex.unlock();
+}
+
+/* static */
+QImage
+QrCodeFrameDecoder::Private::DecodeJob::stretched(
+    const QImage& aImage)
+{
+    // Maps 1st..99th percentile of the histogram onto the full range
+    const int w = aImage.width();
+    const int h = aImage.height();
+    const int cutoff = w * h / 100;
+    int histogram[256];
+    int x, y, lo, hi, sum;
+
+    memset(histogram, 0, sizeof(histogram));
+    for (y = 0; y < h; y++) {
+        const uchar* src = aImage.constScanLine(y);
+
+        for (x = 0; x < w; x++) {
+            histogram[src[x]]++;
+        }
+    }
+    lo = 0;
+    sum = histogram[lo];
+    while (lo < 255 && sum <= cutoff) {
+        sum += histogram[++lo];
+    }
+    hi = 255;
+    sum = histogram[hi];
+    while (hi > 0 && sum <= cutoff) {
+        sum += histogram[--hi];
+    }
+
+    if (hi - lo < 16 || (hi - lo) > 224) {
+        // Either flat or already good enough, stretching won't help
+        return QImage();
+    }
+
+    uchar lut[256];
+    for (x = 0; x < 256; x++) {
+        lut[x] = (uchar)qBound(0, (x - lo) * 255 / (hi - lo), 255);
+    }
+
+    QImage image(w, h, QImage::Format_Grayscale8);
+    for (y = 0; y < h; y++) {
+        const uchar* src = aImage.constScanLine(y);
+        uchar* dest = image.scanLine(y);
+
+        for (x = 0; x < w; x++) {
+            dest[x] = lut[src[x]];
+        }
+    }
+    return image;
+}
+
+/* static */
+QImage
+QrCodeFrameDecoder::Private::DecodeJob::inverted(
+    const QImage& aImage)
+{
+    QImage image(aImage);
+
+    image.invertPixels();
+    return image;
+}
+
+/* static */
+void
+QrCodeFrameDecoder::Private::DecodeJob::run(
+    QSharedPointer<DecodeJob> aJob,
+    QrCodeDecoder* aDecoder,
+    int aHypothesis)
+{
+    DecodeJob* job = aJob.data();
+    QrCodeDecoder::Result result;
+
+    // Don't even start if someone has already succeeded
+    job->iMutex.lock();
+    bool cancelled = (job->iWinner >= 0);
+    job->iMutex.unlock();
+
+    if (!cancelled) {
+        QImage image;
+
+        switch (aHypothesis) {
+        case HypothesisStretched:
+            image = stretched(job->iImage[HypothesisScaled]);
+            break;
+        case HypothesisInverted:
+            image = inverted(job->iImage[HypothesisScaled]);
+            break;
+        default:
+            image = job->iImage[aHypothesis];
+            break;
+        }
+        if (!image.isNull()) {
+            result = aDecoder->decode(image);
+        }
+    }
+
+    job->iMutex.lock();
+    if (result.isValid() && job->iWinner < 0) {
+        HDEBUG("hypothesis" << aHypothesis << "wins");
+        job->iWinner = aHypothesis;
+        job->iResult = result;
+    }
+    job->iPending--;
+    job->iEvent.wakeAll();
+    job->iMutex.unlock();
+}
+
+// ==========================================================================
+// QrCodeFrameDecoder::Private
+// ==========================================================================
+
+QrCodeFrameDecoder::Private::Private(
+    QThreadPool* aPool) :
+    iPool(aPool),
+    iGovernor(new Governor(0)),
+    iBudget(DefaultBudget),
+    iTryRotated(false),
+    iFrameUnreadable(false),
+    iGovernorUpdated(false),
+    iTrackAngle(0),
+    iTrackMisses(0)
+{
+    memset(iDecoder, 0, sizeof(iDecoder));
+}
+
+QrCodeFrameDecoder::Private::~Private()
+{
+    waitForPending();
+    for (int i = 0; i < HypothesisCount; i++) {
+        delete iDecoder[i];
+    }
+    delete iGovernor;
+}
+
+void
+QrCodeFrameDecoder::Private::waitForPending()
+{
+    // Previous picture may still be being decoded by the losers
+    if (iJob) {
+        iJob->waitForPending();
+        iJob.reset();
+    }
+}
+
+QrCodeDecoder::Result
+QrCodeFrameDecoder::Private::decodeJob(
+    QSharedPointer<DecodeJob> aJob,
+    int* aWinner)
+{
+    // Fans the picture out to the decoding pool, the first successful
+    // hypothesis wins. The ones which haven't started yet are skipped,
+    // the ones already running are left to finish in the background.
+    DecodeJob* job = aJob.data();
+    int i;
+
+    job->iPending = HypothesisCount;
+    for (i = 0; i < HypothesisCount; i++) {
+        QtConcurrent::run(iPool, &DecodeJob::run, aJob, iDecoder[i], i);
+    }
+
+    job->iMutex.lock();
+    while (job->iWinner < 0 && job->iPending > 0) {
+        job->iEvent.wait(&job->iMutex);
+    }
+    *aWinner = job->iWinner;
+    QrCodeDecoder::Result result(job->iResult);
+    job->iMutex.unlock();
+    return result;
+}
+
+void
+QrCodeFrameDecoder::Private::track(
+    const QList<QPointF>& aPoints,
+    const QSize& aPictureSize,
+    int aAngle)
+{
+    // Padded bounding box of the code, in picture coordinates
+    if (!aPoints.isEmpty()) {
+        QRectF box(aPoints.first(), QSizeF(0, 0));
+
+        for (int i = 1; i < aPoints.size(); i++) {
+            box |= QRectF(aPoints.at(i), QSizeF(0, 0));
+        }
+
+        const qreal pad = qMax(box.width(), box.height()) / 4 + 8;
+
+        iTrackRect = box.adjusted(-pad, -pad, pad, pad).toAlignedRect().
+            intersected(QRect(QPoint(0, 0), aPictureSize));
+        iTrackPictureSize = aPictureSize;
+        iTrackAngle = aAngle;
+        iTrackMisses = 0;
+        HDEBUG("tracking" << iTrackRect);
+    }
+}
+
+/* static */
+QImage
+QrCodeFrameDecoder::Private::extractLuma(
+    const QImage& aImage,
+    const QVideoFrame& aFrame,
+    const QRect& aCrop,
+    int aRotation,
+    const QSize& aMaxSize,
+    qreal* aScale,
+    QImage* aPool)
+{
+    return aFrame.isValid() ?
+        QrCodeLuma::extract(aFrame, aCrop, aRotation, aMaxSize, aScale, aPool) :
+        QrCodeLuma::extract(aImage, aCrop, aRotation, aMaxSize, aScale, aPool);
+}
+
+QrCodeDecoder::Result
+QrCodeFrameDecoder::Private::decode(
+    const QImage& aImage,
+    const QVideoFrame& aFrame,
+    const QRect& aCrop,
+    int aAngle,
+    const QSet<QString>& aIgnore)
+{
+    // The decoders and the pooled buffers are about to be reused
+    waitForPending();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Geometry of the picture (the cropped area, rotated)
+    const QSize pictureSize(QrCodeLuma::outputSize(aCrop, aAngle));
+    const QSize maxSize(iGovernor->decodeSize());
+    const uchar* pooledBits[3];
+    QSharedPointer<DecodeJob> job(new DecodeJob);
+    QrCodeDecoder::Result result;
+    QImage scaledImage;
+    qreal imageScale = 1;
+    qreal scale = 1;
+    QPoint offset;
+    bool rotated = false;
+    int scaledWidth = 0;
+    int winner;
+
+    iFrameUnreadable = false;
+    iGovernorUpdated = false;
+    pooledBits[0] = iLumaPool.constBits();
+    pooledBits[1] = iNativePool.constBits();
+    pooledBits[2] = iHalfPool.constBits();
+
+    if (iTrackRect.isValid() && (iTrackPictureSize != pictureSize ||
+        iTrackAngle != aAngle)) {
+        HDEBUG("picture geometry changed, not tracking");
+        iTrackRect = QRect();
+    }
+
+    if (aCrop.isEmpty()) {
+        // Nothing to decode
+        return result;
+    } else if (iTrackRect.isValid()) {
+        // Only look where the code was seen last time, at the full
+        // resolution if it's small enough
+        QImage tracked(extractLuma(aImage, aFrame, QrCodeLuma::
+            sourceRect(iTrackRect, aCrop, aAngle), aAngle, maxSize,
+            &imageScale, &iLumaPool));
+
+        HDEBUG("tracking" << iTrackRect << tracked);
+        job->setImage(HypothesisTracked, tracked, imageScale,
+            iTrackRect.topLeft());
+    } else {
+        scaledImage = extractLuma(aImage, aFrame, aCrop, aAngle, maxSize,
+            &imageScale, &iLumaPool);
+        job->setScaled(scaledImage, imageScale);
+
+        qreal nativeScale = imageScale;
+        if (imageScale > 1) {
+            // Full resolution, unless that's more than twice the
+            // governor's working size. Pooled like the scaled one.
+            job->setImage(HypothesisNative, extractLuma(aImage, aFrame,
+                aCrop, aAngle, maxSize * NativeMaxFactor, &nativeScale,
+                &iNativePool), nativeScale);
+        }
+
+        // 2x downscale, unless it's too close to one of the above
+        // or would be larger than the bounded native one
+        if (nativeScale < 1.75 && qAbs(imageScale - 2) > 0.25) {
+            qreal halfScale = 1;
+            const QImage half(extractLuma(aImage, aFrame, aCrop, aAngle,
+                pictureSize / 2, &halfScale, &iHalfPool));
+
+            job->setImage(HypothesisHalf, half, halfScale);
+        }
+        HDEBUG("extracted" << scaledImage << "scale" << imageScale);
+    }
+
+    if (aFrame.isValid() && scaledImage.isNull() &&
+        job->iImage[HypothesisTracked].isNull()) {
+        // The frame couldn't be mapped (typically a GPU buffer)
+        // or its format isn't supported
+        iFrameUnreadable = true;
+        iTrackRect = QRect();
+        return result;
+    }
+
+    if (iLumaPool.constBits() != pooledBits[0]) {
+        iStats.iAllocs++;
+    }
+    if (iNativePool.constBits() != pooledBits[1]) {
+        iStats.iAllocs++;
+    }
+    if (iHalfPool.constBits() != pooledBits[2]) {
+        iStats.iAllocs++;
+    }
+
+    HDEBUG("decoding picture ...");
+    result = decodeJob(job, &winner);
+    iJob = job;
+    if (result.isValid() && aIgnore.contains(result.getText())) {
+        // Has been reported already. The decoders and buffers are
+        // about to be reused for the rotated attempt below.
+        waitForPending();
+        result = QrCodeDecoder::Result();
+        winner = -1;
+    }
+    if (winner >= 0) {
+        iStats.iWins[winner]++;
+        scale = job->iScale[winner];
+        offset = job->iOffset[winner];
+    } else if (iTrackRect.isValid() && ++iTrackMisses >= TrackMaxMisses) {
+        HDEBUG("lost track");
+        iTrackRect = QRect();
+    }
+
+    if (!result.isValid() && iTryRotated && !scaledImage.isNull() &&
+        iDecoder[HypothesisScaled]->profile() != QrCodeDecoder::ProfileQrCode) {
+        // Try the other orientation for 1D bar code
+        QTransform transform;
+
+        waitForPending();
+        scale = imageScale;
+        offset = QPoint();
+        transform.rotate(90);
+        scaledImage = scaledImage.transformed(transform);
+        HDEBUG("decoding rotated picture ...");
+        result = iDecoder[HypothesisScaled]->decode(scaledImage);
+        if (result.isValid() && aIgnore.contains(result.getText())) {
+            result = QrCodeDecoder::Result();
+        }
+        // We need scaled width for rotating the points back
+        scaledWidth = scaledImage.width();
+        rotated = true;
+    }
+
+    const int ms = (int)timer.elapsed();
+
+    iGovernorUpdated = iGovernor->update(iBudget, ms, result.isValid());
+    iStats.iFrames++;
+    iStats.iTotalMs += ms;
+    iStats.iMaxMs = qMax(iStats.iMaxMs, ms);
+    HDEBUG("decoding took" << ms << "ms");
+
+    if (result.isValid()) {
+        iStats.iDecoded++;
+        if (scale > 1 || rotated || !offset.isNull()) {
+            // The image could be a) scaled b) rotated and c) cropped.
+            // Convert points to the picture coordinate system
+            QList<QPointF> points = result.getPoints();
+            const int n = points.size();
+
+            for (int i = 0; i < n; i++) {
+                QPointF p(points.at(i));
+
+                if (rotated) {
+                    const qreal x = p.rx();
+
+                    p.setX(p.ry());
+                    p.setY(scaledWidth - x);
+                }
+                p *= scale;
+                p += offset;
+                HDEBUG(points[i] << "=>" << p);
+                points[i] = p;
+            }
+            result = QrCodeDecoder::Result(result.getText(), points,
+                result.getFormatName());
+        }
+        track(result.getPoints(), pictureSize, aAngle);
+    }
+    return result;
+}
+
+// ==========================================================================
+// QrCodeFrameDecoder::Stats
+// ==========================================================================
+
+QrCodeFrameDecoder::Stats::Stats() :
+    iFrames(0),
+    iDecoded(0),
+    iAllocs(0),
+    iMaxMs(0),
+    iTotalMs(0)
+{
+    memset(iWins, 0, sizeof(iWins));
+}
+
+// ==========================================================================
+// QrCodeFrameDecoder
+// ==========================================================================
+
+QrCodeFrameDecoder::QrCodeFrameDecoder(
+    QThreadPool* aPool) :
+    iPrivate(new Private(aPool))
+{
+}
+
+QrCodeFrameDecoder::~QrCodeFrameDecoder()
+{
+    delete iPrivate;
+}
+
+bool
+QrCodeFrameDecoder::allocate()
+{
+    if (!iPrivate->iDecoder[0]) {
+        // zbar scanners aren't thread safe, each hypothesis needs its own.
+        // Only otpauth QR codes are of interest.
+        for (int i = 0; i < HypothesisCount; i++) {
+            iPrivate->iDecoder[i] =
+                new QrCodeDecoder(QrCodeDecoder::ProfileQrCode);
+        }
+        return true;
+    }
+    return false;
+}
+
+void
+QrCodeFrameDecoder::release()
+{
+    iPrivate->waitForPending();
+    for (int i = 0; i < HypothesisCount; i++) {
+        delete iPrivate->iDecoder[i];
+        iPrivate->iDecoder[i] = Q_NULLPTR;
+    }
+    iPrivate->iLumaPool = QImage();
+    iPrivate->iNativePool = QImage();
+    iPrivate->iHalfPool = QImage();
+}
+
+bool
+QrCodeFrameDecoder::allocated() const
+{
+    return iPrivate->iDecoder[0] != Q_NULLPTR;
+}
+
+void
+QrCodeFrameDecoder::reset(
+    int aWidth)
+{
+    iPrivate->waitForPending();
+    delete iPrivate->iGovernor;
+    iPrivate->iGovernor = new Private::Governor(aWidth);
+    iPrivate->iTrackRect = QRect();
+    iPrivate->iTrackMisses = 0;
+    iPrivate->iStats = Stats();
+}
+
+void
+QrCodeFrameDecoder::clearStats()
+{
+    iPrivate->iStats = Stats();
+}
+
+void
+QrCodeFrameDecoder::setBudget(
+    int aBudget)
+{
+    iPrivate->iBudget = aBudget;
+}
+
+void
+QrCodeFrameDecoder::setTryRotated(
+    bool aTryRotated)
+{
+    iPrivate->iTryRotated = aTryRotated;
+}
+
+QrCodeDecoder::Result
+QrCodeFrameDecoder::decode(
+    const QImage& aImage,
+    const QVideoFrame& aFrame,
+    const QRect& aCrop,
+    int aAngle,
+    const QSet<QString>& aIgnore)
+{
+    return allocated() ?
+        iPrivate->decode(aImage, aFrame, aCrop, aAngle, aIgnore) :
+        QrCodeDecoder::Result();
+}
+
+bool
+QrCodeFrameDecoder::frameUnreadable() const
+{
+    return iPrivate->iFrameUnreadable;
+}
+
+bool
+QrCodeFrameDecoder::governorUpdated() const
+{
+    return iPrivate->iGovernorUpdated;
+}
+
+QSize
+QrCodeFrameDecoder::decodeSize() const
+{
+    return iPrivate->iGovernor->decodeSize();
+}
+
+int
+QrCodeFrameDecoder::frameInterval() const
+{
+    return iPrivate->iGovernor->iFrameInterval;
+}
+
+int
+QrCodeFrameDecoder::averageTime() const
+{
+    return iPrivate->iGovernor->iAverageMs;
+}
+
+const QrCodeFrameDecoder::Stats&
+QrCodeFrameDecoder::stats() const
+{
+    return iPrivate->iStats;
+}
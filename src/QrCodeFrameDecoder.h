@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef QRCODE_FRAME_DECODER_H
+#define QRCODE_FRAME_DECODER_H
+
+#include "QrCodeDecoder.h"
+
+#include <QImage>
+#include <QRect>
+#include <QSet>
+#include <QSize>
+#include <QString>
+
+class QThreadPool;
+class QVideoFrame;
+
+// Decodes one picture at a time, the way the scanner does it. Several
+// variations of each picture are decoded in parallel and the first one
+// to succeed wins. The location of the code is tracked between the
+// pictures, and the working resolution and the pause between pictures
+// are adjusted to stay within the latency budget. All calls are expected
+// to come from the same thread, only the decoding is done by the pool.
+class QrCodeFrameDecoder
+{
+    Q_DISABLE_COPY(QrCodeFrameDecoder)
+
+public:
+    // Variations of the same picture, decoded in parallel
+    enum Hypothesis {
+        HypothesisScaled,       // Downscaled to the governor's working size
+        HypothesisNative,       // Full resolution, up to twice the above
+        HypothesisHalf,         // Half of the full resolution
+        HypothesisStretched,    // Downscaled, contrast stretched
+        HypothesisInverted,     // Downscaled, light on dark background
+        HypothesisTracked,      // Where the code has been seen last time
+        HypothesisCount
+    };
+
+    static const int DefaultBudget = 200;   // ms per picture
+
+    struct Stats {
+        Stats();
+        int iFrames;
+        int iDecoded;
+        int iAllocs;        // Pooled buffers (re)allocated
+        int iMaxMs;
+        qint64 iTotalMs;
+        int iWins[HypothesisCount];
+    };
+
+    QrCodeFrameDecoder(QThreadPool* aPool);
+    ~QrCodeFrameDecoder();
+
+    // zbar decoders are allocated on demand and can be released when
+    // idle. allocate() returns true if they have actually been allocated.
+    bool allocate();
+    void release();
+    bool allocated() const;
+
+    // Forgets the tracked location and the statistics, and restarts the
+    // governor at the given working width (0 for the default one)
+    void reset(int aWidth = 0);
+    void clearStats();
+    void setBudget(int aBudget);
+    void setTryRotated(bool aTryRotated);
+
+    // Decodes a camera frame if it's valid, otherwise the image. The crop
+    // rectangle is in source coordinates, the cropped area is rotated by
+    // -aAngle degrees. Codes found in aIgnore count as nothing found.
+    // The points of the result are in the coordinates of the rotated
+    // picture.
+    QrCodeDecoder::Result decode(const QImage& aImage,
+        const QVideoFrame& aFrame, const QRect& aCrop, int aAngle,
+        const QSet<QString>& aIgnore);
+
+    // The state after the last decode() call
+    bool frameUnreadable() const;
+    bool governorUpdated() const;
+
+    QSize decodeSize() const;
+    int frameInterval() const;
+    int averageTime() const;
+    const Stats& stats() const;
+
+private:
+    class Private;
+    Private* iPrivate;
+};
+
+#endif // QRCODE_FRAME_DECODER_H
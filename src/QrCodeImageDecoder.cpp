@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "QrCodeImageDecoder.h"
+#include "QrCodeDecoder.h"
+#include "QrCodeLuma.h"
+
+#include "HarbourDebug.h"
+
+#include <QFutureWatcher>
+#include <QImageReader>
+#include <QSet>
+#include <QThreadPool>
+#include <QUrl>
+#include <QtConcurrent>
+
+// ==========================================================================
+// QrCodeImageDecoder::Private
+// ==========================================================================
+
+class QrCodeImageDecoder::Private :
+    public QObject
+{
+    Q_OBJECT
+
+public:
+    // Large pictures are split into overlapping tiles of this size.
+    // Any code up to TileOverlap pixels in size fits entirely into at
+    // least one tile. Larger codes are only found in the downscaled
+    // picture which is decoded first. That's the limit - a code larger
+    // than TileOverlap in a picture so big that downscaling makes the
+    // code unreadable won't be found.
+    static const int TileSize = 1024;
+    static const int TileOverlap = TileSize / 2;
+
+    Private(QrCodeImageDecoder*);
+
+    QrCodeImageDecoder* parentObject() const;
+    void decodeFile(QString);
+    static QStringList decodeTile(const QImage&);
+
+public Q_SLOTS:
+    void onFinished();
+
+public:
+    // decodeImage() maps the tiles on the global pool, the file itself
+    // is decoded on a separate one so that it doesn't wait for itself
+    QThreadPool* iPool;
+    QFutureWatcher<QStringList>* iWatcher;
+    QStringList iResults;
+};
+
+QrCodeImageDecoder::Private::Private(
+    QrCodeImageDecoder* aParent) :
+    QObject(aParent),
+    iPool(new QThreadPool(this)),
+    iWatcher(Q_NULLPTR)
+{
+}
+
+inline
+QrCodeImageDecoder*
+QrCodeImageDecoder::Private::parentObject() const
+{
+    return qobject_cast<QrCodeImageDecoder*>(parent());
+}
+
+void
+QrCodeImageDecoder::Private::decodeFile(
+    QString aPath)
+{
+    QrCodeImageDecoder* obj = parentObject();
+    const bool wasBusy = (iWatcher != Q_NULLPTR);
+
+    if (iWatcher) {
+        // Can't really cancel it but can ignore the result
+        iWatcher->disconnect(this);
+        iWatcher->deleteLater();
+    }
+
+    iWatcher = new QFutureWatcher<QStringList>(this);
+    connect(iWatcher, SIGNAL(finished()), SLOT(onFinished()));
+    iWatcher->setFuture(QtConcurrent::run(iPool, decodeFileSync,
+        aPath));
+    if (!wasBusy) {
+        Q_EMIT obj->busyChanged();
+    }
+}
+
+void
+QrCodeImageDecoder::Private::onFinished()
+{
+    QrCodeImageDecoder* obj = parentObject();
+    const QStringList results(iWatcher->result());
+
+    iWatcher->deleteLater();
+    iWatcher = Q_NULLPTR;
+    if (iResults != results) {
+        iResults = results;
+        Q_EMIT obj->resultsChanged();
+    }
+    Q_EMIT obj->busyChanged();
+    Q_EMIT obj->decodeFinished();
+}
+
+QStringList
+QrCodeImageDecoder::Private::decodeTile(
+    const QImage& aTile)
+{
+    QrCodeDecoder decoder(QrCodeDecoder::ProfileQrCode);
+    const QList<QrCodeDecoder::Result> results(decoder.decodeAll(aTile));
+    const int n = results.count();
+    QStringList texts;
+
+    for (int i = 0; i < n; i++) {
+        texts.append(results.at(i).getText());
+    }
+    return texts;
+}
+
+// ==========================================================================
+// QrCodeImageDecoder
+// ==========================================================================
+
+QrCodeImageDecoder::QrCodeImageDecoder(
+    QObject* aParent) :
+    QObject(aParent),
+    iPrivate(new Private(this))
+{
+}
+
+QrCodeImageDecoder::~QrCodeImageDecoder()
+{
+    delete iPrivate;
+}
+
+bool
+QrCodeImageDecoder::busy() const
+{
+    return iPrivate->iWatcher != Q_NULLPTR;
+}
+
+QStringList
+QrCodeImageDecoder::results() const
+{
+    return iPrivate->iResults;
+}
+
+void
+QrCodeImageDecoder::decodeFile(
+    QString aPath)
+{
+    iPrivate->decodeFile(aPath);
+}
+
+/* static */
+QStringList
+QrCodeImageDecoder::decodeFileSync(
+    QString aPath)
+{
+    const QUrl url(aPath);
+    const QString path(url.isLocalFile() ? url.toLocalFile() : aPath);
+    QImageReader reader(path);
+    const QImage image(reader.read());
+
+    if (image.isNull()) {
+        HWARN("Failed to read" << qPrintable(path) << reader.errorString());
+        return QStringList();
+    } else {
+        HDEBUG(qPrintable(path) << image);
+        return decodeImage(image);
+    }
+}
+
+/* static */
+QStringList
+QrCodeImageDecoder::decodeImage(
+    const QImage& aImage)
+{
+    const int T = Private::TileSize;
+    const int step = T - Private::TileOverlap;
+    const int w = aImage.width();
+    const int h = aImage.height();
+    const QRect rect(0, 0, w, h);
+    QList<QImage> tiles;
+
+    // The whole picture goes first, downscaled if necessary
+    tiles.append(QrCodeLuma::extract(aImage, rect, 0, QSize(T, T)));
+    if (w > T || h > T) {
+        const QImage luma(QrCodeLuma::extract(aImage, rect, 0, QSize()));
+
+        for (int y = 0; y < h; y += step) {
+            const int ty = qMin(y, qMax(h - T, 0));
+
+            for (int x = 0; x < w; x += step) {
+                const int tx = qMin(x, qMax(w - T, 0));
+
+                tiles.append(luma.copy(tx, ty, qMin(T, w), qMin(T, h)));
+                if (tx + T >= w) break;
+            }
+            if (ty + T >= h) break;
+        }
+    }
+
+    HDEBUG("decoding" << tiles.count() << "tile(s)");
+    const QList<QStringList> decoded(QtConcurrent::blockingMapped(tiles,
+        Private::decodeTile));
+
+    // Merge the results, preserving the order in which they were found
+    QStringList results;
+    QSet<QString> seen;
+    const int n = decoded.count();
+    for (int i = 0; i < n; i++) {
+        const QStringList texts(decoded.at(i));
+        const int k = texts.count();
+
+        for (int j = 0; j < k; j++) {
+            const QString text(texts.at(j));
+
+            if (text.startsWith(QStringLiteral("otpauth"), Qt::CaseInsensitive)
+                && !seen.contains(text)) {
+                seen.insert(text);
+                results.append(text);
+            }
+        }
+    }
+
+    HDEBUG(results);
+    return results;
+}
+
+#include "QrCodeImageDecoder.moc"
@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "QrCodeLuma.h"
+
+#include "HarbourDebug.h"
+
+#include <QVarLengthArray>
+#include <QtMultimedia/QVideoFrame>
+
+// ==========================================================================
+// Pixel accessors
+// ==========================================================================
+
+struct QrCodeLumaY8
+{
+    static inline uint luma(const uchar* aPixel)
+        { return *aPixel; }
+};
+
+struct QrCodeLumaRGB32
+{
+    // ITU-R BT.601 weights, scaled by 256
+    static inline uint luma(const uchar* aPixel)
+    {
+        const QRgb rgb = *(const QRgb*)aPixel;
+        return (qRed(rgb) * 77 + qGreen(rgb) * 150 + qBlue(rgb) * 29) >> 8;
+    }
+};
+
+// The source address of each destination pixel is the sum of the row
+// and column offsets, which takes care of cropping, rotation and scaling.
+// When downscaling, each destination pixel is the average of the 2x2
+// source box at that address. The inner loop has no branches.
+template <class P>
+static
+void
+qrCodeLumaKernel(
+    const uchar* aOrigin,
+    const ptrdiff_t* aColOffset,
+    const ptrdiff_t* aRowOffset,
+    ptrdiff_t aStepX,
+    ptrdiff_t aStepY,
+    bool aAverage,
+    QImage& aDest)
+{
+    const int w = aDest.width();
+    const int h = aDest.height();
+
+    if (aAverage) {
+        const ptrdiff_t stepXY = aStepX + aStepY;
+
+        for (int y = 0; y < h; y++) {
+            const uchar* row = aOrigin + aRowOffset[y];
+            uchar* dest = aDest.scanLine(y);
+
+            for (int x = 0; x < w; x++) {
+                const uchar* p = row + aColOffset[x];
+
+                dest[x] = (uchar)((P::luma(p) + P::luma(p + aStepX) +
+                    P::luma(p + aStepY) + P::luma(p + stepXY) + 2) >> 2);
+            }
+        }
+    } else {
+        for (int y = 0; y < h; y++) {
+            const uchar* row = aOrigin + aRowOffset[y];
+            uchar* dest = aDest.scanLine(y);
+
+            for (int x = 0; x < w; x++) {
+                dest[x] = (uchar)P::luma(row + aColOffset[x]);
+            }
+        }
+    }
+}
+
+// ==========================================================================
+// QrCodeLuma
+// ==========================================================================
+
+QImage
+QrCodeLuma::extract(
+    const Source& aSource,
+    const QRect& aCrop,
+    int aRotation,
+    const QSize& aMaxSize,
+    qreal* aScale,
+    QImage* aPool)
+{
+    const QRect crop(aCrop.intersected(QRect(0, 0,
+        aSource.width, aSource.height)));
+    const int rotation = ((aRotation % 360) + 360) % 360;
+    const bool swap = (rotation == 90 || rotation == 270);
+    const int rw = swap ? crop.height() : crop.width();
+    const int rh = swap ? crop.width() : crop.height();
+    qreal scale = 1;
+
+    if (aScale) *aScale = scale;
+    if (crop.isEmpty() || (rotation % 90)) {
+        HWARN("Can't extract" << crop << "rotated by" << aRotation);
+        return QImage();
+    }
+
+    // The same logic as in scaledToHeight/Width
+    int dw = rw, dh = rh;
+    if (aMaxSize.isValid() && (rw > aMaxSize.width() ||
+        rh > aMaxSize.height())) {
+        const int maxW = qMax(aMaxSize.width(), 1);
+        const int maxH = qMax(aMaxSize.height(), 1);
+
+        if (maxW * rh > maxH * rw) {
+            scale = rh / (qreal)maxH;
+            dh = maxH;
+            dw = qMax(qRound(rw / scale), 1);
+        } else {
+            scale = rw / (qreal)maxW;
+            dw = maxW;
+            dh = qMax(qRound(rh / scale), 1);
+        }
+    }
+
+    // Take the buffer out of the pool so that writing doesn't detach it
+    QImage image;
+    if (aPool && aPool->width() == dw && aPool->height() == dh &&
+        aPool->format() == QImage::Format_Grayscale8 && aPool->isDetached()) {
+        image.swap(*aPool);
+    } else {
+        image = QImage(dw, dh, QImage::Format_Grayscale8);
+        if (image.isNull()) {
+            return image;
+        }
+    }
+
+    const uchar* bits = aSource.bits;
+    ptrdiff_t ps;
+
+    switch (aSource.layout) {
+    case LayoutUYVY: bits++; // fallthrough
+    case LayoutYUYV: ps = 2; break;
+    case LayoutRGB32: ps = 4; break;
+    case LayoutY8:
+    default: ps = 1; break;
+    }
+
+    // Average 2x2 boxes when downscaling (and when there's room for it)
+    const bool average = (scale > 1 && rw > 1 && rh > 1);
+    const int maxRx = rw - (average ? 2 : 1);
+    const int maxRy = rh - (average ? 2 : 1);
+    const ptrdiff_t bpl = aSource.bytesPerLine;
+    const int left = crop.left(), right = crop.right();
+    const int top = crop.top(), bottom = crop.bottom();
+    const qreal center = (scale - 1) / 2;
+    QVarLengthArray<ptrdiff_t, 1024> colOffset(dw);
+    QVarLengthArray<ptrdiff_t, 1024> rowOffset(dh);
+    ptrdiff_t stepX, stepY;
+    int i;
+
+    // Map the rotated (rx,ry) to the source (sx,sy), see QTransform::rotate
+    for (i = 0; i < dw; i++) {
+        const int rx = qMin((int)(i * scale + center), maxRx);
+
+        switch (rotation) {
+        default:  colOffset[i] = (left + rx) * ps; break;
+        case 90:  colOffset[i] = (top + rx) * bpl; break;
+        case 180: colOffset[i] = (right - rx) * ps; break;
+        case 270: colOffset[i] = (bottom - rx) * bpl; break;
+        }
+    }
+    for (i = 0; i < dh; i++) {
+        const int ry = qMin((int)(i * scale + center), maxRy);
+
+        switch (rotation) {
+        default:  rowOffset[i] = (top + ry) * bpl; break;
+        case 90:  rowOffset[i] = (right - ry) * ps; break;
+        case 180: rowOffset[i] = (bottom - ry) * bpl; break;
+        case 270: rowOffset[i] = (left + ry) * ps; break;
+        }
+    }
+    switch (rotation) {
+    default:  stepX = ps;   stepY = bpl; break;
+    case 90:  stepX = bpl;  stepY = -ps; break;
+    case 180: stepX = -ps;  stepY = -bpl; break;
+    case 270: stepX = -bpl; stepY = ps; break;
+    }
+
+    if (aSource.layout == LayoutRGB32) {
+        qrCodeLumaKernel<QrCodeLumaRGB32>(bits, colOffset.constData(),
+            rowOffset.constData(), stepX, stepY, average, image);
+    } else {
+        qrCodeLumaKernel<QrCodeLumaY8>(bits, colOffset.constData(),
+            rowOffset.constData(), stepX, stepY, average, image);
+    }
+
+    if (aScale) *aScale = scale;
+    if (aPool) *aPool = image;
+    return image;
+}
+
+QImage
+QrCodeLuma::extract(
+    const QImage& aImage,
+    const QRect& aCrop,
+    int aRotation,
+    const QSize& aMaxSize,
+    qreal* aScale,
+    QImage* aPool)
+{
+    QImage image(aImage);
+    Source source;
+
+    switch (image.format()) {
+    case QImage::Format_Grayscale8:
+        source.layout = LayoutY8;
+        break;
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        source.layout = LayoutRGB32;
+        break;
+    default:
+        // Conversion costs an extra pass but shouldn't normally happen
+        HDEBUG("converting" << image.format());
+        image = image.convertToFormat(QImage::Format_RGB32);
+        source.layout = LayoutRGB32;
+        break;
+    }
+
+    source.bits = image.constBits();
+    source.width = image.width();
+    source.height = image.height();
+    source.bytesPerLine = image.bytesPerLine();
+    return extract(source, aCrop, aRotation, aMaxSize, aScale, aPool);
+}
+
+QImage
+QrCodeLuma::extract(
+    const QVideoFrame& aFrame,
+    const QRect& aCrop,
+    int aRotation,
+    const QSize& aMaxSize,
+    qreal* aScale,
+    QImage* aPool)
+{
+    QImage image;
+    QVideoFrame frame(aFrame);
+
+    if (aScale) *aScale = 1;
+    if (frame.map(QAbstractVideoBuffer::ReadOnly)) {
+        const QRect rect(aCrop.isNull() ?
+            QRect(0, 0, frame.width(), frame.height()) : aCrop);
+        Source source;
+
+        source.bits = frame.bits();
+        source.width = frame.width();
+        source.height = frame.height();
+        source.bytesPerLine = frame.bytesPerLine();
+
+        switch (frame.pixelFormat()) {
+        case QVideoFrame::Format_NV12:
+        case QVideoFrame::Format_NV21:
+        case QVideoFrame::Format_YUV420P:
+        case QVideoFrame::Format_YV12:
+        case QVideoFrame::Format_IMC1:
+        case QVideoFrame::Format_IMC2:
+        case QVideoFrame::Format_IMC3:
+        case QVideoFrame::Format_IMC4:
+        case QVideoFrame::Format_Y8:
+            // The first plane is the luminance
+            source.layout = LayoutY8;
+            image = extract(source, rect, aRotation, aMaxSize, aScale, aPool);
+            break;
+        case QVideoFrame::Format_YUYV:
+            source.layout = LayoutYUYV;
+            image = extract(source, rect, aRotation, aMaxSize, aScale, aPool);
+            break;
+        case QVideoFrame::Format_UYVY:
+            source.layout = LayoutUYVY;
+            image = extract(source, rect, aRotation, aMaxSize, aScale, aPool);
+            break;
+        default:
+            {
+                const QImage::Format format = QVideoFrame::
+                    imageFormatFromPixelFormat(frame.pixelFormat());
+
+                if (format != QImage::Format_Invalid) {
+                    image = extract(QImage(source.bits, source.width,
+                        source.height, source.bytesPerLine, format),
+                        rect, aRotation, aMaxSize, aScale, aPool);
+                } else {
+                    HWARN("Unsupported frame format" << frame.pixelFormat());
+                }
+            }
+            break;
+        }
+        frame.unmap();
+    } else {
+        HWARN("Failed to map the frame");
+    }
+    return image;
+}
+
+QSize
+QrCodeLuma::outputSize(
+    const QRect& aCrop,
+    int aRotation)
+{
+    const int rotation = ((aRotation % 360) + 360) % 360;
+
+    return (rotation == 90 || rotation == 270) ?
+        aCrop.size().transposed() : aCrop.size();
+}
+
+QRect
+QrCodeLuma::sourceRect(
+    const QRect& aOutputRect,
+    const QRect& aCrop,
+    int aRotation)
+{
+    // The inverse of the mapping done by extract()
+    const int w = aCrop.width();
+    const int h = aCrop.height();
+    const int x = aOutputRect.x();
+    const int y = aOutputRect.y();
+    const int rw = aOutputRect.width();
+    const int rh = aOutputRect.height();
+    QRect rect;
+
+    switch (((aRotation % 360) + 360) % 360) {
+    case 90:  rect = QRect(w - y - rh, x, rh, rw); break;
+    case 180: rect = QRect(w - x - rw, h - y - rh, rw, rh); break;
+    case 270: rect = QRect(y, h - x - rw, rh, rw); break;
+    default:  rect = aOutputRect; break;
+    }
+    return rect.translated(aCrop.topLeft()).intersected(aCrop);
+}
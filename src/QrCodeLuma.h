@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef QRCODE_LUMA_H
+#define QRCODE_LUMA_H
+
+#include <QImage>
+#include <QRect>
+#include <QSize>
+
+class QVideoFrame;
+
+// Turns a region of a picture into an 8-bit luminance image in a single
+// pass. Cropping, rotation and downscaling are all folded into addressing
+// of the source pixels, no intermediate images are created.
+class QrCodeLuma
+{
+public:
+    enum Layout {
+        LayoutY8,           // 8-bit luminance, e.g. the Y plane
+        LayoutYUYV,         // Packed 4:2:2, luminance in even bytes
+        LayoutUYVY,         // Packed 4:2:2, luminance in odd bytes
+        LayoutRGB32         // QRgb pixels
+    };
+
+    struct Source {
+        const uchar* bits;
+        int width;
+        int height;
+        int bytesPerLine;
+        Layout layout;
+    };
+
+    // The crop rectangle is in source coordinates. The cropped area is
+    // rotated by -aRotation degrees (the way QTransform::rotate does it)
+    // and then downscaled to fit aMaxSize. Invalid aMaxSize means no
+    // downscaling. The downscale factor (>= 1) is returned via aScale.
+    // If aPool is given, its buffer is reused when nothing else refers
+    // to it, and the pool is then updated to the returned image.
+    static QImage extract(const Source&, const QRect&, int aRotation,
+        const QSize& aMaxSize, qreal* aScale = Q_NULLPTR,
+        QImage* aPool = Q_NULLPTR);
+    static QImage extract(const QImage&, const QRect&, int aRotation,
+        const QSize& aMaxSize, qreal* aScale = Q_NULLPTR,
+        QImage* aPool = Q_NULLPTR);
+    static QImage extract(const QVideoFrame&, const QRect&, int aRotation,
+        const QSize& aMaxSize, qreal* aScale = Q_NULLPTR,
+        QImage* aPool = Q_NULLPTR);
+
+    // Geometry of the (unscaled) output, and the area of the source
+    // which corresponds to a rectangle within the output
+    static QSize outputSize(const QRect& aCrop, int aRotation);
+    static QRect sourceRect(const QRect& aOutputRect, const QRect& aCrop,
+        int aRotation);
+};
+
+#endif // QRCODE_LUMA_H
@@ -37,14 +37,26 @@
 
 #include "QrCodeScanner.h"
 #include "QrCodeDecoder.h"
+#include "QrCodeFrameDecoder.h"
+#include "QrCodeLuma.h"
 
 #include "HarbourDebug.h"
 
 #include <QtConcurrent>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTimer>
 #include <QtQuick/QQuickItem>
 #include <QPainter>
+#include <QPointer>
+#include <QSet>
 #include <QBrush>
 #include <QtQuick/QQuickWindow>
+#include <QtMultimedia/QMediaObject>
+#include <QtMultimedia/QVideoFrame>
+#include <QtMultimedia/QVideoProbe>
+
+#include <unistd.h>
 
 #ifdef HARBOUR_DEBUG
 #include <QStandardPaths>
@@ -68,34 +80,66 @@ class QrCodeScanner::Private : public QObject
 {
     Q_OBJECT
 public:
+    // How long to keep the decoders around after the scan is done (ms)
+    static const int IdleTimeout = 5000;
+
     Private(QrCodeScanner* aParent);
     ~Private();
 
     QrCodeScanner* scanner();
+    void updateResidentMemory();
+    static int currentResidentMemory();
     void scanThread(uint aScanId);
     void start();
     void stop();
     void requestStop();
     void setRotation(int aDegrees);
     void setTryRotated(bool aTryRotated);
+    void setContinuous(bool aContinuous);
+    void setDecodeBudget(int aBudget);
+    static QVariantMap resultMap(const QrCodeDecoder::Result& aResult);
     void setViewFinderRect(const QRect& aRect);
     void setViewFinderItem(QQuickItem* aItem);
+    void setVideoOutput(QQuickItem* aItem);
+    static QRect cropRect(const QSize& aSize, const QRect& aViewFinder,
+        int aRotation);
 
 Q_SIGNALS:
     void scanDone(uint aScanId, QImage aImage, QrCodeDecoder::Result aResult);
+    void codeDetected(uint aScanId, QImage aImage, QrCodeDecoder::Result aResult);
     void decodingFinished(QVariantMap Result);
     void needImage();
+    void governorUpdated(QSize aDecodeSize, int aFrameInterval,
+        int aDecodeTime);
 
 public Q_SLOTS:
     void onScanDone(uint aScanId, QImage aImage, QrCodeDecoder::Result aResult);
+    void onCodeDetected(uint aScanId, QImage aImage, QrCodeDecoder::Result aResult);
+    void onGovernorUpdated(QSize aDecodeSize, int aFrameInterval,
+        int aDecodeTime);
     void onGrabImage();
+    void onVideoFrameProbed(const QVideoFrame& aFrame);
+    void updateVideoProbe();
+    void onIdleTimeout();
 
 public:
-    QrCodeDecoder* iDecoder;
+    QThreadPool* iDecodePool;
+    QTimer* iIdleTimer;
+    QrCodeFrameDecoder* iFrameDecoder;  // Used by the scan thread
+    int iResidentMemory;
     QQuickItem* iViewFinderItem;
+    QPointer<QQuickItem> iVideoOutput;
+    QVideoProbe* iVideoProbe;
+    bool iVideoProbeActive;
+    bool iVideoProbeFailed;     // Frames can't be read, e.g. GPU buffers
+    bool iNeedFrame;
+    QVideoFrame iCaptureFrame;
+    int iFrameRotation;
     QImage iCaptureImage;
     int iRotation;
     bool iTryRotated;
+    bool iContinuous;
+    int iDecodeBudget;
     bool iGrabbing;
     bool iStopScan;
     uint iCurrentScanId;
@@ -107,27 +151,65 @@ public:
 
     QRect iViewFinderRect;
     QColor iMarkerColor;
+
+    // Last reported by the governor
+    QSize iDecodeSize;
+    int iFrameInterval;
+    int iDecodeTime;
 };
 
 QrCodeScanner::Private::Private(QrCodeScanner* aParent) :
     QObject(aParent),
-    iDecoder(new QrCodeDecoder),
+    iDecodePool(new QThreadPool(this)),
+    iIdleTimer(new QTimer(this)),
+    iFrameDecoder(new QrCodeFrameDecoder(iDecodePool)),
+    iResidentMemory(0),
     iViewFinderItem(NULL),
+    iVideoProbe(new QVideoProbe(this)),
+    iVideoProbeActive(false),
+    iVideoProbeFailed(false),
+    iNeedFrame(false),
+    iFrameRotation(0),
     iRotation(0),
     iTryRotated(false),
+    iContinuous(false),
+    iDecodeBudget(QrCodeFrameDecoder::DefaultBudget),
     iGrabbing(false),
     iCurrentScanId(0),
     iNextScanId(1),
-    iMarkerColor(QColor(0, 255, 0)) // default green
+    iMarkerColor(QColor(0, 255, 0)), // default green
+    iFrameInterval(0),
+    iDecodeTime(0)
 {
+    // Decoders are allocated when scanning starts
+    iDecodeSize = iFrameDecoder->decodeSize();
+    iIdleTimer->setSingleShot(true);
+    iIdleTimer->setInterval(IdleTimeout);
+    connect(iIdleTimer, SIGNAL(timeout()), SLOT(onIdleTimeout()));
+
+    // Separate pool so that the scan thread (which is running in the
+    // global pool) can't starve the decoding tasks. Its threads go
+    // away together with the decoders.
+    iDecodePool->setMaxThreadCount(qMax(QThread::idealThreadCount(), 1));
+    iDecodePool->setExpiryTimeout(IdleTimeout);
     // Handled on the main thread
     connect(this, SIGNAL(scanDone(uint,QImage,QrCodeDecoder::Result)),
         SLOT(onScanDone(uint,QImage,QrCodeDecoder::Result)),
         Qt::QueuedConnection);
+    connect(this, SIGNAL(codeDetected(uint,QImage,QrCodeDecoder::Result)),
+        SLOT(onCodeDetected(uint,QImage,QrCodeDecoder::Result)),
+        Qt::QueuedConnection);
+    connect(this, SIGNAL(governorUpdated(QSize,int,int)),
+        SLOT(onGovernorUpdated(QSize,int,int)),
+        Qt::QueuedConnection);
 
     // Forward needImage emitted by the decoding thread
     connect(this, SIGNAL(needImage()), SLOT(onGrabImage()),
         Qt::QueuedConnection);
+
+    // Camera frames are delivered on the main thread
+    connect(iVideoProbe, SIGNAL(videoFrameProbed(QVideoFrame)),
+        SLOT(onVideoFrameProbed(QVideoFrame)));
 }
 
 QrCodeScanner::Private::~Private()
@@ -136,7 +218,8 @@ QrCodeScanner::Private::~Private()
         requestStop();
         iScanFuture.waitForFinished();
     }
-    delete iDecoder;
+    iDecodePool->waitForDone();
+    delete iFrameDecoder;
 }
 
 inline QrCodeScanner* QrCodeScanner::Private::scanner()
@@ -144,6 +227,48 @@ inline QrCodeScanner* QrCodeScanner::Private::scanner()
     return qobject_cast<QrCodeScanner*>(parent());
 }
 
+void QrCodeScanner::Private::onIdleTimeout()
+{
+    if (!iCurrentScanId && iFrameDecoder->allocated()) {
+        if (iScanFuture.isStarted() && !iScanFuture.isFinished()) {
+            // The scan thread is on its way out
+            iScanFuture.waitForFinished();
+        }
+        iDecodePool->waitForDone();
+        iFrameDecoder->release();
+        iCaptureImage = QImage();
+        iCaptureFrame = QVideoFrame();
+        HDEBUG("decoders released");
+        Q_EMIT scanner()->decoderAllocatedChanged();
+        updateResidentMemory();
+    }
+}
+
+int QrCodeScanner::Private::currentResidentMemory()
+{
+    // The second number in /proc/self/statm is the resident set size
+    // in pages
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields(statm.readAll().split(' '));
+        if (fields.count() > 1) {
+            return (int)(fields.at(1).toLongLong() *
+                sysconf(_SC_PAGESIZE) / 1024);
+        }
+    }
+    return 0;
+}
+
+void QrCodeScanner::Private::updateResidentMemory()
+{
+    const int kb = currentResidentMemory();
+    if (iResidentMemory != kb) {
+        HDEBUG("resident memory" << kb << "kB");
+        iResidentMemory = kb;
+        Q_EMIT scanner()->residentMemoryChanged();
+    }
+}
+
 void QrCodeScanner::Private::onGrabImage()
 {
     if (iViewFinderItem && !iStopScan) {
@@ -169,185 +294,262 @@ void QrCodeScanner::Private::onGrabImage()
     }
 }
 
-void QrCodeScanner::Private::scanThread(uint aScanId)
+void QrCodeScanner::Private::setVideoOutput(QQuickItem* aItem)
 {
-    HDEBUG("scan started");
-
-    QrCodeDecoder::Result result;
-    QImage image;
-    qreal scale = 1;
-    bool rotated = false;
-    int scaledWidth = 0;
+    if (iVideoOutput) {
+        iVideoOutput->disconnect(this);
+    }
+    iVideoOutput = aItem;
+    if (aItem) {
+        connect(aItem, SIGNAL(sourceChanged()), SLOT(updateVideoProbe()));
+    }
+    updateVideoProbe();
+}
 
-    const int maxWidth = 600;
-    const int maxHeight = 800;
+void QrCodeScanner::Private::updateVideoProbe()
+{
+    // VideoOutput.source is a QML Camera which exposes the underlying
+    // QCamera as its mediaObject property
+    QObject* source = iVideoOutput ?
+        qvariant_cast<QObject*>(iVideoOutput->property("source")) : NULL;
+    QMediaObject* camera = source ? qobject_cast<QMediaObject*>
+        (qvariant_cast<QObject*>(source->property("mediaObject"))) : NULL;
+    const bool active = iVideoProbe->setSource(camera) && camera;
+
+    HDEBUG("video probe" << (active ? "active" : "inactive"));
+    iScanMutex.lock();
+    iVideoProbeActive = active;
+    iVideoProbeFailed = false;
+    if (!active) {
+        iCaptureFrame = QVideoFrame();
+    }
+    iScanEvent.wakeAll();
+    iScanMutex.unlock();
+}
 
+void QrCodeScanner::Private::onVideoFrameProbed(const QVideoFrame& aFrame)
+{
+    // Just hand the frame over to the scan thread, it's mapped there
     iScanMutex.lock();
-    while (!iStopScan && !result.isValid()) {
-        while (!iStopScan && !iViewFinderItem) {
-            iScanEvent.wait(&iScanMutex);
-        }
+    if (iNeedFrame && !iStopScan && aFrame.isValid()) {
+        iNeedFrame = false;
+        iCaptureFrame = aFrame;
+        iFrameRotation = iVideoOutput ?
+            iVideoOutput->property("orientation").toInt() : 0;
+        iScanEvent.wakeAll();
+    }
+    iScanMutex.unlock();
+}
+
+// ==========================================================================
+// QrCodeScanner::Private
+// ==========================================================================
+
+QRect QrCodeScanner::Private::cropRect(const QSize& aSize,
+    const QRect& aViewFinder, int aRotation)
+{
+    // Maps the viewfinder into the (always portrait) screenshot
+    switch (aRotation) {
+    case 90:
+        return QRect(aSize.width() - aViewFinder.bottom(),
+            aViewFinder.left(), aViewFinder.height(), aViewFinder.width());
+    case 180:
+        return QRect(aSize.width() - aViewFinder.right(),
+            aSize.height() - aViewFinder.bottom(),
+            aViewFinder.width(), aViewFinder.height());
+    case 270:
+        return QRect(aViewFinder.top(),
+            aSize.height() - aViewFinder.right(),
+            aViewFinder.height(), aViewFinder.width());
+    default:
+        return aViewFinder;
+    }
+}
 
-        QRect viewFinderRect;
-        int rotation;
-        int tryRotated;
+void QrCodeScanner::Private::scanThread(uint aScanId)
+{
+    HDEBUG("scan started");
 
-        if (!iStopScan && iViewFinderItem) {
-            emit needImage();
-            while (!iStopScan && iCaptureImage.isNull()) {
+    QrCodeDecoder::Result result;
+    QImage image;
+    QVideoFrame frame;
+    QRect viewFinderRect;
+    int frameRotation = 0;
+    int rotation = 0;
+    QElapsedTimer pauseTimer;
+
+    iFrameDecoder->clearStats();
+
+    // In continuous mode, the scan goes on after a code has been found,
+    // until it's stopped. Codes which have already been reported are
+    // ignored.
+    QSet<QString> seen;
+    bool continuous = false;
+    for (;;) {
+        iScanMutex.lock();
+        while (!iStopScan && !result.isValid()) {
+            while (!iStopScan && !iViewFinderItem &&
+                (!iVideoProbeActive || iVideoProbeFailed)) {
                 iScanEvent.wait(&iScanMutex);
             }
-        }
 
-        viewFinderRect = iViewFinderRect;
-        rotation = iRotation;
-        tryRotated = iTryRotated;
-        if (!iStopScan) {
-            image = iCaptureImage;
-            iCaptureImage = QImage();
-        } else {
-            image = QImage();
-        }
-        iScanMutex.unlock();
+            // Give the CPU a break if the governor asks for it
+            if (pauseTimer.isValid()) {
+                qint64 left;
+                while (!iStopScan && (left = iFrameDecoder->frameInterval() -
+                    pauseTimer.elapsed()) > 0) {
+                    iScanEvent.wait(&iScanMutex, (ulong)left);
+                }
+            }
 
-        if (!image.isNull()) {
-#if HARBOUR_DEBUG
-            QTime time(QTime::currentTime());
-#endif
-            // Crop the image - we need only the viewfinder
-            saveDebugImage(image, "debug_screenshot.bmp");
+            if (!iStopScan && iVideoProbeActive && !iVideoProbeFailed) {
+                // Take the next camera frame
+                iNeedFrame = true;
+                while (!iStopScan && iVideoProbeActive &&
+                    !iVideoProbeFailed && !iCaptureFrame.isValid()) {
+                    iScanEvent.wait(&iScanMutex);
+                }
+                iNeedFrame = false;
+            } else if (!iStopScan && iViewFinderItem) {
+                // Fall back to grabbing the window
+                emit needImage();
+                while (!iStopScan && iCaptureImage.isNull()) {
+                    iScanEvent.wait(&iScanMutex);
+                }
+            }
+
+            viewFinderRect = iViewFinderRect;
+            frameRotation = iFrameRotation;
+            rotation = iRotation;
+            continuous = iContinuous;
+            iFrameDecoder->setTryRotated(iTryRotated);
+            iFrameDecoder->setBudget(iDecodeBudget);
+            if (!iStopScan) {
+                image = iCaptureImage;
+                frame = iCaptureFrame;
+                iCaptureImage = QImage();
+                iCaptureFrame = QVideoFrame();
+            } else {
+                image = QImage();
+                frame = QVideoFrame();
+            }
+            iScanMutex.unlock();
 
-            // Grabbed image is always in portrait orientation
             rotation %= 360;
-            switch (rotation) {
-            default:
+            if (rotation % 90 || rotation < 0) {
                 HDEBUG("Invalid rotation angle" << rotation);
-                // fallthrough
-            case 0:
-                image = image.copy(viewFinderRect);
-                break;
-            case 90:
-                {
-                    QRect cropRect(image.width() - viewFinderRect.bottom(),
-                        viewFinderRect.left(), viewFinderRect.height(),
-                        viewFinderRect.width());
-                    image = image.copy(cropRect).transformed(QTransform().
-                        translate(cropRect.width()/2, cropRect.height()/2).
-                        rotate(-90));
-                }
-                break;
-            case 180:
-                {
-                    QRect cropRect(image.width() - viewFinderRect.right(),
-                        image.height() - viewFinderRect.bottom(),
-                        viewFinderRect.width(), viewFinderRect.height());
-                    image = image.copy(cropRect).transformed(QTransform().
-                        translate(cropRect.width()/2, cropRect.height()/2).
-                        rotate(180));
-                }
-                break;
-            case 270:
-                {
-                    QRect cropRect(viewFinderRect.top(),
-                        image.height() - viewFinderRect.right(),
-                        viewFinderRect.height(), viewFinderRect.width());
-                    image = image.copy(cropRect).transformed(QTransform().
-                        translate(cropRect.width()/2, cropRect.height()/2).
-                        rotate(90));
-                }
-                break;
+                rotation = 0;
             }
 
-            HDEBUG("extracted" << image);
-            saveDebugImage(image, "debug_cropped.bmp");
+            // Geometry of the picture (the viewfinder area, rotated)
+            QRect crop;
+            int angle = 0;
+            if (frame.isValid()) {
+                // The whole frame is stretched over the viewfinder, no need
+                // to crop it. Just rotate it the same way as VideoOutput does.
+                crop = QRect(QPoint(0, 0), frame.size());
+                angle = frameRotation;
+            } else if (!image.isNull()) {
+                // Grabbed image is always in portrait orientation
+                saveDebugImage(image, "debug_screenshot.bmp");
+                crop = cropRect(image.size(), viewFinderRect, rotation);
+                angle = rotation;
+            }
 
-            QImage scaledImage;
-            if (image.width() > maxWidth || image.height() > maxHeight) {
-                Qt::TransformationMode mode = Qt::SmoothTransformation;
-                if (maxWidth * image.height() > maxHeight * image.width()) {
-                    scaledImage = image.scaledToHeight(maxHeight, mode);
-                    scale = image.height()/(qreal)maxHeight;
-                    HDEBUG("scaled to height" << scale << scaledImage);
+            if (!crop.isEmpty()) {
+                HDEBUG("decoding screenshot ...");
+                result = iFrameDecoder->decode(image, frame, crop, angle,
+                    seen);
+                if (iFrameDecoder->frameUnreadable()) {
+                    // The frame couldn't be mapped (typically a GPU buffer)
+                    // or its format isn't supported. The next ones won't be
+                    // any different, grab the window from now on.
+                    HWARN("Camera frames are unusable, grabbing the window");
+                    iScanMutex.lock();
+                    iVideoProbeFailed = true;
+                    iScanMutex.unlock();
                 } else {
-                    scaledImage = image.scaledToWidth(maxWidth, mode);
-                    scale = image.width()/(qreal)maxWidth;
-                    HDEBUG("scaled to width" << scale << scaledImage);
+                    if (iFrameDecoder->governorUpdated()) {
+                        emit governorUpdated(iFrameDecoder->decodeSize(),
+                            iFrameDecoder->frameInterval(),
+                            iFrameDecoder->averageTime());
+                    }
+                    pauseTimer.start();
                 }
-                saveDebugImage(scaledImage, "debug_scaled.bmp");
-            } else {
-                scaledImage = image;
-                scale = 1;
             }
+            iScanMutex.lock();
+        }
+        iScanMutex.unlock();
 
-            HDEBUG("decoding screenshot ...");
-            scaledImage = scaledImage.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-            result = iDecoder->decode(scaledImage);
-
-            if (!result.isValid() && tryRotated) {
-                // try the other orientation for 1D bar code
-                QTransform transform;
-                transform.rotate(90);
-                scaledImage = scaledImage.transformed(transform);
-                saveDebugImage(scaledImage, "debug_rotated.bmp");
-                HDEBUG("decoding rotated screenshot ...");
-                result = iDecoder->decode(scaledImage);
-                // We need scaled width for rotating the points back
-                scaledWidth = scaledImage.width();
-                rotated = true;
-            } else {
-                rotated = false;
+        if (result.isValid()) {
+            HDEBUG("decoding succeeded:" << result.getText() << result.getPoints());
+
+            // Full resolution picture to show to the user
+            if (frame.isValid()) {
+                image = QrCodeLuma::extract(frame, QRect(), frameRotation, QSize());
+            } else if (!image.isNull()) {
+                image = image.copy(cropRect(image.size(), viewFinderRect,
+                    rotation)).transformed(QTransform().rotate(-rotation));
             }
-            HDEBUG("decoding took" << time.elapsed() << "ms");
+        } else {
+            HDEBUG("nothing was decoded");
+            image = QImage();
         }
-        iScanMutex.lock();
-    }
-    iScanMutex.unlock();
 
-    if (result.isValid()) {
-        HDEBUG("decoding succeeded:" << result.getText() << result.getPoints());
-        if (scale > 1 || rotated) {
-            // The image could be a) scaled and b) rotated. Convert
-            // points to the original coordinate system
-            QList<QPointF> points = result.getPoints();
-            const int n = points.size();
-            for (int i = 0; i < n; i++) {
-                QPointF p(points.at(i));
-                if (rotated) {
-                    const qreal x = p.rx();
-                    p.setX(p.ry());
-                    p.setY(scaledWidth - x);
+        if (!image.isNull()) {
+            const QList<QPointF> points(result.getPoints());
+            HDEBUG("image:" << image);
+            HDEBUG("points:" << points);
+            HDEBUG("format:" << result.getFormatName());
+            if (!points.isEmpty()) {
+                if (image.format() == QImage::Format_Grayscale8) {
+                    // Make it possible to paint colored markers
+                    image = image.convertToFormat(QImage::Format_RGB32);
                 }
-                p *= scale;
-                HDEBUG(points[i] << "=>" << p);
-                points[i] = p;
+                QPainter painter(&image);
+                painter.setPen(iMarkerColor);
+                QBrush markerBrush(iMarkerColor);
+                for (int i = 0; i < points.size(); i++) {
+                    const QPoint p(points.at(i).toPoint());
+                    painter.fillRect(QRect(p.x()-3, p.y()-15, 6, 30), markerBrush);
+                    painter.fillRect(QRect(p.x()-15, p.y()-3, 30, 6), markerBrush);
+                }
+                painter.end();
+                saveDebugImage(image, "debug_marks.bmp");
             }
-            result = QrCodeDecoder::Result(result.getText(), points, result.getFormatName());
         }
-    } else {
-        HDEBUG("nothing was decoded");
-        image = QImage();
+
+        if (continuous && result.isValid()) {
+            HDEBUG("scan" << aScanId << "continues");
+            seen.insert(result.getText());
+            emit codeDetected(aScanId, image, result);
+            result = QrCodeDecoder::Result();
+            image = QImage();
+            frame = QVideoFrame();
+            iDecodePool->waitForDone();
+        } else {
+            break;
+        }
     }
 
-    if (!image.isNull()) {
-        const QList<QPointF> points(result.getPoints());
-        HDEBUG("image:" << image);
-        HDEBUG("points:" << points);
-        HDEBUG("format:" << result.getFormatName());
-        if (!points.isEmpty()) {
-            QPainter painter(&image);
-            painter.setPen(iMarkerColor);
-            QBrush markerBrush(iMarkerColor);
-            for (int i = 0; i < points.size(); i++) {
-                const QPoint p(points.at(i).toPoint());
-                painter.fillRect(QRect(p.x()-3, p.y()-15, 6, 30), markerBrush);
-                painter.fillRect(QRect(p.x()-15, p.y()-3, 30, 6), markerBrush);
-            }
-            painter.end();
-            saveDebugImage(image, "debug_marks.bmp");
+#if HARBOUR_DEBUG
+    const QrCodeFrameDecoder::Stats& stats = iFrameDecoder->stats();
+    if (stats.iFrames) {
+        QStringList wins;
+        for (int i = 0; i < QrCodeFrameDecoder::HypothesisCount; i++) {
+            wins.append(QString::number(stats.iWins[i]));
         }
+        HDEBUG("scan" << aScanId << "frames:" << stats.iFrames <<
+            "decoded:" << stats.iDecoded << "avg:" << (stats.iTotalMs /
+            stats.iFrames) << "ms max:" << stats.iMaxMs << "ms allocations:" <<
+            stats.iAllocs << "wins:" << qPrintable(wins.join('/')));
     }
+#endif
 
     emit scanDone(aScanId, image, result);
+
+    // Let the losing hypotheses finish before the decoders get reused
+    iDecodePool->waitForDone();
 }
 
 void QrCodeScanner::Private::onScanDone(uint aScanId, QImage aImage,
@@ -356,18 +558,47 @@ void QrCodeScanner::Private::onScanDone(uint aScanId, QImage aImage,
     if (aScanId == iCurrentScanId) {
         HDEBUG("scan" << aScanId << "done");
         iCaptureImage = QImage();
+        iCaptureFrame = QVideoFrame();
         iCurrentScanId = 0;
+        iIdleTimer->start();
+        updateResidentMemory();
 
-        QVariantMap result;
-        result.insert("valid", QVariant::fromValue(aResult.isValid()));
-        result.insert("text", QVariant::fromValue(aResult.getText()));
         Q_EMIT scanner()->scanningChanged();
-        Q_EMIT scanner()->scanFinished(result, aImage);
+        Q_EMIT scanner()->scanFinished(resultMap(aResult), aImage);
     } else {
         HDEBUG("unexpected scan");
     }
 }
 
+void QrCodeScanner::Private::onCodeDetected(uint aScanId, QImage aImage,
+    QrCodeDecoder::Result aResult)
+{
+    if (aScanId == iCurrentScanId) {
+        HDEBUG("scan" << aScanId << "detected" << aResult.getText());
+        Q_EMIT scanner()->codeDetected(resultMap(aResult), aImage);
+    } else {
+        HDEBUG("stale code");
+    }
+}
+
+void QrCodeScanner::Private::onGovernorUpdated(QSize aDecodeSize,
+    int aFrameInterval, int aDecodeTime)
+{
+    iDecodeTime = aDecodeTime;
+    iDecodeSize = aDecodeSize;
+    iFrameInterval = aFrameInterval;
+    Q_EMIT scanner()->governorChanged();
+}
+
+QVariantMap QrCodeScanner::Private::resultMap(
+    const QrCodeDecoder::Result& aResult)
+{
+    QVariantMap result;
+    result.insert("valid", QVariant::fromValue(aResult.isValid()));
+    result.insert("text", QVariant::fromValue(aResult.getText()));
+    return result;
+}
+
 void QrCodeScanner::Private::requestStop()
 {
     if (!iStopScan) {
@@ -387,7 +618,14 @@ void QrCodeScanner::Private::start()
             iScanFuture.waitForFinished();
         }
         iStopScan = false;
+        iNeedFrame = false;
         iCaptureImage = QImage();
+        iCaptureFrame = QVideoFrame();
+        iIdleTimer->stop();
+        updateResidentMemory();
+        if (iFrameDecoder->allocate()) {
+            Q_EMIT scanner()->decoderAllocatedChanged();
+        }
         while (!(iCurrentScanId = iNextScanId++));
         HDEBUG("starting scan" << iCurrentScanId);
         iScanFuture = QtConcurrent::run(this, &Private::scanThread, iCurrentScanId);
@@ -400,6 +638,7 @@ void QrCodeScanner::Private::stop()
     if (iCurrentScanId) {
         HDEBUG("stopping scan" << iCurrentScanId);
         iCurrentScanId = 0;
+        iIdleTimer->start();
         requestStop();
         Q_EMIT scanner()->scanningChanged();
     }
@@ -436,6 +675,20 @@ void QrCodeScanner::Private::setTryRotated(bool aTryRotated)
     iScanMutex.unlock();
 }
 
+void QrCodeScanner::Private::setContinuous(bool aContinuous)
+{
+    iScanMutex.lock();
+    iContinuous = aContinuous;
+    iScanMutex.unlock();
+}
+
+void QrCodeScanner::Private::setDecodeBudget(int aBudget)
+{
+    iScanMutex.lock();
+    iDecodeBudget = aBudget;
+    iScanMutex.unlock();
+}
+
 // ==========================================================================
 // QrCodeScanner
 // ==========================================================================
@@ -481,6 +734,59 @@ void QrCodeScanner::setTryRotated(bool aTryRotated)
     }
 }
 
+bool QrCodeScanner::continuous() const
+{
+    return iPrivate->iContinuous;
+}
+
+void QrCodeScanner::setContinuous(bool aContinuous)
+{
+    if (iPrivate->iContinuous != aContinuous) {
+        HDEBUG(aContinuous);
+        iPrivate->setContinuous(aContinuous);
+        Q_EMIT continuousChanged();
+    }
+}
+
+int QrCodeScanner::decodeBudget() const
+{
+    return iPrivate->iDecodeBudget;
+}
+
+void QrCodeScanner::setDecodeBudget(int aBudget)
+{
+    if (aBudget > 0 && iPrivate->iDecodeBudget != aBudget) {
+        HDEBUG(aBudget);
+        iPrivate->setDecodeBudget(aBudget);
+        Q_EMIT decodeBudgetChanged();
+    }
+}
+
+QSize QrCodeScanner::decodeSize() const
+{
+    return iPrivate->iDecodeSize;
+}
+
+int QrCodeScanner::frameInterval() const
+{
+    return iPrivate->iFrameInterval;
+}
+
+int QrCodeScanner::decodeTime() const
+{
+    return iPrivate->iDecodeTime;
+}
+
+bool QrCodeScanner::decoderAllocated() const
+{
+    return iPrivate->iFrameDecoder->allocated();
+}
+
+int QrCodeScanner::residentMemory() const
+{
+    return iPrivate->iResidentMemory;
+}
+
 bool QrCodeScanner::grabbing() const
 {
     return iPrivate->iGrabbing;
@@ -515,6 +821,20 @@ void QrCodeScanner::setViewFinderRect(const QRect& aRect)
     }
 }
 
+QObject* QrCodeScanner::videoOutput() const
+{
+    return iPrivate->iVideoOutput.data();
+}
+
+void QrCodeScanner::setVideoOutput(QObject* aItem)
+{
+    QQuickItem* item = qobject_cast<QQuickItem*>(aItem);
+    if (iPrivate->iVideoOutput != item) {
+        iPrivate->setVideoOutput(item);
+        Q_EMIT videoOutputChanged();
+    }
+}
+
 QObject* QrCodeScanner::viewFinderItem() const
 {
     return iPrivate->iViewFinderItem;
@@ -39,6 +39,7 @@
 #define QRCODE_SCANNER_H
 
 #include <QRect>
+#include <QSize>
 #include <QColor>
 #include <QImage>
 #include <QObject>
@@ -49,12 +50,20 @@ class QrCodeScanner :
 {
     Q_OBJECT
     Q_PROPERTY(QObject* viewFinderItem READ viewFinderItem WRITE setViewFinderItem NOTIFY viewFinderItemChanged)
+    Q_PROPERTY(QObject* videoOutput READ videoOutput WRITE setVideoOutput NOTIFY videoOutputChanged)
     Q_PROPERTY(QRect viewFinderRect READ viewFinderRect WRITE setViewFinderRect NOTIFY viewFinderRectChanged)
     Q_PROPERTY(QColor markerColor READ markerColor WRITE setMarkerColor NOTIFY markerColorChanged)
     Q_PROPERTY(bool scanning READ scanning NOTIFY scanningChanged)
     Q_PROPERTY(bool grabbing READ grabbing NOTIFY grabbingChanged)
     Q_PROPERTY(bool tryRotated READ tryRotated WRITE setTryRotated NOTIFY tryRotatedChanged)
+    Q_PROPERTY(bool continuous READ continuous WRITE setContinuous NOTIFY continuousChanged)
     Q_PROPERTY(int rotation READ rotation WRITE setRotation NOTIFY rotationChanged)
+    Q_PROPERTY(int decodeBudget READ decodeBudget WRITE setDecodeBudget NOTIFY decodeBudgetChanged)
+    Q_PROPERTY(QSize decodeSize READ decodeSize NOTIFY governorChanged)
+    Q_PROPERTY(int frameInterval READ frameInterval NOTIFY governorChanged)
+    Q_PROPERTY(int decodeTime READ decodeTime NOTIFY governorChanged)
+    Q_PROPERTY(bool decoderAllocated READ decoderAllocated NOTIFY decoderAllocatedChanged)
+    Q_PROPERTY(int residentMemory READ residentMemory NOTIFY residentMemoryChanged)
 
 public:
     QrCodeScanner(QObject* aParent = Q_NULLPTR);
@@ -66,15 +75,33 @@ public:
     bool tryRotated() const;
     void setTryRotated(bool);
 
+    bool continuous() const;
+    void setContinuous(bool);
+
     bool grabbing() const;
     bool scanning() const;
 
+    // Decoding latency target (ms) and the parameters picked to meet it
+    int decodeBudget() const;
+    void setDecodeBudget(int);
+    QSize decodeSize() const;
+    int frameInterval() const;
+    int decodeTime() const;
+
+    // Decoders are allocated on start() and released when idle.
+    // Resident memory (kB) is sampled when that happens.
+    bool decoderAllocated() const;
+    int residentMemory() const;
+
     const QRect& viewFinderRect() const;
     void setViewFinderRect(const QRect&);
 
     QObject* viewFinderItem() const;
     void setViewFinderItem(QObject*);
 
+    QObject* videoOutput() const;
+    void setVideoOutput(QObject*);
+
     const QColor& markerColor() const;
     void setMarkerColor(const QColor&);
 
@@ -83,13 +110,20 @@ public:
 
 Q_SIGNALS:
     void viewFinderItemChanged();
+    void videoOutputChanged();
     void viewFinderRectChanged();
     void markerColorChanged();
     void scanningChanged();
     void grabbingChanged();
     void tryRotatedChanged();
+    void continuousChanged();
     void rotationChanged();
+    void decodeBudgetChanged();
+    void governorChanged();
+    void decoderAllocatedChanged();
+    void residentMemoryChanged();
     void scanFinished(QVariantMap result, QImage image);
+    void codeDetected(QVariantMap result, QImage image);
 
 private:
     class Private;
@@ -36,14 +36,16 @@
  * any official policies, either expressed or implied.
  */
 
+#include "foil_random.h"
+
 #include "YubiKey.h"
 
 #include "YubiKeyAuth.h"
 #include "YubiKeyIo.h"
 #include "YubiKeyOpQueue.h"
+#include "YubiKeyPeriodClock.h"
 #include "YubiKeyUtil.h"
 
-#include "HarbourBase32.h"
 #include "HarbourDebug.h"
 #include "HarbourParentSignalQueueObject.h"
 #include "HarbourUtil.h"
@@ -54,6 +56,8 @@
 #include <QtCore/QTimer>
 #include <QtCore/QtEndian>
 
+#include <QtGui/QGuiApplication>
+
 // s(SignalName,signalName)
 #define QUEUED_SIGNALS(s) \
     s(YubiKeyIo,yubiKeyIo) \
@@ -87,8 +91,8 @@ class YubiKey::Private :
 {
     Q_OBJECT
     static const SignalEmitter gSignalEmitters[];
-    static const YubiKeyIo::APDU LIST_APDU;
-    static const YubiKeyIo::APDU CALCULATE_ALL_APDU;
+    static const YubiKeyIo::Header LIST_APDU;
+    static const YubiKeyIo::Header CALCULATE_ALL_APDU;
 
     // (relatively) easy way to get command specific OpData from a YubiKeyOp
     // completion slot
@@ -119,7 +123,12 @@ public:
     };
 
     enum {
-        MinKeySize = 14
+        MinKeySize = 14,
+        // USB auto-refresh is issued this long after the period boundary,
+        // plus a random delay up to AutoRefreshJitterMs so that different
+        // keys (and app instances) don't all hit the bus at the same time
+        AutoRefreshDelayMs = 100,
+        AutoRefreshJitterMs = 400
     };
 
     Private(YubiKey*);
@@ -127,6 +136,7 @@ public:
     static YubiKeyTokenType toAuthType(uchar);
     static YubiKeyAlgorithm toAuthAlgorithm(uchar);
     static qint64 currentPeriod();
+    static int autoRefreshDelay();
     static YubiKeyOtp updateOtpResponseFull(const YubiKeyOtp&, const GUtilData*);
 
     void setIo(YubiKeyIo*);
@@ -137,10 +147,18 @@ public:
     void resetOtpList();
     void passwordUpdateStarted();
     void updateTotpTimer();
+    void stopTotpTimer();
+    qreal totpTimeLeft() const;
+    static bool applicationActive();
+    bool refreshInProgress() const;
+    void updateAutoRefresh();
+    void autoRefresh();
     void listAndCalculateAll();
     void calculateAll(OtpList);
     YubiKeyOp* reset();
+    static YubiKeyIo::APDU putApdu(const YubiKeyToken&);
     YubiKeyOp* putToken(const YubiKeyToken&, YubiKeyOp::OpData* aData = Q_NULLPTR);
+    YubiKeyOp* putTokens(const QList<YubiKeyToken>&);
 
 public Q_SLOTS:
     void onIoStateChanged();
@@ -149,11 +167,16 @@ public Q_SLOTS:
     void onSetCodeFinished(uint, const QByteArray&);
     void onResetFinished(uint, const QByteArray&);
     void onRefreshFinished(uint, const QByteArray&);
+    void onPutTokensFinished(uint, const QByteArray&);
+    void onPutTokensStateChanged();
     void onPasswordUpdateFinished();
     void onYubiKeyConnected();
     void onYubiKeyIdChanged();
     void onAuthAccessChanged();
-    void onTotpTimer();
+    void onTotpPeriodChanged();
+    void onAutoRefreshPeriodChanged();
+    void onAutoRefreshTimer();
+    void onApplicationStateChanged();
 
 public:
     QPointer<YubiKeyIo> iIo;
@@ -165,10 +188,13 @@ public:
     bool iOtpListFetched;
     bool iHaveTotpCodes;
     bool iHaveBeenReset;
-    int iTotpTimeLeft;              // seconds
+    bool iTotpCodesCurrent;
     qint64 iLastRequestedPeriod;    // seconds
     qint64 iLastReceivedPeriod;     // seconds
-    QTimer iTotpTimer;
+    QSharedPointer<YubiKeyPeriodClock> iPeriodClock;
+    QPointer<YubiKeyOp> iRefreshOp;
+    QTimer iAutoRefreshTimer;
+    bool iAutoRefresh;
 };
 
 /* static */
@@ -180,8 +206,8 @@ YubiKey::Private::gSignalEmitters [] = {
 };
 
 /* static */
-const YubiKeyIo::APDU YubiKey::Private::LIST_APDU("LIST", 0x00, 0xa1);
-const YubiKeyIo::APDU YubiKey::Private::CALCULATE_ALL_APDU("CALCULATE_ALL", 0x00, 0xa4);
+const YubiKeyIo::Header YubiKey::Private::LIST_APDU("LIST", 0x00, 0xa1);
+const YubiKeyIo::Header YubiKey::Private::CALCULATE_ALL_APDU("CALCULATE_ALL", 0x00, 0xa4);
 
 YubiKey::Private::Private(
     YubiKey* aYubiKey) :
@@ -192,12 +218,19 @@ YubiKey::Private::Private(
     iOtpListFetched(false),
     iHaveTotpCodes(false),
     iHaveBeenReset(false),
-    iTotpTimeLeft(0),
+    iTotpCodesCurrent(false),
     iLastRequestedPeriod(0),
-    iLastReceivedPeriod(0)
+    iLastReceivedPeriod(0),
+    iPeriodClock(YubiKeyPeriodClock::sharedInstance()),
+    iAutoRefresh(false)
 {
-    iTotpTimer.setSingleShot(true);
-    connect(&iTotpTimer, SIGNAL(timeout()), SLOT(onTotpTimer()));
+    iAutoRefreshTimer.setSingleShot(true);
+    connect(&iAutoRefreshTimer, SIGNAL(timeout()), SLOT(onAutoRefreshTimer()));
+    if (qGuiApp) {
+        connect(qGuiApp,
+            SIGNAL(applicationStateChanged(Qt::ApplicationState)),
+            SLOT(onApplicationStateChanged()));
+    }
 
     connect(&iOpQueue, SIGNAL(yubiKeyIdChanged()),
         SLOT(onYubiKeyIdChanged()));
@@ -266,6 +299,16 @@ YubiKey::Private::currentPeriod()
     return QDateTime::currentMSecsSinceEpoch() / (TOTP_PERIOD_SEC * 1000);
 }
 
+/* static */
+int
+YubiKey::Private::autoRefreshDelay()
+{
+    guint16 jitter = 0;
+
+    foil_random(&jitter, sizeof(jitter));
+    return AutoRefreshDelayMs + (jitter % AutoRefreshJitterMs);
+}
+
 inline
 void
 YubiKey::Private::resetOtpList()
@@ -316,6 +359,7 @@ YubiKey::Private::updateTransport()
     if (iTransport != transport) {
         iTransport = transport;
         queueSignal(SignalTransportChanged);
+        updateAutoRefresh();
     }
 }
 
@@ -328,6 +372,7 @@ YubiKey::Private::updatePresent()
         iPresent = present;
         HDEBUG(iPresent);
         queueSignal(SignalPresentChanged);
+        updateAutoRefresh();
     }
 }
 
@@ -385,7 +430,7 @@ YubiKey::Private::onAuthAccessChanged()
 }
 
 void
-YubiKey::Private::onTotpTimer()
+YubiKey::Private::onTotpPeriodChanged()
 {
     updateTotpTimer();
     emitQueuedSignals();
@@ -394,22 +439,24 @@ YubiKey::Private::onTotpTimer()
 void
 YubiKey::Private::updateTotpTimer()
 {
-    const qint64 msecsSinceEpoch = QDateTime::currentMSecsSinceEpoch();
-    const qint64 secsSinceEpoch = msecsSinceEpoch / 1000;
-    const qint64 thisPeriod = secsSinceEpoch / TOTP_PERIOD_SEC;
-    const int lastTotpTimeLeft = iTotpTimeLeft;
-
-    if (iLastReceivedPeriod == thisPeriod) {
-        const qint64 endOfThisPeriod = (thisPeriod + 1) * TOTP_PERIOD_SEC;
-        const qint64 nextSecond = (secsSinceEpoch + 1) * 1000;
-
-        iTotpTimeLeft = (int)(endOfThisPeriod - secsSinceEpoch);
-        iTotpTimer.start((int)(nextSecond - msecsSinceEpoch));
+    if (iLastReceivedPeriod == iPeriodClock->currentPeriod()) {
+        // Fresh codes have been received, the countdown starts over.
+        // There's no need to wake up before the end of the period,
+        // the countdown is animated by QML.
+        HDEBUG(totpTimeLeft() << "sec left");
+        iTotpCodesCurrent = true;
+        connect(iPeriodClock.data(), SIGNAL(periodChanged()),
+            SLOT(onTotpPeriodChanged()), Qt::UniqueConnection);
+        queueSignal(SignalTotpTimeLeftChanged);
     } else {
-        iTotpTimeLeft = 0;
-        iTotpTimer.stop();
-        // Try to refresh the passwords
-        if (iIo) {
+        stopTotpTimer();
+        // Try to refresh the passwords. USB keys are refreshed by
+        // the auto-refresh logic (unless it's suspended).
+        if (iTransport == TransportUSB) {
+            if (iAutoRefresh) {
+                iAutoRefreshTimer.start(autoRefreshDelay());
+            }
+        } else if (iIo) {
             switch (iIo->ioState()) {
             case YubiKeyIo::IoTargetInvalid:
             case YubiKeyIo::IoTargetGone:
@@ -428,13 +475,116 @@ YubiKey::Private::updateTotpTimer()
             }
         }
     }
+}
 
-    if (lastTotpTimeLeft != iTotpTimeLeft) {
-        HDEBUG(iTotpTimeLeft << "sec left");
+void
+YubiKey::Private::stopTotpTimer()
+{
+    iPeriodClock->disconnect(SIGNAL(periodChanged()), this,
+        SLOT(onTotpPeriodChanged()));
+    if (iTotpCodesCurrent) {
+        HDEBUG("TOTP codes expired");
+        iTotpCodesCurrent = false;
         queueSignal(SignalTotpTimeLeftChanged);
     }
 }
 
+qreal
+YubiKey::Private::totpTimeLeft() const
+{
+    // Calculated on demand, totpTimeLeftChanged is only emitted when
+    // the countdown starts or stops.
+    return (iTotpCodesCurrent &&
+        iLastReceivedPeriod == iPeriodClock->currentPeriod()) ?
+        iPeriodClock->msecsLeft() / 1000.0 : 0;
+}
+
+/* static */
+bool
+YubiKey::Private::applicationActive()
+{
+    return !qGuiApp || qGuiApp->applicationState() == Qt::ApplicationActive;
+}
+
+bool
+YubiKey::Private::refreshInProgress() const
+{
+    if (iRefreshOp) {
+        switch (iRefreshOp->opState()) {
+        case YubiKeyOp::OpQueued:
+        case YubiKeyOp::OpActive:
+            return true;
+        case YubiKeyOp::OpCancelled:
+        case YubiKeyOp::OpFinished:
+        case YubiKeyOp::OpFailed:
+            break;
+        }
+    }
+    return false;
+}
+
+void
+YubiKey::Private::updateAutoRefresh()
+{
+    // TOTP codes of a USB attached key are refreshed right after each
+    // period boundary, but only while the application is active.
+    const bool enable = iPresent && iTransport == TransportUSB &&
+        iHaveTotpCodes && applicationActive();
+
+    if (iAutoRefresh != enable) {
+        iAutoRefresh = enable;
+        HDEBUG("auto-refresh" << (enable ? "on" : "off"));
+        if (enable) {
+            connect(iPeriodClock.data(), SIGNAL(periodChanged()),
+                SLOT(onAutoRefreshPeriodChanged()), Qt::UniqueConnection);
+            // Catch up if the period has changed while we were suspended
+            autoRefresh();
+        } else {
+            iPeriodClock->disconnect(SIGNAL(periodChanged()), this,
+                SLOT(onAutoRefreshPeriodChanged()));
+            iAutoRefreshTimer.stop();
+        }
+    }
+}
+
+void
+YubiKey::Private::autoRefresh()
+{
+    const qint64 thisPeriod = currentPeriod();
+
+    if (iLastReceivedPeriod == thisPeriod) {
+        HDEBUG("codes are up to date");
+    } else if (refreshInProgress()) {
+        // Coalesce with the refresh already in flight
+        HDEBUG("refresh is already in progress");
+    } else {
+        HDEBUG("refreshing codes for period" << thisPeriod);
+        calculateAll(iOtpList);
+    }
+}
+
+void
+YubiKey::Private::onAutoRefreshPeriodChanged()
+{
+    // Give the clocks some slack, so that currentPeriod() is guaranteed
+    // to be already pointing to the new period when the refresh is issued.
+    iAutoRefreshTimer.start(autoRefreshDelay());
+}
+
+void
+YubiKey::Private::onAutoRefreshTimer()
+{
+    autoRefresh();
+    emitQueuedSignals();
+}
+
+void
+YubiKey::Private::onApplicationStateChanged()
+{
+    updateAutoRefresh();
+    emitQueuedSignals();
+}
+
 YubiKey::Private::OtpList
 YubiKey::Private::mixOtpLists(
     OtpList aList)
@@ -486,11 +636,10 @@ YubiKey::Private::setOtpList(
             queueSignal(SignalHaveTotpCodesChanged);
         }
         if (!iHaveTotpCodes) {
-            iTotpTimer.stop();
-            if (iTotpTimeLeft) {
-                iTotpTimeLeft = 0;
-                queueSignal(SignalTotpTimeLeftChanged);
-            }
+            stopTotpTimer();
+        }
+        if (hadTotpCodes != iHaveTotpCodes) {
+            updateAutoRefresh();
         }
     }
 }
@@ -527,10 +676,10 @@ YubiKey::Private::updateOtpResponseFull(
     return otp;
 }
 
-YubiKeyOp*
-YubiKey::Private::putToken(
-    const YubiKeyToken& aToken,
-    YubiKeyOp::OpData* aData)
+/* static */
+YubiKeyIo::APDU
+YubiKey::Private::putApdu(
+    const YubiKeyToken& aToken)
 {
     YubiKeyIo::APDU apdu("PUT", 0x00, 0x01);
 
@@ -589,10 +738,55 @@ YubiKey::Private::putToken(
         apdu.appendTLV(TLV_TAG_IMF, sizeof(imf), &imf);
     }
 
-    return iOpQueue.queue(apdu, YubiKeyOpQueue::KeySpecific,
+    return apdu;
+}
+
+YubiKeyOp*
+YubiKey::Private::putToken(
+    const YubiKeyToken& aToken,
+    YubiKeyOp::OpData* aData)
+{
+    return iOpQueue.queue(putApdu(aToken), YubiKeyOpQueue::KeySpecific,
         YubiKeyOpQueue::HighPriority, aData);
 }
 
+YubiKeyOp*
+YubiKey::Private::putTokens(
+    const QList<YubiKeyToken>& aTokens)
+{
+    const int n = aTokens.count();
+    QList<YubiKeyIo::APDU> batch;
+    OtpList otps;
+
+    // All PUTs are sent as a single batch. The metadata are passed to
+    // the completion handler to update the list without re-reading it.
+    batch.reserve(n);
+    otps.reserve(n);
+    for (int i = 0; i < n; i++) {
+        const YubiKeyToken& token = aTokens.at(i);
+        YubiKeyOtp otp(YubiKeyUtil::nameToUtf8(token.label()));
+
+        otp.iType = token.type();
+        otp.iAlg = token.algorithm();
+        batch.append(putApdu(token));
+        otps.append(otp);
+        HDEBUG(token);
+    }
+
+    YubiKeyOp* op = iOpQueue.queueBatch(batch, YubiKeyOpQueue::KeySpecific,
+        YubiKeyOpQueue::HighPriority, new OtpListData(otps));
+
+    if (op) {
+        connect(op,
+            SIGNAL(opFinished(uint,QByteArray)),
+            SLOT(onPutTokensFinished(uint,QByteArray)));
+        connect(op,
+            SIGNAL(opStateChanged()),
+            SLOT(onPutTokensStateChanged()));
+    }
+    return op;
+}
+
 void
 YubiKey::Private::listAndCalculateAll()
 {
@@ -601,6 +795,7 @@ YubiKey::Private::listAndCalculateAll()
 
     if (listOp) {
         iOpQueue.drop(CALCULATE_ALL_APDU);
+        iRefreshOp = listOp;
         passwordUpdateStarted();
         connect(listOp,
             SIGNAL(destroyed(QObject*)),
@@ -632,6 +827,7 @@ YubiKey::Private::calculateAll(
     YubiKeyOp* calculateAllOp = iOpQueue.queue(apdu, YubiKeyOpQueue::Replace,
         new OtpListData(aOtpList));
     if (calculateAllOp) {
+        iRefreshOp = calculateAllOp;
         passwordUpdateStarted();
         connect(calculateAllOp,
             SIGNAL(destroyed(QObject*)),
@@ -795,7 +991,7 @@ YubiKey::Private::reset()
 {
     // Pass the current YubiKeyId to the completion handler so that it can
     // remove the old settings and credentials after a successful reset.
-    static const YubiKeyIo::APDU apdu("RESET", 0x00, 0x04, 0xde, 0xad);
+    static const YubiKeyIo::Header apdu("RESET", 0x00, 0x04, 0xde, 0xad);
     YubiKeyOp* op = iOpQueue.queue(apdu, YubiKeyOpQueue::KeySpecific,
         YubiKeyOpQueue::HighPriority, new BytesData(iOpQueue.yubiKeyId()));
 
@@ -825,6 +1021,7 @@ YubiKey::Private::onResetFinished(
     if (aResult == RC_OK) {
         // Remove old credentials and settings
         const QByteArray oldId(senderOpData<BytesData>()->iBytes);
+        YubiKeyAuth(oldId).forgetPassword();
         YubiKeyUtil::configDir(oldId).removeRecursively();
         if (!iHaveBeenReset) {
             iHaveBeenReset = true;
@@ -835,6 +1032,57 @@ YubiKey::Private::onResetFinished(
     }
 }
 
+void
+YubiKey::Private::onPutTokensFinished(
+    uint aResult,
+    const QByteArray& aData)
+{
+    HDEBUG(hex << aResult);
+    if (iOtpListFetched) {
+        // The response contains status words of the completed PUTs.
+        // Add the successfully written credentials to the list and
+        // fetch the codes, no need to re-read the whole list.
+        const OtpList& otps = senderOpData<OtpListData>()->iOtpList;
+        const int n = qMin(otps.count(), aData.size() / 2);
+        const uchar* sw = (const uchar*)aData.constData();
+        OtpList list(iOtpList);
+
+        for (int i = 0; i < n; i++, sw += 2) {
+            if (((((uint)sw[0]) << 8) | sw[1]) == RC_OK) {
+                const YubiKeyOtp& otp = otps.at(i);
+
+                // PUT replaces the credential with the same name
+                for (OtpMutableListIterator it(list); it.hasNext();) {
+                    if (it.next().iName == otp.iName) {
+                        it.remove();
+                        break;
+                    }
+                }
+                list.append(otp);
+            }
+        }
+        setOtpList(list);
+        calculateAll(list);
+    } else {
+        listAndCalculateAll();
+    }
+    emitQueuedSignals();
+}
+
+void
+YubiKey::Private::onPutTokensStateChanged()
+{
+    YubiKeyOp* op = qobject_cast<YubiKeyOp*>(sender());
+
+    if (op->opState() == YubiKeyOp::OpFailed && op->opIsDone() &&
+        op->opProgress() > 0) {
+        // Some of the credentials may have been written, re-read the list
+        HDEBUG("batch failed after" << op->opProgress() << "command(s)");
+        listAndCalculateAll();
+        emitQueuedSignals();
+    }
+}
+
 void
 YubiKey::Private::onRefreshFinished(
     uint aResult,
@@ -981,7 +1229,7 @@ YubiKey::haveBeenReset() const
 qreal
 YubiKey::totpTimeLeft() const
 {
-    return iPrivate->iTotpTimeLeft;
+    return iPrivate->totpTimeLeft();
 }
 
 void
@@ -1190,7 +1438,7 @@ YubiKey::putToken(
 {
     const YubiKeyTokenType type = YubiKeyUtil::validType(aType);
     const YubiKeyAlgorithm alg = YubiKeyUtil::validAlgorithm(aAlgorithm);
-    const QByteArray secret(HarbourBase32::fromBase32(aSecret));
+    const QByteArray secret(YubiKeyUtil::fromBase32(aSecret));
 
     if (type != YubiKeyTokenType_Unknown &&
         alg != YubiKeyAlgorithm_Unknown &&
@@ -1212,17 +1460,11 @@ YubiKey::putTokens(
     QList<YubiKeyToken> aTokens)
 {
     QList<int> ids;
-    const int n = aTokens.count();
 
-    if (n > 0) {
-        ids.reserve(n);
-        for (int i = 0; i < n; i++) {
-            ids.append(iPrivate->putToken(aTokens.at(i))->opId());
-            HDEBUG(aTokens.at(i) << "=>" << ids.last());
-        }
-
-        // Re-read the tokens after adding new ones
-        iPrivate->listAndCalculateAll();
+    if (!aTokens.isEmpty()) {
+        // The whole thing is a single batch op
+        ids.append(iPrivate->putTokens(aTokens)->opId());
+        HDEBUG(aTokens.count() << "token(s) =>" << ids.last());
     }
     return ids;
 }
@@ -48,14 +48,292 @@
 #include "HarbourDebug.h"
 #include "HarbourUtil.h"
 
+#include <QtCore/QCoreApplication>
 #include <QtCore/QDir>
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
 #include <QtCore/QMap>
 #include <QtCore/QMapIterator>
+#include <QtCore/QRunnable>
+#include <QtCore/QSaveFile>
 #include <QtCore/QSettings>
+#include <QtCore/QThreadPool>
+#include <QtCore/QTimer>
 
-#include <utime.h>
+// ==========================================================================
+// YubiKeyAuth::DeriveTask
+//
+// Runs PBKDF2 on a worker thread. The result is picked up by the main
+// thread when derivationFinished() arrives.
+// ==========================================================================
+
+class YubiKeyAuth::DeriveTask :
+    public QObject,
+    public QRunnable
+{
+    Q_OBJECT
+
+public:
+    DeriveTask(const QByteArray&, YubiKeyAlgorithm, const QString&, bool);
+    ~DeriveTask();
+
+    void run() Q_DECL_OVERRIDE;
+
+Q_SIGNALS:
+    void derivationFinished();
+
+public:
+    const QByteArray iYubiKeyId;
+    const YubiKeyAlgorithm iAlgorithm;
+    const QString iPassword;
+    const bool iSave;
+    QByteArray iAccessKey;
+};
+
+YubiKeyAuth::DeriveTask::DeriveTask(
+    const QByteArray& aYubiKeyId,
+    YubiKeyAlgorithm aAlgorithm,
+    const QString& aPassword,
+    bool aSave) :
+    iYubiKeyId(aYubiKeyId),
+    iAlgorithm(aAlgorithm),
+    iPassword(aPassword),
+    iSave(aSave)
+{
+    // Deletes itself with deleteLater() when done
+    setAutoDelete(false);
+}
+
+YubiKeyAuth::DeriveTask::~DeriveTask()
+{
+    // Cancelled tasks still hold the key they have derived
+    YubiKeyUtil::wipe(&iAccessKey);
+}
+
+void
+YubiKeyAuth::DeriveTask::run()
+{
+    iAccessKey = calculateAccessKey(iYubiKeyId, iAlgorithm, iPassword);
+    Q_EMIT derivationFinished();
+    deleteLater();
+}
+
+// ==========================================================================
+// YubiKeyAuth::Index
+//
+// Keeps track of the keys which have their access keys saved, along with
+// the last access times. It's a single small file, which allows to list
+// the known keys without opening (or even looking for) the per-key files.
+// Each line contains the hex ID and the last access time in milliseconds
+// since the epoch. Access times are written lazily, at most once per
+// SAVE_DELAY and when the app exits, so that authentication doesn't
+// write to the flash every time.
+// ==========================================================================
+
+class YubiKeyAuth::Index :
+    public QObject
+{
+    Q_OBJECT
+    Index();
+
+public:
+    static const QString AUTH_FILE;
+
+    static Index* instance();
+    ~Index();
+
+    QList<QByteArray> ids();
+    QDateTime lastAccessTime(const QByteArray&);
+    void update(const QByteArray&);
+    void touch(const QByteArray&);
+    void remove(const QByteArray&);
+
+private Q_SLOTS:
+    void flush();
+
+private:
+    void load();
+    void rebuild();
+    void save();
+
+private:
+    static const QString INDEX_FILE;
+    static const int SAVE_DELAY = 60000; // ms
+    const QString iPath;
+    QTimer* iSaveTimer;
+    bool iLoaded;
+    bool iDirty;
+    QMap<QByteArray,qint64> iEntries;
+};
+
+const QString YubiKeyAuth::Index::AUTH_FILE("auth");
+const QString YubiKeyAuth::Index::INDEX_FILE("auth-index");
+
+YubiKeyAuth::Index::Index() :
+    iPath(YubiKeyUtil::configRootDir().filePath(INDEX_FILE)),
+    iSaveTimer(new QTimer(this)),
+    iLoaded(false),
+    iDirty(false)
+{
+    iSaveTimer->setSingleShot(true);
+    iSaveTimer->setInterval(SAVE_DELAY);
+    connect(iSaveTimer, SIGNAL(timeout()), SLOT(flush()));
+    if (qApp) {
+        connect(qApp, SIGNAL(aboutToQuit()), SLOT(flush()));
+    }
+}
+
+YubiKeyAuth::Index::~Index()
+{
+    flush();
+}
+
+/* static */
+YubiKeyAuth::Index*
+YubiKeyAuth::Index::instance()
+{
+    // Only used on the main thread
+    static Index index;
+
+    return &index;
+}
+
+void
+YubiKeyAuth::Index::load()
+{
+    if (!iLoaded) {
+        QFile file(iPath);
+
+        iLoaded = true;
+        if (file.open(QIODevice::ReadOnly)) {
+            HDEBUG("Loading" << qPrintable(iPath));
+            while (!file.atEnd()) {
+                const QList<QByteArray> parts(file.readLine().
+                    trimmed().split(' '));
+
+                if (parts.count() == 2) {
+                    const QByteArray id(QByteArray::fromHex(parts.at(0)));
+                    bool ok;
+                    const qint64 ms = parts.at(1).toLongLong(&ok);
+
+                    if (!id.isEmpty() && ok) {
+                        iEntries.insert(id, ms);
+                    }
+                }
+            }
+        } else {
+            // First run after upgrade, pick up the existing files
+            rebuild();
+        }
+    }
+}
+
+void
+YubiKeyAuth::Index::rebuild()
+{
+    const QList<QDir> dirs(YubiKeyUtil::configDirs());
+
+    HDEBUG("Rebuilding" << qPrintable(iPath));
+    iEntries.clear();
+    for (int i = 0; i < dirs.count(); i++) {
+        const QDir& dir = dirs.at(i);
+        const QByteArray id(QByteArray::fromHex(dir.dirName().toLatin1()));
+        const QFileInfo authFile(dir.filePath(AUTH_FILE));
+
+        if (!id.isEmpty() && authFile.isFile() && authFile.isReadable()) {
+            iEntries.insert(id, authFile.lastModified().toMSecsSinceEpoch());
+        }
+    }
+    // Even if it's empty, so that the directories aren't scanned again
+    save();
+}
+
+void
+YubiKeyAuth::Index::flush()
+{
+    // Writes the pending access times
+    if (iDirty) {
+        save();
+    }
+}
+
+void
+YubiKeyAuth::Index::save()
+{
+    const QDir root(YubiKeyUtil::configRootDir());
+
+    if (root.exists() || root.mkpath(".")) {
+        QSaveFile file(iPath);
+
+        iDirty = false;
+        iSaveTimer->stop();
+        if (file.open(QIODevice::WriteOnly)) {
+            QMapIterator<QByteArray,qint64> it(iEntries);
+
+            while (it.hasNext()) {
+                it.next();
+                file.write(it.key().toHex() + ' ' +
+                    QByteArray::number(it.value()) + '\n');
+            }
+            if (!file.commit()) {
+                HWARN("Failed to write" << qPrintable(iPath));
+            }
+        } else {
+            HWARN("Failed to open" << qPrintable(iPath));
+        }
+    }
+}
+
+QList<QByteArray>
+YubiKeyAuth::Index::ids()
+{
+    load();
+    return iEntries.keys();
+}
+
+QDateTime
+YubiKeyAuth::Index::lastAccessTime(
+    const QByteArray& aYubiKeyId)
+{
+    load();
+    return iEntries.contains(aYubiKeyId) ?
+        QDateTime::fromMSecsSinceEpoch(iEntries.value(aYubiKeyId)) :
+        QDateTime();
+}
+
+void
+YubiKeyAuth::Index::update(
+    const QByteArray& aYubiKeyId)
+{
+    load();
+    iEntries.insert(aYubiKeyId, QDateTime::currentMSecsSinceEpoch());
+    save();
+}
+
+void
+YubiKeyAuth::Index::touch(
+    const QByteArray& aYubiKeyId)
+{
+    load();
+    if (iEntries.contains(aYubiKeyId)) {
+        // Written later, together with the other changes if there are any
+        iEntries.insert(aYubiKeyId, QDateTime::currentMSecsSinceEpoch());
+        iDirty = true;
+        if (!iSaveTimer->isActive()) {
+            iSaveTimer->start();
+        }
+    }
+}
+
+void
+YubiKeyAuth::Index::remove(
+    const QByteArray& aYubiKeyId)
+{
+    load();
+    if (iEntries.remove(aYubiKeyId)) {
+        save();
+    }
+}
 
 // ==========================================================================
 // YubiKeyAuth::Private
@@ -69,22 +347,33 @@ class YubiKeyAuth::Private :
 
 public:
     typedef QMap<YubiKeyAlgorithm, QByteArray> AuthKeyMap;
-    typedef QMapIterator<YubiKeyAlgorithm, QByteArray> AuthKeyMapIterator;
 
     Private(const QByteArray&);
     ~Private();
 
     void connect(YubiKeyAuth*);
+    void load();
     bool setAccessKey(YubiKeyAlgorithm, const QByteArray&, bool);
+    void derivePassword(YubiKeyAlgorithm, const QString&, bool);
+    bool isDerivingPassword(YubiKeyAlgorithm) const;
+    void setAuthAlgorithm(YubiKeyAlgorithm);
+    QList<YubiKeyAlgorithm> cancelDerivation();
+    QByteArray calculateResponse(const QByteArray&, YubiKeyAlgorithm);
+    void dropHmac(YubiKeyAlgorithm);
+    void dropHmacs();
     void clear();
 
     static GType digestType(YubiKeyAlgorithm);
+    static QByteArray copy(const QByteArray&);
 
 Q_SIGNALS:
     void accessKeyChanged(YubiKeyAlgorithm);
+    void passwordDerived(YubiKeyAlgorithm);
+
+public Q_SLOTS:
+    void onDerivationFinished();
 
 public:
-    static const QString AUTH_FILE;
     static QMap<QByteArray, Private*> gAuthMap;
 
 public:
@@ -93,10 +382,16 @@ public:
     QDir iConfigDir;
     const QString iAuthFile;
     QSettings* iSettings;
+    bool iLoaded;
     AuthKeyMap iAccessKeys;
+    QThreadPool* iDerivePool;
+    QList<DeriveTask*> iDeriveTasks;
+    YubiKeyAlgorithm iDeriveAlgorithm;
+    AuthKeyMap iDerivedKeys;  // In memory only, until the algorithm is known
+    bool iDerivedSave;
+    QMap<YubiKeyAlgorithm, FoilHmac*> iHmacs;  // Keyed with iAccessKeys
 };
 
-const QString YubiKeyAuth::Private::AUTH_FILE("auth");
 QMap<QByteArray, YubiKeyAuth::Private*> YubiKeyAuth::Private::gAuthMap;
 
 YubiKeyAuth::Private::Private(
@@ -104,33 +399,28 @@ YubiKeyAuth::Private::Private(
     iRef(1),
     iYubiKeyId(aYubiKeyId),
     iConfigDir(YubiKeyUtil::configDir(aYubiKeyId)),
-    iAuthFile(iConfigDir.filePath(AUTH_FILE)),
-    iSettings(Q_NULLPTR)
-{
-    const QFileInfo authFile(iAuthFile);
-
-    // Load settings from the file
-    if (authFile.isFile() && authFile.isReadable()) {
-        HDEBUG("Loading" << qPrintable(iAuthFile));
-        iSettings = new QSettings(iAuthFile, QSettings::IniFormat, this);
-        for (int i = 0; i < YubiKeyUtil::AllAlgorithms.count(); i++) {
-            const YubiKeyAlgorithm alg = YubiKeyUtil::AllAlgorithms.at(i);
-            const QByteArray key(YubiKeyUtil::fromHex(iSettings->
-                value(YubiKeyUtil::algorithmName(alg)).toString()));
-
-            if (!key.isEmpty()) {
-                iAccessKeys.insert(alg, key);
-            }
-        }
-    } else {
-        HDEBUG(qPrintable(iAuthFile) << "doesn't exist");
-    }
-
+    iAuthFile(iConfigDir.filePath(Index::AUTH_FILE)),
+    iSettings(Q_NULLPTR),
+    iLoaded(false),
+    iDerivePool(Q_NULLPTR),
+    iDeriveAlgorithm(YubiKeyAlgorithm_Unknown),
+    iDerivedSave(false)
+{
+    // The auth file is loaded on demand
     gAuthMap.insert(iYubiKeyId, this);
 }
 
 YubiKeyAuth::Private::~Private()
 {
+    cancelDerivation();
+    if (iDerivePool) {
+        iDerivePool->waitForDone();
+    }
+    dropHmacs();
+    for (AuthKeyMap::iterator it = iAccessKeys.begin();
+         it != iAccessKeys.end(); ++it) {
+        YubiKeyUtil::wipe(&it.value());
+    }
     gAuthMap.remove(iYubiKeyId);
 }
 
@@ -140,6 +430,35 @@ YubiKeyAuth::Private::connect(
 {
     aAuth->connect(this, SIGNAL(accessKeyChanged(YubiKeyAlgorithm)),
         SIGNAL(accessKeyChanged(YubiKeyAlgorithm)));
+    aAuth->connect(this, SIGNAL(passwordDerived(YubiKeyAlgorithm)),
+        SIGNAL(passwordDerived(YubiKeyAlgorithm)));
+}
+
+void
+YubiKeyAuth::Private::load()
+{
+    if (!iLoaded) {
+        const QFileInfo authFile(iAuthFile);
+
+        // Load settings from the file
+        iLoaded = true;
+        if (authFile.isFile() && authFile.isReadable()) {
+            HDEBUG("Loading" << qPrintable(iAuthFile));
+            iSettings = new QSettings(iAuthFile, QSettings::IniFormat, this);
+            for (int i = 0; i < YubiKeyUtil::AllAlgorithms.count(); i++) {
+                const YubiKeyAlgorithm alg = YubiKeyUtil::AllAlgorithms.at(i);
+                const QByteArray key(YubiKeyUtil::fromHex(iSettings->
+                    value(YubiKeyUtil::algorithmName(alg)).toString()));
+
+                if (!key.isEmpty()) {
+                    iAccessKeys.insert(alg, key);
+                }
+            }
+        } else {
+            HDEBUG(qPrintable(iAuthFile) << "doesn't exist");
+            Index::instance()->remove(iYubiKeyId);
+        }
+    }
 }
 
 bool
@@ -148,12 +467,17 @@ YubiKeyAuth::Private::setAccessKey(
     const QByteArray& aAccessKey,
     bool aSave)
 {
+    load();
     if (aAlgorithm >= YubiKeyAlgorithm_Min &&
         aAlgorithm <= YubiKeyAlgorithm_Max &&
         iAccessKeys.value(aAlgorithm) != aAccessKey) {
         const QString algName(YubiKeyUtil::algorithmName(aAlgorithm));
 
-        iAccessKeys.insert(aAlgorithm, aAccessKey);
+        QByteArray oldKey(iAccessKeys.take(aAlgorithm));
+
+        YubiKeyUtil::wipe(&oldKey);
+        dropHmac(aAlgorithm);
+        iAccessKeys.insert(aAlgorithm, copy(aAccessKey));
         HDEBUG(qPrintable(HarbourUtil::toHex(iYubiKeyId)) << algName <<
             "=>" << qPrintable(HarbourUtil::toHex(aAccessKey)));
 
@@ -169,11 +493,13 @@ YubiKeyAuth::Private::setAccessKey(
             }
             if (iSettings) {
                 iSettings->setValue(algName, HarbourUtil::toHex(aAccessKey));
+                Index::instance()->update(iYubiKeyId);
             }
         } else {
             // Remove the settings file without clearing the runtime keys
             delete iSettings;
             iSettings = Q_NULLPTR;
+            Index::instance()->remove(iYubiKeyId);
 
             if (QFile::remove(iAuthFile)) {
                 HDEBUG("Removed" << qPrintable(iAuthFile));
@@ -190,13 +516,196 @@ YubiKeyAuth::Private::setAccessKey(
     return false;
 }
 
+void
+YubiKeyAuth::Private::derivePassword(
+    YubiKeyAlgorithm aAlgorithm,
+    const QString& aPassword,
+    bool aSave)
+{
+    // The previous password is no longer interesting
+    cancelDerivation();
+    if (!iDerivePool) {
+        // Enough threads to derive the keys for all algorithms in parallel
+        iDerivePool = new QThreadPool(this);
+        iDerivePool->setMaxThreadCount(YubiKeyUtil::AllAlgorithms.count());
+    }
+
+    // If the algorithm is unknown, derive the keys for all of them.
+    // Those are kept in memory until setAuthAlgorithm() tells which
+    // one is actually needed, only that one gets saved.
+    iDeriveAlgorithm = aAlgorithm;
+    iDerivedSave = aSave;
+    const QList<YubiKeyAlgorithm> algs(aAlgorithm == YubiKeyAlgorithm_Unknown ?
+        YubiKeyUtil::AllAlgorithms : QList<YubiKeyAlgorithm>() << aAlgorithm);
+
+    for (int i = 0; i < algs.count(); i++) {
+        DeriveTask* task = new DeriveTask(iYubiKeyId, algs.at(i),
+            aPassword, aSave);
+
+        HDEBUG("Deriving" << algs.at(i) << "access key");
+        iDeriveTasks.append(task);
+        QObject::connect(task, SIGNAL(derivationFinished()),
+            this, SLOT(onDerivationFinished()), Qt::QueuedConnection);
+        iDerivePool->start(task);
+    }
+}
+
+bool
+YubiKeyAuth::Private::isDerivingPassword(
+    YubiKeyAlgorithm aAlgorithm) const
+{
+    for (int i = 0; i < iDeriveTasks.count(); i++) {
+        if (iDeriveTasks.at(i)->iAlgorithm == aAlgorithm) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+YubiKeyAuth::Private::setAuthAlgorithm(
+    YubiKeyAlgorithm aAlgorithm)
+{
+    if (iDeriveAlgorithm == YubiKeyAlgorithm_Unknown &&
+        aAlgorithm != YubiKeyAlgorithm_Unknown &&
+        (!iDeriveTasks.isEmpty() || !iDerivedKeys.isEmpty())) {
+        HDEBUG("Keeping" << aAlgorithm << "access key");
+        iDeriveAlgorithm = aAlgorithm;
+
+        // The keys for other algorithms are no longer needed
+        for (int i = iDeriveTasks.count() - 1; i >= 0; i--) {
+            DeriveTask* task = iDeriveTasks.at(i);
+
+            if (task->iAlgorithm != aAlgorithm) {
+                task->disconnect(this);
+                iDeriveTasks.removeAt(i);
+            }
+        }
+
+        QByteArray key(iDerivedKeys.take(aAlgorithm));
+
+        for (AuthKeyMap::iterator it = iDerivedKeys.begin();
+             it != iDerivedKeys.end(); ++it) {
+            YubiKeyUtil::wipe(&it.value());
+        }
+        iDerivedKeys.clear();
+        if (!key.isEmpty()) {
+            setAccessKey(aAlgorithm, key, iDerivedSave);
+            YubiKeyUtil::wipe(&key);
+        }
+    }
+}
+
+QList<YubiKeyAlgorithm>
+YubiKeyAuth::Private::cancelDerivation()
+{
+    QList<YubiKeyAlgorithm> algs;
+
+    // The tasks can't be interrupted, they delete themselves when done
+    for (int i = 0; i < iDeriveTasks.count(); i++) {
+        DeriveTask* task = iDeriveTasks.at(i);
+
+        task->disconnect(this);
+        algs.append(task->iAlgorithm);
+    }
+    iDeriveTasks.clear();
+    for (AuthKeyMap::iterator it = iDerivedKeys.begin();
+         it != iDerivedKeys.end(); ++it) {
+        YubiKeyUtil::wipe(&it.value());
+    }
+    iDerivedKeys.clear();
+    iDeriveAlgorithm = YubiKeyAlgorithm_Unknown;
+    return algs;
+}
+
+void
+YubiKeyAuth::Private::onDerivationFinished()
+{
+    DeriveTask* task = qobject_cast<DeriveTask*>(sender());
+
+    if (iDeriveTasks.removeOne(task)) {
+        HDEBUG(task->iAlgorithm << "access key derived");
+        if (iDeriveAlgorithm == YubiKeyAlgorithm_Unknown) {
+            // Don't know yet whether this one is needed
+            iDerivedKeys.insert(task->iAlgorithm, copy(task->iAccessKey));
+        } else {
+            setAccessKey(task->iAlgorithm, task->iAccessKey, task->iSave);
+        }
+        YubiKeyUtil::wipe(&task->iAccessKey);
+        Q_EMIT passwordDerived(task->iAlgorithm);
+    }
+}
+
+QByteArray
+YubiKeyAuth::Private::calculateResponse(
+    const QByteArray& aChallenge,
+    YubiKeyAlgorithm aAlgorithm)
+{
+    load();
+
+    FoilHmac* keyed = iHmacs.value(aAlgorithm);
+
+    if (!keyed) {
+        const QByteArray key(iAccessKeys.value(aAlgorithm));
+
+        if (key.isEmpty()) {
+            return QByteArray();
+        }
+
+        // The padded key gets absorbed once, each response then only
+        // costs hashing the challenge. The keyed state is owned by
+        // libfoil and released by dropHmac() when the key goes away.
+        keyed = foil_hmac_new(digestType(aAlgorithm), key.constData(),
+            key.size());
+        if (!keyed) {
+            return QByteArray();
+        }
+        iHmacs.insert(aAlgorithm, keyed);
+    }
+
+    FoilHmac* hmac = foil_hmac_clone(keyed);
+
+    foil_hmac_update(hmac, aChallenge.constData(), aChallenge.size());
+    return YubiKeyUtil::toByteArray(foil_hmac_free_to_bytes(hmac));
+}
+
+void
+YubiKeyAuth::Private::dropHmac(
+    YubiKeyAlgorithm aAlgorithm)
+{
+    FoilHmac* hmac = iHmacs.take(aAlgorithm);
+
+    if (hmac) {
+        foil_hmac_unref(hmac);
+    }
+}
+
+void
+YubiKeyAuth::Private::dropHmacs()
+{
+    QMapIterator<YubiKeyAlgorithm, FoilHmac*> it(iHmacs);
+
+    while (it.hasNext()) {
+        foil_hmac_unref(it.next().value());
+    }
+    iHmacs.clear();
+}
+
 void
 YubiKeyAuth::Private::clear()
 {
-    const AuthKeyMap oldMap(iAccessKeys);
-    AuthKeyMapIterator it(oldMap);
+    load();
+
+    const QList<YubiKeyAlgorithm> cancelled(cancelDerivation());
+    const QList<YubiKeyAlgorithm> algorithms(iAccessKeys.keys());
 
+    dropHmacs();
+    for (AuthKeyMap::iterator it = iAccessKeys.begin();
+         it != iAccessKeys.end(); ++it) {
+        YubiKeyUtil::wipe(&it.value());
+    }
     iAccessKeys.clear();
+    Index::instance()->remove(iYubiKeyId);
     if (iSettings) {
         delete iSettings;
         iSettings = Q_NULLPTR;
@@ -208,8 +717,13 @@ YubiKeyAuth::Private::clear()
         }
     }
 
-    while (it.hasNext()) {
-        Q_EMIT accessKeyChanged(it.next().key());
+    for (int i = 0; i < algorithms.count(); i++) {
+        Q_EMIT accessKeyChanged(algorithms.at(i));
+    }
+
+    // Let those waiting for the derivation know that it's over
+    for (int i = 0; i < cancelled.count(); i++) {
+        Q_EMIT passwordDerived(cancelled.at(i));
     }
 }
 
@@ -227,6 +741,18 @@ YubiKeyAuth::Private::digestType(
     return (GType)0;
 }
 
+/* static */
+QByteArray
+YubiKeyAuth::Private::copy(
+    const QByteArray& aKey)
+{
+    // Deep copy. The keys we keep never share their buffers with
+    // anyone else, so that YubiKeyUtil::wipe() zeroes the only copy
+    // of the bytes.
+    return aKey.isEmpty() ? QByteArray() :
+        QByteArray(aKey.constData(), aKey.size());
+}
+
 // ==========================================================================
 // YubiKeyAuth
 // ==========================================================================
@@ -332,7 +858,12 @@ QByteArray
 YubiKeyAuth::getAccessKey(
     YubiKeyAlgorithm aAlgorithm) const
 {
-    return iPrivate ? iPrivate->iAccessKeys.value(aAlgorithm) : QByteArray();
+    if (iPrivate) {
+        iPrivate->load();
+        // A copy, our own buffer gets wiped
+        return Private::copy(iPrivate->iAccessKeys.value(aAlgorithm));
+    }
+    return QByteArray();
 }
 
 bool
@@ -349,14 +880,15 @@ YubiKeyAuth::calculateResponse(
     QByteArray aChallenge,
     YubiKeyAlgorithm aAlgorithm) const
 {
-    return calculateResponse(getAccessKey(aAlgorithm), aChallenge, aAlgorithm);
+    return iPrivate ? iPrivate->calculateResponse(aChallenge, aAlgorithm) :
+        QByteArray();
 }
 
 QDateTime
 YubiKeyAuth::lastAccessTime() const
 {
     return iPrivate ?
-        QFileInfo(iPrivate->iAuthFile).lastModified() :
+        Index::instance()->lastAccessTime(iPrivate->iYubiKeyId) :
         QDateTime();
 }
 
@@ -371,6 +903,36 @@ YubiKeyAuth::setPassword(
         aSave);
 }
 
+void
+YubiKeyAuth::derivePassword(
+    YubiKeyAlgorithm aAlgorithm,
+    QString aPassword,
+    bool aSave)
+{
+    // Asynchronous version of setPassword, emits passwordDerived when done
+    if (iPrivate) {
+        iPrivate->derivePassword(aAlgorithm, aPassword, aSave);
+    }
+}
+
+bool
+YubiKeyAuth::isDerivingPassword(
+    YubiKeyAlgorithm aAlgorithm) const
+{
+    return iPrivate && iPrivate->isDerivingPassword(aAlgorithm);
+}
+
+void
+YubiKeyAuth::setAuthAlgorithm(
+    YubiKeyAlgorithm aAlgorithm)
+{
+    // Called when SELECT reports the algorithm. If the keys have been
+    // derived for all algorithms, only this one is kept (and saved).
+    if (iPrivate) {
+        iPrivate->setAuthAlgorithm(aAlgorithm);
+    }
+}
+
 void
 YubiKeyAuth::forgetPassword()
 {
@@ -383,11 +945,7 @@ void
 YubiKeyAuth::touch()
 {
     if (iPrivate) {
-        const QByteArray fname(iPrivate->iAuthFile.toLocal8Bit());
-
-        if (utime(fname.constData(), NULL)) {
-            HDEBUG("Failed to modify" << fname.constData() << "mod time");
-        }
+        Index::instance()->touch(iPrivate->iYubiKeyId);
     }
 }
 
@@ -439,18 +997,14 @@ YubiKeyAuth::calculateResponse(
 QList<YubiKeyAuth>
 YubiKeyAuth::all()
 {
-    const QList<QDir> dirs(YubiKeyUtil::configDirs());
-    const int n = dirs.count();
+    // Auth files are only opened when the keys are actually needed
+    const QList<QByteArray> ids(Index::instance()->ids());
+    const int n = ids.count();
     QList<YubiKeyAuth> authList;
 
+    authList.reserve(n);
     for (int i = 0; i < n; i++) {
-        const QDir& dir = dirs.at(i);
-        const QByteArray id(QByteArray::fromHex(dir.dirName().toLatin1()));
-        const QFileInfo authFile(dir.filePath(Private::AUTH_FILE));
-
-        if (!id.isEmpty() && authFile.isFile() && authFile.isReadable()) {
-            authList.append(YubiKeyAuth(id));
-        }
+        authList.append(YubiKeyAuth(ids.at(i)));
     }
     return authList;
 }
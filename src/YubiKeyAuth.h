@@ -70,6 +70,9 @@ public:
     QDateTime lastAccessTime() const;
     bool setAccessKey(YubiKeyAlgorithm, QByteArray, bool);
     bool setPassword(YubiKeyAlgorithm, QString, bool);
+    void derivePassword(YubiKeyAlgorithm, QString, bool);
+    bool isDerivingPassword(YubiKeyAlgorithm) const;
+    void setAuthAlgorithm(YubiKeyAlgorithm);
     void forgetPassword();
     void touch();
 
@@ -79,8 +82,11 @@ public:
 
 Q_SIGNALS:
     void accessKeyChanged(YubiKeyAlgorithm);
+    void passwordDerived(YubiKeyAlgorithm);
 
 private:
+    class DeriveTask;
+    class Index;
     class Private;
     Private* iPrivate;
 };
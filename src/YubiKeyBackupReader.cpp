@@ -0,0 +1,553 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "YubiKeyBackupReader.h"
+
+#include "HarbourDebug.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QIODevice>
+#include <QtCore/QList>
+#include <QtCore/QUrl>
+
+// ==========================================================================
+// YubiKeyBackupReader::Private
+// ==========================================================================
+
+class YubiKeyBackupReader::Private
+{
+public:
+    static const int ChunkSize = 0x10000;
+    static const int MaxValueSize = 0x100000;   // Longer ones are dropped
+    static const int MaxDepth = 64;
+
+    enum Format {
+        FormatUnknown,
+        FormatText,
+        FormatJson
+    };
+
+    typedef QHash<QByteArray,QByteArray> Fields;
+
+    // JSON object or array
+    struct Container {
+        bool iObject;
+        bool iExpectKey;
+        bool iHasUri;
+        QByteArray iKey;
+        Fields iFields;
+    };
+
+    Private(QIODevice*);
+
+    bool fill();
+    int peek();
+    int get();
+    void skipSpace();
+    bool readText();
+    bool readJson();
+    bool readString(QByteArray*);
+    bool readHex4(uint*);
+    void readLiteral(QByteArray*);
+    void value(const QByteArray&);
+    void endObject(const Container&);
+    static bool isOtpAuthUri(const QByteArray&);
+    static QByteArray field(const Fields&, const char*,
+        const char* = Q_NULLPTR, const char* = Q_NULLPTR);
+    static QByteArray buildUri(const Fields&);
+
+public:
+    QIODevice* iDevice;
+    QByteArray iBuf;
+    int iPos;
+    qint64 iConsumed;
+    qint64 iTotal;
+    Format iFormat;
+    bool iError;
+    QList<Container> iStack;
+    QList<QByteArray> iUris;
+};
+
+YubiKeyBackupReader::Private::Private(
+    QIODevice* aDevice) :
+    iDevice(aDevice),
+    iPos(0),
+    iConsumed(0),
+    iTotal(aDevice->isSequential() ? 0 : aDevice->size()),
+    iFormat(FormatUnknown),
+    iError(false)
+{
+}
+
+// Makes sure that there's something in the buffer
+bool
+YubiKeyBackupReader::Private::fill()
+{
+    if (iPos < iBuf.size()) {
+        return true;
+    } else {
+        iConsumed += iBuf.size();
+        iBuf = iDevice->read(ChunkSize);
+        iPos = 0;
+        return !iBuf.isEmpty();
+    }
+}
+
+inline
+int
+YubiKeyBackupReader::Private::peek()
+{
+    return fill() ? (uchar) iBuf.at(iPos) : -1;
+}
+
+inline
+int
+YubiKeyBackupReader::Private::get()
+{
+    const int c = peek();
+
+    if (c >= 0) {
+        iPos++;
+    }
+    return c;
+}
+
+void
+YubiKeyBackupReader::Private::skipSpace()
+{
+    int c;
+
+    while ((c = peek()) == ' ' || c == '\t' || c == '\r' || c == '\n') {
+        iPos++;
+    }
+}
+
+/* static */
+bool
+YubiKeyBackupReader::Private::isOtpAuthUri(
+    const QByteArray& aValue)
+{
+    // Covers otpauth-migration too
+    return aValue.size() > 10 && !qstrnicmp(aValue.constData(), "otpauth", 7);
+}
+
+// Reads one line. Returns false at the end of input.
+bool
+YubiKeyBackupReader::Private::readText()
+{
+    QByteArray line;
+    bool tooLong = false;
+
+    if (peek() < 0) {
+        return false;
+    }
+
+    while (fill()) {
+        const int eol = iBuf.indexOf('\n', iPos);
+        const int end = (eol >= 0) ? eol : iBuf.size();
+
+        if (line.size() + (end - iPos) <= MaxValueSize) {
+            line.append(iBuf.constData() + iPos, end - iPos);
+        } else {
+            tooLong = true;
+        }
+        iPos = end;
+        if (eol >= 0) {
+            iPos++;
+            break;
+        }
+    }
+
+    line = line.trimmed();
+    if (!tooLong && isOtpAuthUri(line)) {
+        iUris.append(line);
+    }
+    return true;
+}
+
+// Handles one JSON token. Returns false at the end of input or on error.
+bool
+YubiKeyBackupReader::Private::readJson()
+{
+    skipSpace();
+
+    const int c = get();
+    QByteArray s;
+
+    switch (c) {
+    case -1:
+        return false;
+    case '{':
+    case '[':
+        if (iStack.count() < MaxDepth) {
+            Container container;
+
+            container.iObject = (c == '{');
+            container.iExpectKey = container.iObject;
+            container.iHasUri = false;
+            iStack.append(container);
+        } else {
+            HWARN("JSON is nested too deep");
+            iError = true;
+            return false;
+        }
+        break;
+    case '}':
+    case ']':
+        if (!iStack.isEmpty() && iStack.last().iObject == (c == '}')) {
+            const Container container(iStack.takeLast());
+
+            if (container.iObject) {
+                endObject(container);
+            }
+        } else {
+            HWARN("Malformed JSON");
+            iError = true;
+            return false;
+        }
+        break;
+    case ',':
+        if (!iStack.isEmpty() && iStack.last().iObject) {
+            iStack.last().iExpectKey = true;
+        }
+        break;
+    case ':':
+        if (!iStack.isEmpty()) {
+            iStack.last().iExpectKey = false;
+        }
+        break;
+    case '"':
+        if (!readString(&s)) {
+            HWARN("Unterminated JSON string");
+            iError = true;
+            return false;
+        }
+        if (!iStack.isEmpty() && iStack.last().iObject &&
+            iStack.last().iExpectKey) {
+            iStack.last().iKey = s.toLower();
+        } else {
+            value(s);
+        }
+        break;
+    default:
+        // Number, true, false or null
+        s.append((char)c);
+        readLiteral(&s);
+        value(s);
+        break;
+    }
+    return true;
+}
+
+bool
+YubiKeyBackupReader::Private::readString(
+    QByteArray* aString)
+{
+    bool tooLong = false;
+
+    while (fill()) {
+        // Copy the run of plain characters in one go
+        const char* data = iBuf.constData();
+        const int n = iBuf.size();
+        int i = iPos;
+
+        while (i < n && data[i] != '"' && data[i] != '\\') {
+            i++;
+        }
+        if (aString->size() + (i - iPos) <= MaxValueSize) {
+            aString->append(data + iPos, i - iPos);
+        } else {
+            tooLong = true;
+        }
+        iPos = i;
+
+        if (i < n) {
+            iPos++;
+            if (data[i] == '"') {
+                if (tooLong) {
+                    aString->clear();
+                }
+                return true;
+            }
+
+            // Escape sequence
+            const int e = get();
+            uint u;
+
+            switch (e) {
+            case -1: return false;
+            case 'b': aString->append('\b'); break;
+            case 'f': aString->append('\f'); break;
+            case 'n': aString->append('\n'); break;
+            case 'r': aString->append('\r'); break;
+            case 't': aString->append('\t'); break;
+            case 'u':
+                if (!readHex4(&u)) {
+                    return false;
+                }
+                if (u >= 0xd800 && u < 0xdc00 && peek() == '\\') {
+                    // Surrogate pair
+                    uint low;
+
+                    get();
+                    if (get() == 'u' && readHex4(&low) &&
+                        low >= 0xdc00 && low < 0xe000) {
+                        u = 0x10000 + ((u - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                }
+                aString->append(QString::fromUcs4(&u, 1).toUtf8());
+                break;
+            default:
+                // Quote, backslash or slash
+                aString->append((char)e);
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+bool
+YubiKeyBackupReader::Private::readHex4(
+    uint* aValue)
+{
+    uint value = 0;
+
+    for (int i = 0; i < 4; i++) {
+        const int c = get();
+
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value += c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value += c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value += c - 'A' + 10;
+        } else {
+            return false;
+        }
+    }
+    *aValue = value;
+    return true;
+}
+
+void
+YubiKeyBackupReader::Private::readLiteral(
+    QByteArray* aLiteral)
+{
+    int c;
+
+    while ((c = peek()) >= 0 && c != ',' && c != ':' && c != ']' &&
+        c != '}' && c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+        if (aLiteral->size() < MaxValueSize) {
+            aLiteral->append((char)c);
+        }
+        iPos++;
+    }
+}
+
+void
+YubiKeyBackupReader::Private::value(
+    const QByteArray& aValue)
+{
+    Container* top = iStack.isEmpty() ? Q_NULLPTR : &iStack.last();
+
+    if (isOtpAuthUri(aValue)) {
+        iUris.append(aValue);
+        if (top) {
+            // Don't build another URI from the same object
+            top->iHasUri = true;
+        }
+    } else if (top && top->iObject && !top->iKey.isEmpty()) {
+        top->iFields.insert(top->iKey, aValue);
+    }
+}
+
+void
+YubiKeyBackupReader::Private::endObject(
+    const Container& aObject)
+{
+    const Fields& fields = aObject.iFields;
+
+    if (aObject.iHasUri) {
+        // Already done
+    } else if (fields.contains("secret") &&
+        !field(fields, "label", "account", "name").isEmpty()) {
+        const QByteArray uri(buildUri(fields));
+
+        if (!uri.isEmpty()) {
+            iUris.append(uri);
+        }
+    } else if (!iStack.isEmpty() && iStack.last().iObject) {
+        // Parts of the entry may be nested, e.g. Aegis keeps the secret
+        // in "info" and 2FAS keeps the account name in "otp"
+        Fields& parent = iStack.last().iFields;
+        Fields::ConstIterator it = fields.constBegin();
+
+        while (it != fields.constEnd()) {
+            if (!parent.contains(it.key())) {
+                parent.insert(it.key(), it.value());
+            }
+            ++it;
+        }
+    }
+}
+
+/* static */
+QByteArray
+YubiKeyBackupReader::Private::field(
+    const Fields& aFields,
+    const char* aKey1,
+    const char* aKey2,
+    const char* aKey3)
+{
+    QByteArray value(aFields.value(aKey1));
+
+    if (value.isEmpty() && aKey2) {
+        value = aFields.value(aKey2);
+    }
+    if (value.isEmpty() && aKey3) {
+        value = aFields.value(aKey3);
+    }
+    return value;
+}
+
+/* static */
+QByteArray
+YubiKeyBackupReader::Private::buildUri(
+    const Fields& aFields)
+{
+    QByteArray type(field(aFields, "type", "tokentype").toLower());
+
+    if (type.isEmpty()) {
+        type = "totp";
+    } else if (type != "totp" && type != "hotp") {
+        HDEBUG("Unsupported token type" << type.constData());
+        return QByteArray();
+    }
+
+    // The same thing as scanned from a QR code
+    const QByteArray issuer(field(aFields, "issuer"));
+    const QByteArray algorithm(field(aFields, "algorithm", "algo"));
+    const QByteArray digits(field(aFields, "digits"));
+    const QByteArray counter(field(aFields, "counter"));
+    QByteArray uri("otpauth://" + type + "/");
+
+    uri.append(QUrl::toPercentEncoding(QString::fromUtf8(field(aFields,
+        "label", "account", "name"))));
+    uri.append("?secret=");
+    uri.append(QUrl::toPercentEncoding(QString::fromUtf8(aFields.
+        value("secret"))));
+    if (!issuer.isEmpty()) {
+        uri.append("&issuer=");
+        uri.append(QUrl::toPercentEncoding(QString::fromUtf8(issuer)));
+    }
+    if (!algorithm.isEmpty()) {
+        uri.append("&algorithm=");
+        uri.append(QUrl::toPercentEncoding(QString::fromUtf8(algorithm)));
+    }
+    if (!digits.isEmpty()) {
+        uri.append("&digits=");
+        uri.append(digits);
+    }
+    if (!counter.isEmpty()) {
+        uri.append("&counter=");
+        uri.append(counter);
+    }
+    return uri;
+}
+
+// ==========================================================================
+// YubiKeyBackupReader
+// ==========================================================================
+
+YubiKeyBackupReader::YubiKeyBackupReader(
+    QIODevice* aDevice) :
+    iPrivate(new Private(aDevice))
+{
+}
+
+YubiKeyBackupReader::~YubiKeyBackupReader()
+{
+    delete iPrivate;
+}
+
+bool
+YubiKeyBackupReader::next(
+    QByteArray* aUri)
+{
+    Private* priv = iPrivate;
+
+    while (priv->iUris.isEmpty() && !priv->iError) {
+        if (priv->iFormat == Private::FormatUnknown) {
+            // Skip UTF-8 BOM
+            if (priv->fill() && !priv->iConsumed && !priv->iPos &&
+                priv->iBuf.startsWith("\xef\xbb\xbf")) {
+                priv->iPos = 3;
+            }
+            priv->skipSpace();
+
+            const int c = priv->peek();
+
+            if (c < 0) {
+                break;
+            }
+            priv->iFormat = (c == '{' || c == '[') ?
+                Private::FormatJson :
+                Private::FormatText;
+            HDEBUG((priv->iFormat == Private::FormatJson ? "JSON" : "text"));
+        }
+        if (!(priv->iFormat == Private::FormatJson ?
+            priv->readJson() : priv->readText())) {
+            break;
+        }
+    }
+
+    if (!priv->iUris.isEmpty()) {
+        *aUri = priv->iUris.takeFirst();
+        return true;
+    }
+    return false;
+}
+
+qreal
+YubiKeyBackupReader::progress() const
+{
+    return (iPrivate->iTotal > 0) ? qMin((qreal)(iPrivate->iConsumed +
+        iPrivate->iPos) / iPrivate->iTotal, (qreal)1) : 0;
+}
@@ -38,19 +38,28 @@
  */
 
 #include "YubiKeyImportModel.h"
+#include "YubiKey.h"
+#include "YubiKeyBackupReader.h"
+#include "YubiKeyMigrationPayload.h"
 #include "YubiKeyTypes.h"
 #include "YubiKeyUtil.h"
 
-#include "HarbourBase32.h"
 #include "HarbourDebug.h"
-#include "HarbourProtoBuf.h"
 
 #include <gutil_misc.h>
 
 #include <foil_input.h>
 #include <foil_util.h>
 
+#include <QtCore/QFile>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QPointer>
+#include <QtCore/QRunnable>
+#include <QtCore/QSet>
+#include <QtCore/QThreadPool>
 #include <QtCore/QUrl>
+#include <QtCore/QVector>
 
 // Model roles
 #define MODEL_ROLES_(first,role,last) \
@@ -61,6 +70,7 @@
     role(Secret,secret) \
     role(Digits,digits) \
     role(Counter,counter) \
+    role(Duplicate,duplicate) \
     last(Selected,selected)
 
 #define MODEL_ROLES(role) \
@@ -85,265 +95,6 @@
 #define OTPAUTH_HOTP_PREFIX OTPAUTH_SCHEME "://" TOKEN_TYPE_HOTP "/"
 #define OTPAUTH_MIGRATION_PREFIX   "otpauth-migration://offline?data="
 
-// ==========================================================================
-// YubiKeyImportModel::OtpParameters
-//
-// Represents otpauth-migration payload:
-//
-// message MigrationPayload {
-// enum Algorithm {
-//   ALGORITHM_UNSPECIFIED = 0;
-//   ALGORITHM_SHA1 = 1;
-//   ALGORITHM_SHA256 = 2;
-//   ALGORITHM_SHA512 = 3;
-//   ALGORITHM_MD5 = 4;  really???
-// }
-//
-// enum DigitCount {
-//   DIGIT_COUNT_UNSPECIFIED = 0;
-//   DIGIT_COUNT_SIX = 1;
-//   DIGIT_COUNT_EIGHT = 2;
-// }
-//
-// enum OtpType {
-//   OTP_TYPE_UNSPECIFIED = 0;
-//   OTP_TYPE_HOTP = 1;
-//   OTP_TYPE_TOTP = 2;
-// }
-//
-// message OtpParameters {
-//   bytes secret = 1;
-//   string name = 2;
-//   string issuer = 3;
-//   Algorithm algorithm = 4;
-//   DigitCount digits = 5;
-//   OtpType type = 6;
-//   int64 counter = 7;
-// }
-//
-// repeated OtpParameters otp_parameters = 1;
-// int32 version = 2;
-// int32 batch_size = 3;
-// int32 batch_index = 4;
-// int32 batch_id = 5;
-// }
-//
-// ==========================================================================
-
-class YubiKeyImportModel::OtpParameters
-{
-public:
-    enum Algorithm {
-        ALGORITHM_UNSPECIFIED,
-        ALGORITHM_SHA1,
-        ALGORITHM_SHA256,
-        ALGORITHM_SHA512,
-        ALGORITHM_MD5
-    };
-
-    enum DigitCount {
-        DIGIT_COUNT_UNSPECIFIED,
-        DIGIT_COUNT_SIX,
-        DIGIT_COUNT_EIGHT,
-    };
-
-    enum OtpType {
-        OTP_TYPE_UNSPECIFIED,
-        OTP_TYPE_HOTP,
-        OTP_TYPE_TOTP
-    };
-
-#define DELIMITED_TAG(x) (((x) << HarbourProtoBuf::TYPE_SHIFT) | HarbourProtoBuf::TYPE_DELIMITED)
-#define VARINT_TAG(x) (((x) << HarbourProtoBuf::TYPE_SHIFT) | HarbourProtoBuf::TYPE_VARINT)
-
-    static const uchar OTP_PARAMETERS_TAG = DELIMITED_TAG(1);
-    static const uchar SECRET_TAG = DELIMITED_TAG(1);
-    static const uchar NAME_TAG = DELIMITED_TAG(2);
-    static const uchar ISSUER_TAG = DELIMITED_TAG(3);
-    static const uchar ALGORITHM_TAG = VARINT_TAG(4);
-    static const uchar DIGITS_TAG = VARINT_TAG(5);
-    static const uchar TYPE_TAG = VARINT_TAG(6);
-    static const uchar COUNTER_TAG = VARINT_TAG(7);
-
-    static const uchar VERSION_TAG = VARINT_TAG(2);
-    static const uchar BATCH_SIZE_TAG = VARINT_TAG(3);
-    static const uchar BATCH_INDEX_TAG = VARINT_TAG(4);
-    static const uchar BATCH_ID_TAG = VARINT_TAG(5);
-
-    static const uchar VERSION = 1;
-
-public:
-    OtpParameters();
-
-    bool parse(GUtilRange*);
-    void clear();
-    bool isValid() const;
-    int numDigits() const;
-    YubiKeyAlgorithm yubiKeyAlgorithm() const;
-    YubiKeyTokenType yubiKeyTokenType() const;
-
-public:
-    QByteArray iSecret;
-    QString iName;
-    QString iIssuer;
-    Algorithm iAlgorithm;
-    DigitCount iDigits;
-    OtpType iType;
-    quint64 iCounter;
-};
-
-YubiKeyImportModel::OtpParameters::OtpParameters()
-{
-    clear();
-}
-
-void
-YubiKeyImportModel::OtpParameters::clear()
-{
-    iSecret.clear();
-    iName.clear();
-    iIssuer.clear();
-    iAlgorithm = ALGORITHM_SHA1;
-    iDigits = DIGIT_COUNT_SIX;
-    iType = OTP_TYPE_TOTP;
-    iCounter = 0;
-}
-
-bool
-YubiKeyImportModel::OtpParameters::isValid() const
-{
-    return !iSecret.isEmpty() &&
-        (iAlgorithm == ALGORITHM_SHA1 || iAlgorithm == ALGORITHM_SHA256 ||
-         iAlgorithm == ALGORITHM_SHA512) &&
-        (iDigits == DIGIT_COUNT_SIX || iDigits == DIGIT_COUNT_EIGHT) &&
-        (iType == OTP_TYPE_TOTP || iType == OTP_TYPE_HOTP);
-}
-
-int
-YubiKeyImportModel::OtpParameters::numDigits() const
-{
-    switch (iDigits) {
-    case DIGIT_COUNT_UNSPECIFIED: break;
-    case DIGIT_COUNT_SIX: return 6;
-    case DIGIT_COUNT_EIGHT: return 8;
-    }
-    return 0;
-}
-
-YubiKeyAlgorithm
-YubiKeyImportModel::OtpParameters::yubiKeyAlgorithm() const
-{
-    switch (iAlgorithm) {
-    case ALGORITHM_MD5: break; // Not supported
-    case ALGORITHM_UNSPECIFIED: break;
-    case ALGORITHM_SHA1: return YubiKeyAlgorithm_HMAC_SHA1;
-    case ALGORITHM_SHA256: return YubiKeyAlgorithm_HMAC_SHA256;
-    case ALGORITHM_SHA512:  return YubiKeyAlgorithm_HMAC_SHA512;
-    }
-    return YubiKeyAlgorithm_Unknown;
-}
-
-YubiKeyTokenType
-YubiKeyImportModel::OtpParameters::yubiKeyTokenType() const
-{
-    switch (iType) {
-    case OTP_TYPE_UNSPECIFIED: break;
-    case OTP_TYPE_HOTP: return YubiKeyTokenType_HOTP;
-    case OTP_TYPE_TOTP: return YubiKeyTokenType_TOTP;
-    }
-    return YubiKeyTokenType_Unknown;
-}
-
-bool
-YubiKeyImportModel::OtpParameters::parse(
-    GUtilRange* aPos)
-{
-    quint64 tag, value;
-    GUtilData payload;
-    GUtilRange pos = *aPos;
-
-    clear();
-
-    // Skip leading varints
-    while (HarbourProtoBuf::parseVarInt(&pos, &tag) &&
-        (tag & HarbourProtoBuf::TYPE_MASK) == HarbourProtoBuf::TYPE_VARINT) {
-        if (!HarbourProtoBuf::parseVarInt(&pos, &value)) {
-            return false;
-        }
-    }
-
-    // If parseVarInt failed, tag is zero
-    if (tag == OTP_PARAMETERS_TAG &&
-        HarbourProtoBuf::parseDelimitedValue(&pos, &payload)) {
-        // Looks like OtpParameters
-        quint64 value;
-
-        pos.end = (pos.ptr = payload.bytes) + payload.size;
-        while (HarbourProtoBuf::parseVarInt(&pos, &tag)) {
-            switch (tag) {
-            case SECRET_TAG:
-                if (HarbourProtoBuf::parseDelimitedValue(&pos, &payload)) {
-                    iSecret = YubiKeyUtil::toByteArray(&payload);
-                } else {
-                    return false;
-                }
-                break;
-            case NAME_TAG:
-                if (HarbourProtoBuf::parseDelimitedValue(&pos, &payload)) {
-                    iName = QString::fromUtf8((const char*) payload.bytes, payload.size);
-                } else {
-                    return false;
-                }
-                break;
-            case ISSUER_TAG:
-                if (HarbourProtoBuf::parseDelimitedValue(&pos, &payload)) {
-                    iIssuer = QString::fromUtf8((const char*) payload.bytes, payload.size);
-                } else {
-                    return false;
-                }
-                break;
-            case ALGORITHM_TAG:
-                if (HarbourProtoBuf::parseVarInt(&pos, &value)) {
-                    iAlgorithm = (Algorithm)value;
-                } else {
-                    return false;
-                }
-                break;
-            case DIGITS_TAG:
-                if (HarbourProtoBuf::parseVarInt(&pos, &value)) {
-                    iDigits = (DigitCount)value;
-                } else {
-                    return false;
-                }
-                break;
-            case TYPE_TAG:
-                if (HarbourProtoBuf::parseVarInt(&pos, &value)) {
-                    iType = (OtpType)value;
-                } else {
-                    return false;
-                }
-                break;
-            case COUNTER_TAG:
-                if (HarbourProtoBuf::parseVarInt(&pos, &value)) {
-                    iCounter = value;
-                } else {
-                    return false;
-                }
-                break;
-            default:
-                // Something unintelligible
-                return false;
-            }
-        }
-        if (pos.ptr == pos.end && isValid()) {
-            // The whole thing has been parsed and looks legit
-            aPos->ptr = pos.end;
-            return true;
-        }
-    }
-    return false;
-}
-
 // ==========================================================================
 // YubiKeyImportModel::ModelData
 // ==========================================================================
@@ -364,33 +115,63 @@ public:
     };
 
     ModelData(const YubiKeyToken);
-    ModelData(const OtpParameters*);
+    ModelData(const YubiKeyMigrationPayload::OtpParameters*);
 
     QVariant get(Role) const;
+    void setToken(const YubiKeyToken);
+    static QByteArray nameHash(const YubiKeyToken&);
 
 public:
     bool iSelected;
+    Duplicate iDuplicate;
     YubiKeyToken iToken;
+    QByteArray iNameHash;   // Hash of the name as it's stored on the key
 };
 
 YubiKeyImportModel::ModelData::ModelData(
     const YubiKeyToken aToken) :
     iSelected(true),
-    iToken(aToken)
+    iDuplicate(NotDuplicate),
+    iToken(aToken),
+    iNameHash(nameHash(aToken))
 {
 }
 
 YubiKeyImportModel::ModelData::ModelData(
-    const OtpParameters* aOtpParams) :
+    const YubiKeyMigrationPayload::OtpParameters* aOtpParams) :
     iSelected(true),
+    iDuplicate(NotDuplicate),
     iToken(aOtpParams->yubiKeyTokenType(),
         aOtpParams->yubiKeyAlgorithm(),
-        aOtpParams->iName,
-        aOtpParams->iIssuer,
-        aOtpParams->iSecret,
+        QString::fromUtf8((const char*) aOtpParams->iName.bytes,
+            aOtpParams->iName.size),
+        QString::fromUtf8((const char*) aOtpParams->iIssuer.bytes,
+            aOtpParams->iIssuer.size),
+        QByteArray((const char*) aOtpParams->iSecret.bytes,
+            aOtpParams->iSecret.size),
         aOtpParams->numDigits(),
-        (int)aOtpParams->iCounter)
+        aOtpParams->counter()),
+    iNameHash(nameHash(iToken))
+{
+}
+
+/* static */
+inline
+QByteArray
+YubiKeyImportModel::ModelData::nameHash(
+    const YubiKeyToken& aToken)
 {
+    return YubiKeyUtil::hashUtf8(YubiKeyUtil::nameToUtf8(aToken.label()));
+}
+
+void
+YubiKeyImportModel::ModelData::setToken(
+    const YubiKeyToken aToken)
+{
+    if (iToken.label() != aToken.label()) {
+        iNameHash = nameHash(aToken);
+    }
+    iToken = aToken;
 }
 
 QVariant
@@ -405,6 +186,7 @@ YubiKeyImportModel::ModelData::get(
     case SecretRole: return iToken.secretBase32();
     case DigitsRole: return iToken.digits();
     case CounterRole: return iToken.counter();
+    case DuplicateRole: return (int) iDuplicate;
     case SelectedRole: return iSelected;
     }
     return QVariant();
@@ -414,36 +196,78 @@ YubiKeyImportModel::ModelData::get(
 // YubiKeyImportModel::Private
 // ==========================================================================
 
-class YubiKeyImportModel::Private
+class YubiKeyImportModel::Private :
+    public QObject
 {
+    Q_OBJECT
+
 public:
     Private(YubiKeyImportModel*);
     ~Private();
 
     ModelData* dataAt(int);
-    void setOtpUri(const QString);
+    void setOtpUris(const QStringList);
+    void importFile(const QString);
+    void startParsing(ParseTask*);
+    void cancelParsing();
     void setItems(const ModelData::List);
-    void updateSelectedTokens();
+    void appendItems(const ModelData::List);
+    const QList<YubiKeyToken>& selectedTokens();
+    void selectionChanged(int);
+    static int countSelected(const ModelData::List);
+    void setYubiKey(YubiKey*);
+    void markDuplicates(const ModelData::List, QSet<QByteArray>*);
+    void updateDuplicates();
+
+    struct Batch {
+        int iId;
+        int iSize;
+        int iIndex;
+    };
 
     static YubiKeyToken parseOtpAuthUri(const QByteArray);
-    static ModelData::List parseMigrationUri(const QByteArray);
-    static ModelData::List parseProtoBuf(gconstpointer, gsize);
+    static ModelData::List parseMigrationUri(const QByteArray, Batch*);
+    static ModelData::List parsePayload(gconstpointer, gsize, Batch*);
+
+public Q_SLOTS:
+    void onRowsParsed();
+    void onParseFinished();
+    void onOtpListChanged();
 
 public:
     YubiKeyImportModel* iModel;
+    QPointer<YubiKey> iYubiKey;
+    QSet<QByteArray> iKeyNameHashes;
     ModelData::List iList;
-    QList<YubiKeyToken> iSelectedTokens;
-    QString iOtpUri;
+    QList<YubiKeyToken> iSelectedTokens;    // Built on demand
+    bool iSelectedTokensValid;
+    int iSelectedCount;
+    QStringList iOtpUris;
+    QList<int> iMissingBatchIndices;
+    int iMissingBatchCount;
+    int iBatchCount;
+    ParseTask* iParseTask;
+    bool iReplaceRows;
+    qreal iProgress;
 };
 
 YubiKeyImportModel::Private::Private(
     YubiKeyImportModel* aModel) :
-    iModel(aModel)
+    QObject(aModel),
+    iModel(aModel),
+    iSelectedTokensValid(true),
+    iSelectedCount(0),
+    iMissingBatchCount(0),
+    iBatchCount(0),
+    iParseTask(Q_NULLPTR),
+    iReplaceRows(false),
+    iProgress(1)
 {
 }
 
 YubiKeyImportModel::Private::~Private()
 {
+    cancelParsing();
     qDeleteAll(iList);
 }
 
@@ -457,24 +281,38 @@ YubiKeyImportModel::Private::dataAt(
 }
 
 YubiKeyImportModel::ModelData::List
-YubiKeyImportModel::Private::parseProtoBuf(
+YubiKeyImportModel::Private::parsePayload(
     gconstpointer aData,
-    gsize aSize)
+    gsize aSize,
+    Batch* aBatch)
 {
+    YubiKeyMigrationPayload payload;
     ModelData::List list;
-    OtpParameters otp;
-    GUtilRange pos;
 
-    pos.end = (pos.ptr = (const guint8*) aData) + aSize;
-    while (otp.parse(&pos)) {
-        list.append(new ModelData(&otp));
+    // Entries parsed before the damage are still usable, but the batch
+    // information of a partially parsed payload can't be trusted
+    payload.parse(aData, aSize);
+    const int n = payload.iOtpParameters.count();
+    if (n > 0) {
+        list.reserve(n);
+        for (int i = 0; i < n; i++) {
+            list.append(new ModelData(&payload.iOtpParameters.at(i)));
+        }
+        if (payload.hasValidBatch()) {
+            aBatch->iId = payload.iBatchId;
+            aBatch->iSize = payload.iBatchSize;
+            aBatch->iIndex = payload.iBatchIndex;
+        } else {
+            aBatch->iId = aBatch->iIndex = aBatch->iSize = 0;
+        }
     }
     return list;
 }
 
 YubiKeyImportModel::ModelData::List
 YubiKeyImportModel::Private::parseMigrationUri(
-    const QByteArray aUri)
+    const QByteArray aUri,
+    Batch* aBatch)
 {
     GUtilRange pos;
     GUtilData prefixBytes;
@@ -505,7 +343,7 @@ YubiKeyImportModel::Private::parseMigrationUri(
                 }
 #endif // HARBOUR_DEBUG
 
-                list = parseProtoBuf(data, size);
+                list = parsePayload(data, size, aBatch);
                 HDEBUG(list.count() << "tokens");
                 g_bytes_unref(bytes);
             }
@@ -579,8 +417,9 @@ YubiKeyImportModel::Private::parseOtpAuthUri(
         }
 
         if (!secret.isEmpty()) {
-            const QByteArray bytes(HarbourBase32::
-                fromBase32(QUrl::fromPercentEncoding(secret)));
+            // Padding may be percent-encoded, otherwise decode in place
+            const QByteArray bytes(YubiKeyUtil::fromBase32(secret.contains('%')
+                ? QByteArray::fromPercentEncoding(secret) : secret));
 
             if (!bytes.isEmpty()) {
                 const YubiKeyAlgorithm alg = algorithm.isEmpty() ?
@@ -622,36 +461,386 @@ YubiKeyImportModel::Private::parseOtpAuthUri(
     return YubiKeyToken();
 }
 
+// ==========================================================================
+// YubiKeyImportModel::ParseTask
+//
+// Decodes the URIs on a worker thread. Parsed rows are handed over to
+// the main thread in batches, so that large exports don't block the UI.
+// ==========================================================================
+
+class YubiKeyImportModel::ParseTask :
+    public QObject,
+    public QRunnable
+{
+    Q_OBJECT
+
+public:
+    static const int BatchSize = 16;
+
+    ParseTask(const QStringList, const QString aPath = QString());
+    ~ParseTask();
+
+    void cancel();
+    bool cancelled() const;
+    ModelData::List takeRows(int);
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    void parseUri(const QString);
+    void publish(bool aFlush);
+    void setProgress(qreal);
+
+Q_SIGNALS:
+    void rowsParsed();
+    void parseFinished();
+
+public:
+    const QStringList iOtpUris;
+    const QString iPath;
+    QAtomicInt iCancelled;
+    QMutex iMutex;
+    ModelData::List iRows;
+    qreal iProgress;
+    int iBatchCount;
+    int iMissingBatchCount;
+    QList<int> iMissingBatchIndices;
+
+private:
+    // These are only touched by the worker thread
+    ModelData::List iUnpublished;
+    QSet<QString> iSeen;
+    QMap<int,int> iBatchSizes;
+    QMap<int,QSet<int> > iBatchParts;
+};
+
+YubiKeyImportModel::ParseTask::ParseTask(
+    const QStringList aOtpUris,
+    const QString aPath) :
+    iOtpUris(aOtpUris),
+    iPath(aPath),
+    iProgress(0),
+    iBatchCount(0),
+    iMissingBatchCount(0)
+{
+    // Deletes itself with deleteLater() when done
+    setAutoDelete(false);
+}
+
+YubiKeyImportModel::ParseTask::~ParseTask()
+{
+    qDeleteAll(iRows);
+    qDeleteAll(iUnpublished);
+}
+
+inline
 void
-YubiKeyImportModel::Private::setOtpUri(
-    const QString aOtpUri)
+YubiKeyImportModel::ParseTask::cancel()
 {
-    if (iOtpUri != aOtpUri) {
-        iOtpUri = aOtpUri;
+    iCancelled.storeRelease(1);
+}
 
-        const QByteArray uri(iOtpUri.trimmed().toUtf8());
-        HDEBUG(uri.constData());
+inline
+bool
+YubiKeyImportModel::ParseTask::cancelled() const
+{
+    return iCancelled.loadAcquire() != 0;
+}
+
+YubiKeyImportModel::ModelData::List
+YubiKeyImportModel::ParseTask::takeRows(
+    int aMaxCount)
+{
+    QMutexLocker lock(&iMutex);
+    const ModelData::List rows(iRows.mid(0, aMaxCount));
+
+    iRows = iRows.mid(rows.count());
+    return rows;
+}
+
+void
+YubiKeyImportModel::ParseTask::publish(
+    bool aFlush)
+{
+    // One signal per batch
+    while (!cancelled() && (iUnpublished.count() >= BatchSize ||
+        (aFlush && !iUnpublished.isEmpty()))) {
+        const ModelData::List batch(iUnpublished.mid(0, BatchSize));
+
+        iUnpublished = iUnpublished.mid(batch.count());
+        iMutex.lock();
+        iRows.append(batch);
+        iMutex.unlock();
+        Q_EMIT rowsParsed();
+    }
+}
+
+void
+YubiKeyImportModel::ParseTask::setProgress(
+    qreal aProgress)
+{
+    iMutex.lock();
+    iProgress = aProgress;
+    iMutex.unlock();
+}
+
+void
+YubiKeyImportModel::ParseTask::parseUri(
+    const QString aUri)
+{
+    const QString text(aUri.trimmed());
 
-        ModelData::List list;
-        const YubiKeyToken singleToken(parseOtpAuthUri(uri));
+    if (iSeen.contains(text)) {
+        HDEBUG("duplicate" << text);
+        return;
+    }
+
+    const QByteArray uri(text.toUtf8());
+    const YubiKeyToken singleToken(Private::parseOtpAuthUri(uri));
+
+    iSeen.insert(text);
+    HDEBUG(uri.constData());
+    if (singleToken.valid()) {
+        iUnpublished.append(new ModelData(singleToken));
+        HDEBUG("single token" << singleToken);
+    } else {
+        Private::Batch batch;
+
+        batch.iSize = 0;
+        iUnpublished.append(Private::parseMigrationUri(uri, &batch));
+        if (batch.iSize > 0) {
+            HDEBUG("batch" << batch.iId << (batch.iIndex + 1) <<
+                "of" << batch.iSize);
+            iBatchSizes.insert(batch.iId, batch.iSize);
+            iBatchParts[batch.iId].insert(batch.iIndex);
+        }
+    }
+}
+
+void
+YubiKeyImportModel::ParseTask::run()
+{
+    if (iPath.isEmpty()) {
+        const int n = iOtpUris.count();
 
-        if (singleToken.valid()) {
-            list.append(new ModelData(singleToken));
-            HDEBUG("single token" << singleToken);
+        for (int i = 0; i < n && !cancelled(); i++) {
+            parseUri(iOtpUris.at(i));
+            setProgress((qreal)(i + 1) / n);
+            publish(false);
+        }
+    } else {
+        // Backup files are streamed, they can be large
+        QFile file(iPath);
+
+        if (file.open(QIODevice::ReadOnly)) {
+            YubiKeyBackupReader reader(&file);
+            QByteArray uri;
+
+            HDEBUG("Reading" << qPrintable(iPath));
+            while (!cancelled() && reader.next(&uri)) {
+                parseUri(QString::fromUtf8(uri));
+                setProgress(reader.progress());
+                publish(false);
+            }
         } else {
-            list = parseMigrationUri(uri);
+            HWARN("Failed to open" << qPrintable(iPath) <<
+                file.errorString());
+        }
+    }
+    publish(true);
+
+    if (!cancelled()) {
+        // Parts of multi-part exports which are still missing. Different
+        // exports may be missing the same index, so the parts are counted
+        // per batch id and only the indices are merged.
+        QList<int> missing;
+        int missingCount = 0;
+        int batchCount = 0;
+        QMapIterator<int,int> it(iBatchSizes);
+        while (it.hasNext()) {
+            it.next();
+            const QSet<int> parts(iBatchParts.value(it.key()));
+            const int size = it.value();
+
+            batchCount += size;
+            for (int k = 0; k < size; k++) {
+                if (!parts.contains(k)) {
+                    missingCount++;
+                    if (!missing.contains(k)) {
+                        missing.append(k);
+                    }
+                }
+            }
         }
+        std::sort(missing.begin(), missing.end());
+
+        iMutex.lock();
+        iProgress = 1;
+        iBatchCount = batchCount;
+        iMissingBatchCount = missingCount;
+        iMissingBatchIndices = missing;
+        iMutex.unlock();
+        Q_EMIT parseFinished();
+    }
 
-        if (!list.isEmpty()) {
-            setItems(list);
-        } else if (iList.count() > 0) {
-            iModel->beginRemoveRows(QModelIndex(), 0, iList.count() - 1);
-            qDeleteAll(iList);
-            iList.clear();
-            iModel->endRemoveRows();
+    // The object belongs to the main thread
+    deleteLater();
+}
+
+// ==========================================================================
+// YubiKeyImportModel::Private
+// ==========================================================================
+
+void
+YubiKeyImportModel::Private::setOtpUris(
+    const QStringList aOtpUris)
+{
+    if (iOtpUris != aOtpUris) {
+        const QString prevOtpUri(iModel->otpUri());
+
+        iOtpUris = aOtpUris;
+        startParsing(new ParseTask(aOtpUris));
+        if (iModel->otpUri() != prevOtpUri) {
+            Q_EMIT iModel->otpUriChanged();
         }
+        Q_EMIT iModel->otpUrisChanged();
+    }
+}
 
+void
+YubiKeyImportModel::Private::importFile(
+    const QString aPath)
+{
+    const QUrl url(aPath);
+    const QString path(url.isLocalFile() ? url.toLocalFile() : aPath);
+
+    // The file replaces the URIs
+    startParsing(new ParseTask(QStringList(), path));
+    if (!iOtpUris.isEmpty()) {
+        iOtpUris.clear();
         Q_EMIT iModel->otpUriChanged();
+        Q_EMIT iModel->otpUrisChanged();
+    }
+}
+
+void
+YubiKeyImportModel::Private::startParsing(
+    ParseTask* aTask)
+{
+    const bool wasParsing = (iParseTask != Q_NULLPTR);
+
+    // The previous results (if any) are no longer needed
+    cancelParsing();
+    iReplaceRows = true;
+    iProgress = 0;
+    iParseTask = aTask;
+    connect(aTask, SIGNAL(rowsParsed()), SLOT(onRowsParsed()));
+    connect(aTask, SIGNAL(parseFinished()), SLOT(onParseFinished()));
+    QThreadPool::globalInstance()->start(aTask);
+    if (!wasParsing) {
+        Q_EMIT iModel->parsingChanged();
+    }
+    Q_EMIT iModel->progressChanged();
+}
+
+void
+YubiKeyImportModel::Private::cancelParsing()
+{
+    if (iParseTask) {
+        iParseTask->disconnect(this);
+        iParseTask->cancel();
+        iParseTask = Q_NULLPTR;
+    }
+}
+
+void
+YubiKeyImportModel::Private::onRowsParsed()
+{
+    ParseTask* task = qobject_cast<ParseTask*>(sender());
+
+    if (task == iParseTask) {
+        const ModelData::List rows(task->takeRows(ParseTask::BatchSize));
+
+        if (!rows.isEmpty()) {
+            if (iReplaceRows) {
+                // The first batch replaces the previous contents
+                iReplaceRows = false;
+                setItems(rows);
+            } else {
+                appendItems(rows);
+            }
+        }
+
+        task->iMutex.lock();
+        const qreal progress = task->iProgress;
+        task->iMutex.unlock();
+        if (iProgress != progress) {
+            iProgress = progress;
+            Q_EMIT iModel->progressChanged();
+        }
+    }
+}
+
+void
+YubiKeyImportModel::Private::onParseFinished()
+{
+    ParseTask* task = qobject_cast<ParseTask*>(sender());
+
+    if (task == iParseTask) {
+        iParseTask = Q_NULLPTR;
+        task->iMutex.lock();
+        const int batchCount = task->iBatchCount;
+        const int missingCount = task->iMissingBatchCount;
+        const QList<int> missing(task->iMissingBatchIndices);
+        task->iMutex.unlock();
+
+        if (iReplaceRows) {
+            // Nothing has been found
+            iReplaceRows = false;
+            setItems(ModelData::List());
+        }
+
+        const bool batchInfoChanged = (iBatchCount != batchCount ||
+            iMissingBatchCount != missingCount ||
+            iMissingBatchIndices != missing);
+        iBatchCount = batchCount;
+        iMissingBatchCount = missingCount;
+        iMissingBatchIndices = missing;
+        if (batchInfoChanged) {
+            Q_EMIT iModel->batchInfoChanged();
+        }
+        if (iProgress != 1) {
+            iProgress = 1;
+            Q_EMIT iModel->progressChanged();
+        }
+        Q_EMIT iModel->parsingChanged();
+        Q_EMIT iModel->parsingFinished();
+    }
+}
+
+void
+YubiKeyImportModel::Private::appendItems(
+    const ModelData::List aList)
+{
+    const int prevCount = iList.count();
+    QSet<QByteArray> names;
+
+    for (int i = 0; i < prevCount; i++) {
+        names.insert(iList.at(i)->iNameHash);
+    }
+    markDuplicates(aList, &names);
+
+    const int selected = countSelected(aList);
+
+    iModel->beginInsertRows(QModelIndex(), prevCount,
+        prevCount + aList.count() - 1);
+    iList.append(aList);
+    iModel->endInsertRows();
+
+    if (selected) {
+        const int prevSelected = iSelectedCount;
+
+        iSelectedCount += selected;
+        selectionChanged(prevSelected);
     }
 }
 
@@ -662,8 +851,10 @@ YubiKeyImportModel::Private::setItems(
     const int prevCount = iList.count();
     const int newCount = aList.count();
     const int changed = qMin(prevCount, newCount);
-    const QList<YubiKeyToken> prevSelectedTokens(iSelectedTokens);
+    const int prevSelected = iSelectedCount;
+    QSet<QByteArray> names;
 
+    markDuplicates(aList, &names);
     if (newCount < prevCount) {
         iModel->beginRemoveRows(QModelIndex(), newCount, prevCount - 1);
         qDeleteAll(iList);
@@ -679,34 +870,170 @@ YubiKeyImportModel::Private::setItems(
         iList = aList;
     }
 
-    updateSelectedTokens();
-    if (prevSelectedTokens != iSelectedTokens) {
-        if (!prevSelectedTokens.count() != !iSelectedTokens.count()) {
-            Q_EMIT iModel->haveSelectedTokensChanged();
-        }
-        Q_EMIT iModel->selectedTokensChanged();
+    iSelectedCount = countSelected(iList);
+    if (prevSelected || iSelectedCount) {
+        selectionChanged(prevSelected);
     }
     if (changed > 0) {
         Q_EMIT iModel->dataChanged(iModel->index(0), iModel->index(changed - 1));
     }
 }
 
+// New rows which would collide with something are deselected
+void
+YubiKeyImportModel::Private::markDuplicates(
+    const ModelData::List aRows,
+    QSet<QByteArray>* aNames)
+{
+    const int n = aRows.count();
+
+    for (int i = 0; i < n; i++) {
+        ModelData* entry = aRows.at(i);
+
+        entry->iDuplicate = iKeyNameHashes.contains(entry->iNameHash) ?
+            DuplicateOnYubiKey : aNames->contains(entry->iNameHash) ?
+            DuplicateInList : NotDuplicate;
+        if (entry->iDuplicate != NotDuplicate) {
+            HDEBUG(entry->iToken.label() << "duplicate" << entry->iDuplicate);
+            entry->iSelected = false;
+        } else {
+            aNames->insert(entry->iNameHash);
+        }
+    }
+}
+
+// Re-checks the existing rows after a name or the list of credentials
+// on the key has changed. Newly found duplicates are deselected.
 void
-YubiKeyImportModel::Private::updateSelectedTokens()
+YubiKeyImportModel::Private::updateDuplicates()
 {
-    QList<YubiKeyToken> list;
     const int n = iList.count();
+    const int prevSelected = iSelectedCount;
+    QSet<QByteArray> names;
+    QVector<int> roles;
+    int first = -1, last = -1;
 
+    roles.append(ModelData::DuplicateRole);
+    roles.append(ModelData::SelectedRole);
     for (int i = 0; i < n; i++) {
-        const ModelData* entry = iList.at(i);
+        ModelData* entry = iList.at(i);
+        const Duplicate duplicate = iKeyNameHashes.contains(entry->
+            iNameHash) ? DuplicateOnYubiKey : names.contains(entry->
+            iNameHash) ? DuplicateInList : NotDuplicate;
+
+        if (entry->iDuplicate != duplicate) {
+            HDEBUG(entry->iToken.label() << "duplicate" << duplicate);
+            if (entry->iDuplicate == NotDuplicate && entry->iSelected) {
+                entry->iSelected = false;
+                iSelectedCount--;
+            }
+            entry->iDuplicate = duplicate;
+            if (first < 0) {
+                first = i;
+            }
+            last = i;
+        }
+        if (duplicate == NotDuplicate) {
+            names.insert(entry->iNameHash);
+        }
+    }
+
+    if (first >= 0) {
+        Q_EMIT iModel->dataChanged(iModel->index(first),
+            iModel->index(last), roles);
+    }
+    if (iSelectedCount != prevSelected) {
+        selectionChanged(prevSelected);
+    }
+}
 
-        if (entry->iSelected) {
-            list.append(entry->iToken);
+void
+YubiKeyImportModel::Private::setYubiKey(
+    YubiKey* aYubiKey)
+{
+    if (iYubiKey != aYubiKey) {
+        if (iYubiKey) {
+            iYubiKey->disconnect(this);
+        }
+        iYubiKey = aYubiKey;
+        if (aYubiKey) {
+            connect(aYubiKey, SIGNAL(otpListChanged()),
+                SLOT(onOtpListChanged()));
         }
+        onOtpListChanged();
+        Q_EMIT iModel->yubiKeyChanged();
     }
+}
 
-    HDEBUG("selected" << list);
-    iSelectedTokens = list;
+void
+YubiKeyImportModel::Private::onOtpListChanged()
+{
+    // Names are compared the same way as the list model does it
+    const QList<YubiKeyOtp> otps(iYubiKey ? iYubiKey->otpList() :
+        QList<YubiKeyOtp>());
+    const int n = otps.count();
+    QSet<QByteArray> hashes;
+
+    hashes.reserve(n);
+    for (int i = 0; i < n; i++) {
+        hashes.insert(YubiKeyUtil::hashUtf8(otps.at(i).iName));
+    }
+    if (iKeyNameHashes != hashes) {
+        iKeyNameHashes = hashes;
+        updateDuplicates();
+    }
+}
+
+/* static */
+int
+YubiKeyImportModel::Private::countSelected(
+    const ModelData::List aList)
+{
+    const int n = aList.count();
+    int count = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (aList.at(i)->iSelected) {
+            count++;
+        }
+    }
+    return count;
+}
+
+const QList<YubiKeyToken>&
+YubiKeyImportModel::Private::selectedTokens()
+{
+    // The list is only built when someone asks for it
+    if (!iSelectedTokensValid) {
+        const int n = iList.count();
+
+        iSelectedTokens.clear();
+        iSelectedTokens.reserve(iSelectedCount);
+        for (int i = 0; i < n; i++) {
+            const ModelData* entry = iList.at(i);
+
+            if (entry->iSelected) {
+                iSelectedTokens.append(entry->iToken);
+            }
+        }
+        iSelectedTokensValid = true;
+        HDEBUG("selected" << iSelectedTokens);
+    }
+    return iSelectedTokens;
+}
+
+// Called after iSelectedCount has been updated or a selected token
+// has changed
+void
+YubiKeyImportModel::Private::selectionChanged(
+    int aPrevSelectedCount)
+{
+    iSelectedTokensValid = false;
+    iSelectedTokens.clear();
+    if (!aPrevSelectedCount != !iSelectedCount) {
+        Q_EMIT iModel->haveSelectedTokensChanged();
+    }
+    Q_EMIT iModel->selectedTokensChanged();
 }
 
 // ==========================================================================
@@ -728,17 +1055,71 @@ YubiKeyImportModel::~YubiKeyImportModel()
     delete iPrivate;
 }
 
+YubiKey*
+YubiKeyImportModel::yubiKey() const
+{
+    return iPrivate->iYubiKey.data();
+}
+
+void
+YubiKeyImportModel::setYubiKey(
+    YubiKey* aYubiKey)
+{
+    iPrivate->setYubiKey(aYubiKey);
+}
+
 QString
 YubiKeyImportModel::otpUri() const
 {
-    return iPrivate->iOtpUri;
+    // The first one if there are several
+    return iPrivate->iOtpUris.isEmpty() ? QString() :
+        iPrivate->iOtpUris.first();
 }
 
 void
 YubiKeyImportModel::setOtpUri(
     const QString aOtpUri)
 {
-    iPrivate->setOtpUri(aOtpUri);
+    iPrivate->setOtpUris(aOtpUri.isEmpty() ? QStringList() :
+        QStringList(aOtpUri));
+}
+
+int
+YubiKeyImportModel::batchCount() const
+{
+    return iPrivate->iBatchCount;
+}
+
+int
+YubiKeyImportModel::missingBatchCount() const
+{
+    return iPrivate->iMissingBatchCount;
+}
+
+QList<int>
+YubiKeyImportModel::missingBatchIndices() const
+{
+    return iPrivate->iMissingBatchIndices;
+}
+
+QStringList
+YubiKeyImportModel::otpUris() const
+{
+    return iPrivate->iOtpUris;
+}
+
+void
+YubiKeyImportModel::setOtpUris(
+    const QStringList aOtpUris)
+{
+    iPrivate->setOtpUris(aOtpUris);
+}
+
+void
+YubiKeyImportModel::importFile(
+    QString aPath)
+{
+    iPrivate->importFile(aPath);
 }
 
 QVariantMap
@@ -753,13 +1134,25 @@ YubiKeyImportModel::getToken(
 QList<YubiKeyToken>
 YubiKeyImportModel::selectedTokens() const
 {
-    return iPrivate->iSelectedTokens;
+    return iPrivate->selectedTokens();
 }
 
 bool
 YubiKeyImportModel::haveSelectedTokens() const
 {
-    return !iPrivate->iSelectedTokens.isEmpty();
+    return iPrivate->iSelectedCount > 0;
+}
+
+bool
+YubiKeyImportModel::parsing() const
+{
+    return iPrivate->iParseTask != Q_NULLPTR;
+}
+
+qreal
+YubiKeyImportModel::progress() const
+{
+    return iPrivate->iProgress;
 }
 
 Qt::ItemFlags
@@ -850,7 +1243,7 @@ YubiKeyImportModel::setData(
             s = aValue.toString();
             HDEBUG(aIndex.row() << "label" << s);
             if (entry->iToken.label() != s) {
-                entry->iToken = entry->iToken.withLabel(s);
+                entry->setToken(entry->iToken.withLabel(s));
                 roles.append(aRole);
             }
             ok = true;
@@ -867,15 +1260,18 @@ YubiKeyImportModel::setData(
             break;
 
         case ModelData::SecretRole:
-            s = aValue.toString().trimmed().toLower();
-            ok = HarbourBase32::isValidBase32(s);
-            if (ok) {
-                const QByteArray secret(HarbourBase32::fromBase32(s));
-
-                HDEBUG(aIndex.row() << "secret" << s);
-                if (entry->iToken.secret() != secret) {
-                    entry->iToken = entry->iToken.withSecret(secret);
-                    roles.append(aRole);
+            s = aValue.toString();
+            {
+                // Validates and decodes in one go
+                const QByteArray secret(YubiKeyUtil::fromBase32(s));
+
+                ok = !secret.isEmpty();
+                if (ok) {
+                    HDEBUG(aIndex.row() << "secret" << s);
+                    if (entry->iToken.secret() != secret) {
+                        entry->iToken = entry->iToken.withSecret(secret);
+                        roles.append(aRole);
+                    }
                 }
             }
             break;
@@ -914,28 +1310,27 @@ YubiKeyImportModel::setData(
                 entry->iSelected = b;
                 roles.append(aRole);
 
-                // Selection has changed, update the list of selected tokens
-                const bool hadSelectedTokens = haveSelectedTokens();
-                iPrivate->updateSelectedTokens();
-                if (hadSelectedTokens != haveSelectedTokens()) {
-                    Q_EMIT haveSelectedTokensChanged();
-                }
-                // If the entry is selected, the signal will be emitted from
-                // common place below
-                if (!entry->iSelected) {
-                    Q_EMIT selectedTokensChanged();
-                }
+                // Selection has changed, just update the count
+                const int prevSelected = iPrivate->iSelectedCount;
+                iPrivate->iSelectedCount += b ? 1 : -1;
+                iPrivate->selectionChanged(prevSelected);
             }
             ok = true;
             break;
+
+        case ModelData::DuplicateRole:
+            // Read-only
+            break;
         }
 
         if (!roles.isEmpty()) {
-            if (entry->iSelected) {
-                iPrivate->updateSelectedTokens();
-                Q_EMIT selectedTokensChanged();
+            if (entry->iSelected && aRole != ModelData::SelectedRole) {
+                iPrivate->selectionChanged(iPrivate->iSelectedCount);
             }
             Q_EMIT dataChanged(aIndex, aIndex, roles);
+            if (aRole == ModelData::LabelRole) {
+                iPrivate->updateDuplicates();
+            }
         }
     }
     return ok;
@@ -956,67 +1351,69 @@ YubiKeyImportModel::setToken(
 
     if (entry) {
         QVector<int> roles;
+        const YubiKeyToken& token = entry->iToken;
         const YubiKeyTokenType type = YubiKeyUtil::validType(aType);
         const YubiKeyAlgorithm alg = YubiKeyUtil::validAlgorithm(aAlgorithm);
-        const QString secret(aSecretBase32.trimmed());
+        const QByteArray secret(YubiKeyUtil::fromBase32(aSecretBase32));
+        YubiKeyToken::Builder builder(token);
 
-        if (type != YubiKeyTokenType_Unknown &&
-            type != entry->iToken.type()) {
-            entry->iToken = entry->iToken.withType(type);
+        // Collect all the changes and update the token in one go
+        if (type != YubiKeyTokenType_Unknown && type != token.type()) {
+            builder.setType(type);
             HDEBUG(aRow << "type" << type);
             roles.append(ModelData::TypeRole);
         }
 
-        if (alg != YubiKeyAlgorithm_Unknown &&
-            alg != entry->iToken.algorithm()) {
-            entry->iToken = entry->iToken.withAlgorithm(alg);
+        if (alg != YubiKeyAlgorithm_Unknown && alg != token.algorithm()) {
+            builder.setAlgorithm(alg);
             HDEBUG(aRow << "algorithm" << alg);
             roles.append(ModelData::AlgorithmRole);
         }
 
-        if (entry->iToken.label() != aLabel) {
-            entry->iToken = entry->iToken.withLabel(aLabel);
+        if (token.label() != aLabel) {
+            builder.setLabel(aLabel);
             HDEBUG(aRow << "label" << aLabel);
             roles.append(ModelData::LabelRole);
         }
 
-        if (entry->iToken.issuer() != aIssuer) {
-            entry->iToken = entry->iToken.withIssuer(aIssuer);
+        if (token.issuer() != aIssuer) {
+            builder.setIssuer(aIssuer);
             HDEBUG(aRow << "issuer" << aIssuer);
             roles.append(ModelData::IssuerRole);
         }
 
-        if (HarbourBase32::isValidBase32(secret)) {
-            const QByteArray bytes(HarbourBase32::fromBase32(secret));
-
-            if (entry->iToken.secret() != bytes) {
-                entry->iToken = entry->iToken.withSecret(bytes);
-                HDEBUG(aRow << "secret" << entry->iToken.secretBase32());
-                roles.append(ModelData::SecretRole);
-            }
+        if (!secret.isEmpty() && token.secret() != secret) {
+            builder.setSecret(secret);
+            HDEBUG(aRow << "secret" << aSecretBase32);
+            roles.append(ModelData::SecretRole);
         }
 
-        if (aDigits != entry->iToken.digits() &&
+        if (aDigits != token.digits() &&
             aDigits >= YubiKeyToken::MinDigits &&
             aDigits <= YubiKeyToken::MaxDigits) {
-            entry->iToken = entry->iToken.withDigits(aDigits);
+            builder.setDigits(aDigits);
             HDEBUG(aRow << "digits" << aDigits);
             roles.append(ModelData::DigitsRole);
         }
 
-        if (entry->iToken.counter() != aCounter) {
-            entry->iToken = entry->iToken.withCounter(aCounter);
+        if (token.counter() != aCounter) {
+            builder.setCounter(aCounter);
             HDEBUG(aRow << "counter" << aCounter);
             roles.append(ModelData::CounterRole);
         }
 
         if (!roles.isEmpty()) {
+            entry->setToken(builder.build());
             if (entry->iSelected) {
-                iPrivate->updateSelectedTokens();
-                Q_EMIT selectedTokensChanged();
+                iPrivate->selectionChanged(iPrivate->iSelectedCount);
             }
             const QModelIndex idx(index(aRow));
             Q_EMIT dataChanged(idx, idx, roles);
+            if (roles.contains(ModelData::LabelRole)) {
+                iPrivate->updateDuplicates();
+            }
         }
     }
 }
+
+#include "YubiKeyImportModel.moc"
@@ -41,6 +41,9 @@
 #include "YubiKeyToken.h"
 
 #include <QAbstractListModel>
+#include <QStringList>
+
+class YubiKey;
 
 class YubiKeyImportModel :
     public QAbstractListModel
@@ -48,20 +51,56 @@ class YubiKeyImportModel :
     Q_OBJECT
     Q_DISABLE_COPY(YubiKeyImportModel)
     Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+    Q_PROPERTY(YubiKey* yubiKey READ yubiKey WRITE setYubiKey NOTIFY yubiKeyChanged)
     Q_PROPERTY(QString otpUri READ otpUri WRITE setOtpUri NOTIFY otpUriChanged)
+    Q_PROPERTY(QStringList otpUris READ otpUris WRITE setOtpUris NOTIFY otpUrisChanged)
     Q_PROPERTY(QList<YubiKeyToken> selectedTokens READ selectedTokens NOTIFY selectedTokensChanged)
     Q_PROPERTY(bool haveSelectedTokens READ haveSelectedTokens NOTIFY haveSelectedTokensChanged)
+    Q_PROPERTY(int batchCount READ batchCount NOTIFY batchInfoChanged)
+    Q_PROPERTY(int missingBatchCount READ missingBatchCount NOTIFY batchInfoChanged)
+    Q_PROPERTY(QList<int> missingBatchIndices READ missingBatchIndices NOTIFY batchInfoChanged)
+    Q_PROPERTY(bool parsing READ parsing NOTIFY parsingChanged)
+    Q_PROPERTY(qreal progress READ progress NOTIFY progressChanged)
+    Q_ENUMS(Duplicate)
 
 public:
+    // Value of the duplicate role
+    enum Duplicate {
+        NotDuplicate,
+        DuplicateOnYubiKey,     // The name is already taken on the key
+        DuplicateInList         // Same name as one of the rows above
+    };
+
     YubiKeyImportModel(QObject* aParent = Q_NULLPTR);
     ~YubiKeyImportModel();
 
+    // Names of the credentials on this key are checked for collisions
+    YubiKey* yubiKey() const;
+    void setYubiKey(YubiKey*);
+
     QString otpUri() const;
     void setOtpUri(const QString);
 
+    QStringList otpUris() const;
+    void setOtpUris(const QStringList);
+
+    // Authenticator backup (a list of otpauth URIs or JSON), replaces
+    // the URIs. Accepts both local paths and file URLs.
+    Q_INVOKABLE void importFile(QString);
+
     QList<YubiKeyToken> selectedTokens() const;
     bool haveSelectedTokens() const;
 
+    // Multi-part otpauth-migration exports. The counts are summed over
+    // all exports (batch ids) seen so far, the indices are merged.
+    int batchCount() const;
+    int missingBatchCount() const;
+    QList<int> missingBatchIndices() const;
+
+    // URIs are parsed asynchronously
+    bool parsing() const;
+    qreal progress() const;
+
     Q_INVOKABLE QVariantMap getToken(int) const;
     Q_INVOKABLE void setToken(int, int, int, const QString, const QString, const QString, int, int);
 
@@ -74,13 +113,19 @@ public:
 
 Q_SIGNALS:
     void countChanged();
+    void yubiKeyChanged();
     void otpUriChanged();
+    void otpUrisChanged();
     void selectedTokensChanged();
     void haveSelectedTokensChanged();
+    void batchInfoChanged();
+    void parsingChanged();
+    void progressChanged();
+    void parsingFinished();
 
 private:
-    class OtpParameters;
     class ModelData;
+    class ParseTask;
     class Private;
     Private* iPrivate;
 };
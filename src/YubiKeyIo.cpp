@@ -53,6 +53,13 @@ YubiKeyIoTx::YubiKeyIoTx(
     QObject(aParent)
 {}
 
+// ==========================================================================
+// YubiKeyIoTxHandler
+// ==========================================================================
+
+YubiKeyIoTxHandler::~YubiKeyIoTxHandler()
+{}
+
 // ==========================================================================
 // YubiKeyIoTx::Result
 // ==========================================================================
@@ -142,10 +149,158 @@ YubiKeyIo::IoLockData::IoLockData() :
     ref(0)
 {}
 
+// ==========================================================================
+// YubiKeyIo::Header
+// ==========================================================================
+
+bool
+YubiKeyIo::Header::sameAs(
+    const Header& aHeader) const
+{
+    // Not comparing the data and Le
+    return cla == aHeader.cla &&
+        ins == aHeader.ins &&
+        p1 == aHeader.p1 &&
+        p2 == aHeader.p2;
+}
+
+// ==========================================================================
+// YubiKeyIo::APDU::Data
+// ==========================================================================
+
+YubiKeyIo::APDU::Data::Data() :
+    iSize(0)
+{}
+
+YubiKeyIo::APDU::Data::Data(
+    const Data& aData) :
+    iSize(aData.iSize),
+    iHeap(aData.iHeap)
+{
+    // Only copy what's actually used
+    if (iSize <= MaxInlineSize) {
+        memcpy(iInline, aData.iInline, iSize);
+    }
+}
+
+YubiKeyIo::APDU::Data::Data(
+    const char* aData,
+    int aSize) :
+    iSize(0)
+{
+    append(aData, aSize);
+}
+
+YubiKeyIo::APDU::Data::Data(
+    const QByteArray& aData) :
+    iSize(0)
+{
+    append(aData);
+}
+
+YubiKeyIo::APDU::Data&
+YubiKeyIo::APDU::Data::operator=(
+    const Data& aData)
+{
+    if (this != &aData) {
+        iSize = aData.iSize;
+        iHeap = aData.iHeap;
+        if (iSize <= MaxInlineSize) {
+            memcpy(iInline, aData.iInline, iSize);
+        }
+    }
+    return *this;
+}
+
+bool
+YubiKeyIo::APDU::Data::operator==(
+    const Data& aData) const
+{
+    return iSize == aData.iSize &&
+        !memcmp(constData(), aData.constData(), iSize);
+}
+
+int
+YubiKeyIo::APDU::Data::size() const
+{
+    return iSize;
+}
+
+bool
+YubiKeyIo::APDU::Data::isEmpty() const
+{
+    return !iSize;
+}
+
+const char*
+YubiKeyIo::APDU::Data::constData() const
+{
+    return (iSize > MaxInlineSize) ? iHeap.constData() : iInline;
+}
+
+QByteArray
+YubiKeyIo::APDU::Data::toHex() const
+{
+    return QByteArray::fromRawData(constData(), iSize).toHex();
+}
+
+void
+YubiKeyIo::APDU::Data::reserve(
+    int aSize)
+{
+    // Only extended length data needs to be pre-allocated
+    if (aSize > MaxInlineSize) {
+        iHeap.reserve(aSize);
+    }
+}
+
+void
+YubiKeyIo::APDU::Data::append(
+    char aByte)
+{
+    append(&aByte, 1);
+}
+
+void
+YubiKeyIo::APDU::Data::append(
+    const QByteArray& aData)
+{
+    append(aData.constData(), aData.size());
+}
+
+void
+YubiKeyIo::APDU::Data::append(
+    const char* aData,
+    int aSize)
+{
+    if (aSize > 0) {
+        const int newSize = iSize + aSize;
+
+        if (newSize <= MaxInlineSize) {
+            memcpy(iInline + iSize, aData, aSize);
+        } else {
+            if (iSize <= MaxInlineSize) {
+                // Switching to the heap storage
+                iHeap.reserve(newSize);
+                iHeap.append(iInline, iSize);
+            }
+            iHeap.append(aData, aSize);
+        }
+        iSize = newSize;
+    }
+}
+
 // ==========================================================================
 // YubiKeyIo::APDU
 // ==========================================================================
 
+YubiKeyIo::APDU::APDU(
+    const Header& aHeader,
+    uint aLe) :
+    Header(aHeader),
+    le(aLe)
+{}
+
 YubiKeyIo::APDU::APDU(
     const char* aName,
     uchar aCla,
@@ -153,11 +308,7 @@ YubiKeyIo::APDU::APDU(
     uchar aP1,
     uchar aP2,
     uint aLe) :
-    name(aName),
-    cla(aCla),
-    ins(aIns),
-    p1(aP1),
-    p2(aP2),
+    Header(aName, aCla, aIns, aP1, aP2),
     le(aLe)
 {}
 
@@ -170,11 +321,7 @@ YubiKeyIo::APDU::APDU(
     const uchar* aData,
     uint aSize,
     uint aLe) :
-    name(aName),
-    cla(aCla),
-    ins(aIns),
-    p1(aP1),
-    p2(aP2),
+    Header(aName, aCla, aIns, aP1, aP2),
     data((char*)aData, aSize),
     le(aLe)
 {}
@@ -187,11 +334,7 @@ YubiKeyIo::APDU::APDU(
     uchar aP2,
     const QByteArray& aData,
     uint aLe) :
-    name(aName),
-    cla(aCla),
-    ins(aIns),
-    p1(aP1),
-    p2(aP2),
+    Header(aName, aCla, aIns, aP1, aP2),
     data(aData),
     le(aLe)
 {}
@@ -206,17 +349,6 @@ YubiKeyIo::APDU::equals(
         data == aApdu.data;
 }
 
-bool
-YubiKeyIo::APDU::sameAs(
-    const APDU& aApdu) const
-{
-    // Not comparing the data and Le
-    return cla == aApdu.cla &&
-        ins == aApdu.ins &&
-        p1 == aApdu.p1 &&
-        p2 == aApdu.p2;
-}
-
 void
 YubiKeyIo::APDU::appendTLV(
     uchar aTag)
@@ -248,6 +380,220 @@ YubiKeyIo::APDU::appendTLV(
     data.append((const char*)aValue, aLength);
 }
 
+int
+YubiKeyIo::APDU::encodedSize() const
+{
+    const int n = data.size();
+
+    if (n <= 0xffff && le <= 0x10000) {
+        const bool extended = (n > 0xff || le > 0x100);
+
+        // Header, Lc + body, Le (see encode() below)
+        return 4 + (n ? ((extended ? 3 : 1) + n) : 0) +
+            (le ? (extended ? (n ? 2 : 3) : 1) : 0);
+    }
+    return 0;
+}
+
+int
+YubiKeyIo::APDU::encode(
+    uchar* aOut) const
+{
+    // Command APDU encoding options (ISO/IEC 7816-4):
+    //
+    // Case 1:  |CLA|INS|P1|P2|                                n = 4
+    // Case 2s: |CLA|INS|P1|P2|LE|                             n = 5
+    // Case 3s: |CLA|INS|P1|P2|LC|...BODY...|                  n = 6..260
+    // Case 4s: |CLA|INS|P1|P2|LC|...BODY...|LE|               n = 7..261
+    // Case 2e: |CLA|INS|P1|P2|00|LE1|LE2|                     n = 7
+    // Case 3e: |CLA|INS|P1|P2|00|LC1|LC2|...BODY...|          n = 8..65542
+    // Case 4e: |CLA|INS|P1|P2|00|LC1|LC2|...BODY...|LE1|LE2|  n = 10..65544
+    //
+    // LE, LE1, LE2 may be 0x00, 0x00|0x00 (means the maximum, 256 or 65536)
+    // LC must not be 0x00 and LC1|LC2 must not be 0x00|0x00
+    //
+    // The output buffer must be at least encodedSize() bytes long.
+    // Returns the number of bytes written, zero if the APDU can't be
+    // encoded.
+
+    const int n = data.size();
+    uchar* ptr = aOut;
+
+    if (n <= 0xffff && le <= 0x10000) {
+        *ptr++ = cla;
+        *ptr++ = ins;
+        *ptr++ = p1;
+        *ptr++ = p2;
+        if (n > 0) {
+            if (n <= 0xff && le <= 0x100) {
+                /* Cases 3s and 4s */
+                *ptr++ = (uchar) n;
+            } else {
+                /* Cases 3e and 4e */
+                *ptr++ = 0;
+                *ptr++ = (uchar) (n >> 8);
+                *ptr++ = (uchar) n;
+            }
+            memcpy(ptr, data.constData(), n);
+            ptr += n;
+        }
+        if (le > 0) {
+            if (le <= 0x100 && n <= 0xff) {
+                /* Cases 2s and 4s */
+                *ptr++ = (le == 0x100) ? 0 : ((uchar) le);
+            } else {
+                /* Cases 4e and 2e */
+                if (!n) {
+                    /* Case 2e */
+                    *ptr++ = 0;
+                }
+                if (le == 0x10000) {
+                    *ptr++ = 0;
+                    *ptr++ = 0;
+                } else {
+                    *ptr++ = (uchar) (le >> 8);
+                    *ptr++ = (uchar) le;
+                }
+            }
+        }
+    }
+    return ptr - aOut;
+}
+
+// ==========================================================================
+// YubiKeyIo::Tx
+//
+// Adapts the lightweight ioSubmit() interface to the signal based one
+// ==========================================================================
+
+class YubiKeyIo::Tx :
+    public YubiKeyIoTx,
+    public YubiKeyIoTxHandler
+{
+public:
+    Tx(YubiKeyIo*);
+    ~Tx() Q_DECL_OVERRIDE;
+
+    YubiKeyIo* io() const;
+    bool complete(TxId, TxState);
+
+    // YubiKeyIoTx
+    TxState txState() const Q_DECL_OVERRIDE;
+    void txSetAutoDelete(bool) Q_DECL_OVERRIDE;
+    void txCancel() Q_DECL_OVERRIDE;
+
+    // YubiKeyIoTxHandler
+    void ioTxCancelled(TxId) Q_DECL_OVERRIDE;
+    void ioTxFailed(TxId) Q_DECL_OVERRIDE;
+    void ioTxFinished(TxId, Result, const QByteArray&) Q_DECL_OVERRIDE;
+
+public:
+    TxId iId;
+    TxState iState;
+    bool iAutoDelete;
+};
+
+YubiKeyIo::Tx::Tx(
+    YubiKeyIo* aIo) :
+    YubiKeyIoTx(aIo),
+    iId(0),
+    iState(TxPending),
+    iAutoDelete(false)
+{}
+
+YubiKeyIo::Tx::~Tx()
+{
+    if (iState == TxPending && iId) {
+        // If the parent is being deleted, io() return NULL
+        YubiKeyIo* owner = io();
+
+        if (owner) {
+            owner->ioRelease(iId);
+        }
+    }
+}
+
+inline
+YubiKeyIo*
+YubiKeyIo::Tx::io() const
+{
+    return qobject_cast<YubiKeyIo*>(parent());
+}
+
+bool
+YubiKeyIo::Tx::complete(
+    TxId aId,
+    TxState aState)
+{
+    if (iState == TxPending && iId == aId) {
+        iState = aState;
+        if (iAutoDelete) {
+            HarbourUtil::scheduleDeleteLater(this);
+        }
+        return true;
+    }
+    return false;
+}
+
+YubiKeyIoTx::TxState
+YubiKeyIo::Tx::txState() const
+{
+    return iState;
+}
+
+void
+YubiKeyIo::Tx::txSetAutoDelete(
+    bool aAutoDelete)
+{
+    if (iAutoDelete != aAutoDelete) {
+        iAutoDelete = aAutoDelete;
+        if (aAutoDelete && iState != TxPending) {
+            HarbourUtil::scheduleDeleteLater(this);
+        }
+    }
+}
+
+void
+YubiKeyIo::Tx::txCancel()
+{
+    if (iState == TxPending) {
+        YubiKeyIo* owner = io();
+
+        if (owner) {
+            owner->ioCancel(iId);
+        }
+    }
+}
+
+void
+YubiKeyIo::Tx::ioTxCancelled(
+    TxId aId)
+{
+    if (complete(aId, TxCancelled)) {
+        Q_EMIT txCancelled();
+    }
+}
+
+void
+YubiKeyIo::Tx::ioTxFailed(
+    TxId aId)
+{
+    if (complete(aId, TxFailed)) {
+        Q_EMIT txFailed();
+    }
+}
+
+void
+YubiKeyIo::Tx::ioTxFinished(
+    TxId aId,
+    Result aResult,
+    const QByteArray& aData)
+{
+    if (complete(aId, TxFinished)) {
+        Q_EMIT txFinished(aResult, aData);
+    }
+}
+
 // ==========================================================================
 // YubiKeyIo
 // ==========================================================================
@@ -257,6 +603,37 @@ YubiKeyIo::YubiKeyIo(
     QObject(aParent)
 {}
 
+/* static */
+YubiKeyIo::TxId
+YubiKeyIo::nextTxId()
+{
+    // Ids are unique across all YubiKeyIo instances (which all live
+    // on the same thread) so that a stale id can't match a transaction
+    // submitted to a different YubiKeyIo.
+    static TxId lastId = 0;
+
+    if (!++lastId) {
+        // Zero is not a valid id
+        lastId++;
+    }
+    return lastId;
+}
+
+YubiKeyIoTx*
+YubiKeyIo::ioTransmit(
+    const APDU& aApdu)
+{
+    Tx* tx = new Tx(this);
+
+    if ((tx->iId = ioSubmit(aApdu, tx)) != 0) {
+        return tx;
+    } else {
+        tx->iState = YubiKeyIoTx::TxFailed;
+        delete tx;
+        return Q_NULLPTR;
+    }
+}
+
 bool
 YubiKeyIo::canTransmit() const
 {
@@ -48,6 +48,7 @@
 #include <QtCore/QObject>
 
 class YubiKeyIoTx;
+class YubiKeyIoTxHandler;
 
 // The idea of YubiKeyIo is to abstract the specific I/O mechanism from
 // the rest of the application (i.e. USB vs NFC)
@@ -148,49 +149,118 @@ public:
     };
     typedef QExplicitlySharedDataPointer<IoLockData> IoLock;
 
-    // ISO/IEC 7816-4 compliant APDU
-    struct APDU {
+    // ISO/IEC 7816-4 command header. Can be used for compile-time
+    // constants, i.e. without any runtime initialization.
+    struct Header {
         const char* name;
         uchar cla;
         uchar ins;
         uchar p1;
         uchar p2;
-        QByteArray data;
+
+        Q_DECL_CONSTEXPR Header(const char* aName, uchar aCla, uchar aIns,
+            uchar aP1 = 0, uchar aP2 = 0) : name(aName), cla(aCla),
+            ins(aIns), p1(aP1), p2(aP2) {}
+        bool sameAs(const Header&) const;
+    };
+
+    // ISO/IEC 7816-4 compliant APDU
+    struct APDU : public Header {
+
+        // Command data. Anything that fits into a short APDU is stored
+        // inline, only extended length data ends up on the heap.
+        class Data {
+        public:
+            enum { MaxInlineSize = 0xff };
+
+            Data();
+            Data(const Data&);
+            Data(const char*, int);
+            Data(const QByteArray&);
+
+            Data& operator=(const Data&);
+            bool operator==(const Data&) const;
+
+            int size() const;
+            bool isEmpty() const;
+            const char* constData() const;
+            QByteArray toHex() const;
+            void reserve(int);
+            void append(char);
+            void append(const char*, int);
+            void append(const QByteArray&);
+
+        private:
+            int iSize;
+            QByteArray iHeap; // Empty unless iSize > MaxInlineSize
+            char iInline[MaxInlineSize];
+        };
+
+        Data data;
         uint le;
 
+        APDU(const Header&, uint aLe = 0);
         APDU(const char*, uchar, uchar, uchar aP1 = 0, uchar aP2 = 0, uint aLe = 0);
         APDU(const char*, uchar, uchar, uchar, uchar, const uchar*, uint, uint aLe = 0);
         APDU(const char*, uchar, uchar, uchar, uchar, const QByteArray&, uint aLe = 0);
         bool equals(const APDU&) const;
-        bool sameAs(const APDU&) const;
         void appendTLV(uchar);
         void appendTLV(uchar, uchar, const void*);
         void appendTLV(uchar, const QByteArray&);
+        int encodedSize() const;
+        int encode(uchar*) const;
     };
 
+    // Transaction id, zero is never a valid one
+    typedef quint32 TxId;
+
     // Interface
     virtual const char* ioPath() const = 0;
     virtual Transport ioTransport() const = 0;
     virtual IoState ioState() const = 0;
     virtual uint ioSerial() const = 0;
     virtual IoLock ioLock() = 0;
-    virtual YubiKeyIoTx* ioTransmit(const APDU&) = 0;
+
+    // Lightweight transmit interface. The handler gets invoked directly
+    // (rather than through the signals) when the transaction completes,
+    // and only if the transaction hasn't been released by the caller.
+    // Completion records are pooled by the implementation. ioSubmit()
+    // returns zero if the transaction couldn't be submitted.
+    //
+    // ioCancel() requests cancellation of the transaction. If it gets
+    // cancelled, the handler is notified later, never from within the
+    // ioCancel() call. Some transports don't support cancellation at all.
+    //
+    // ioRelease() detaches the handler from the transaction and cancels
+    // it if possible. Must be invoked if the handler is deallocated before
+    // the transaction completes.
+    virtual TxId ioSubmit(const APDU&, YubiKeyIoTxHandler*) = 0;
+    virtual void ioCancel(TxId) = 0;
+    virtual void ioRelease(TxId) = 0;
+
+    // QObject based transmit interface (built on top of ioSubmit)
+    YubiKeyIoTx* ioTransmit(const APDU&);
 
     // Utilities
     bool canTransmit() const;
     bool yubiKeyPresent() const;
     static bool isTerminalState(IoState);
 
+protected:
+    static TxId nextTxId();
+
 Q_SIGNALS:
     void ioStateChanged(YubiKeyIo::IoState /* previous state */);
     void ioSerialChanged();
+
+private:
+    class Tx;
 };
 
 Q_DECLARE_METATYPE(YubiKeyIo::IoState)
 
-// YubiKeyIo implementation derives its own class from YubiKeyIoTx and
-// returns a new instance of from each YubiKeyIo::ioTransmit() call
-// which successully submits the transaction.
+// YubiKeyIo returns a new instance of YubiKeyIoTx from each ioTransmit()
+// call which successully submits the transaction.
 //
 // By default, the caller of YubiKeyIo::transmit() is responsible for
 // deleting the YubiKeyTx object when it's no longer needed. If that's
@@ -246,6 +316,19 @@ protected:
     YubiKeyIoTx(QObject*);
 };
 
+// Receives completion notifications for the transactions submitted with
+// YubiKeyIo::ioSubmit(). Exactly one of these gets invoked per transaction
+// (unless the transaction gets released).
+
+class YubiKeyIoTxHandler
+{
+public:
+    virtual ~YubiKeyIoTxHandler();
+    virtual void ioTxCancelled(YubiKeyIo::TxId) = 0;
+    virtual void ioTxFailed(YubiKeyIo::TxId) = 0;
+    virtual void ioTxFinished(YubiKeyIo::TxId, YubiKeyIoTx::Result, const QByteArray&) = 0;
+};
+
 QDebug operator<<(QDebug, const YubiKeyIoTx::Result&);
 QDebug operator<<(QDebug aDebug, const YubiKeyIo::IoState&);
 Q_DECLARE_METATYPE(YubiKeyIoTx::Result)
@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "YubiKeyMigrationPayload.h"
+
+#include "HarbourDebug.h"
+
+#include <limits.h>
+#include <string.h>
+
+// ==========================================================================
+// YubiKeyMigrationPayload::OtpParameters
+// ==========================================================================
+
+YubiKeyMigrationPayload::OtpParameters::OtpParameters()
+{
+    clear();
+}
+
+void
+YubiKeyMigrationPayload::OtpParameters::clear()
+{
+    memset(&iSecret, 0, sizeof(iSecret));
+    memset(&iName, 0, sizeof(iName));
+    memset(&iIssuer, 0, sizeof(iIssuer));
+    iAlgorithm = ALGORITHM_SHA1;
+    iDigits = DIGIT_COUNT_SIX;
+    iType = OTP_TYPE_TOTP;
+    iCounter = 0;
+}
+
+bool
+YubiKeyMigrationPayload::OtpParameters::isValid() const
+{
+    return iSecret.size > 0 &&
+        (iAlgorithm == ALGORITHM_SHA1 || iAlgorithm == ALGORITHM_SHA256 ||
+         iAlgorithm == ALGORITHM_SHA512) &&
+        (iDigits == DIGIT_COUNT_SIX || iDigits == DIGIT_COUNT_EIGHT) &&
+        (iType == OTP_TYPE_TOTP || iType == OTP_TYPE_HOTP);
+}
+
+int
+YubiKeyMigrationPayload::OtpParameters::numDigits() const
+{
+    switch (iDigits) {
+    case DIGIT_COUNT_UNSPECIFIED: break;
+    case DIGIT_COUNT_SIX: return 6;
+    case DIGIT_COUNT_EIGHT: return 8;
+    }
+    return 0;
+}
+
+int
+YubiKeyMigrationPayload::OtpParameters::counter() const
+{
+    return (int) qMin(iCounter, (quint64) INT_MAX);
+}
+
+YubiKeyAlgorithm
+YubiKeyMigrationPayload::OtpParameters::yubiKeyAlgorithm() const
+{
+    switch (iAlgorithm) {
+    case ALGORITHM_MD5: break; // Not supported
+    case ALGORITHM_UNSPECIFIED: break;
+    case ALGORITHM_SHA1: return YubiKeyAlgorithm_HMAC_SHA1;
+    case ALGORITHM_SHA256: return YubiKeyAlgorithm_HMAC_SHA256;
+    case ALGORITHM_SHA512:  return YubiKeyAlgorithm_HMAC_SHA512;
+    }
+    return YubiKeyAlgorithm_Unknown;
+}
+
+YubiKeyTokenType
+YubiKeyMigrationPayload::OtpParameters::yubiKeyTokenType() const
+{
+    switch (iType) {
+    case OTP_TYPE_UNSPECIFIED: break;
+    case OTP_TYPE_HOTP: return YubiKeyTokenType_HOTP;
+    case OTP_TYPE_TOTP: return YubiKeyTokenType_TOTP;
+    }
+    return YubiKeyTokenType_Unknown;
+}
+
+/* static */
+bool
+YubiKeyMigrationPayload::OtpParameters::readVarInt(
+    GUtilRange* aPos,
+    quint64* aValue)
+{
+    // At most 10 bytes, the last one may only contribute a single bit
+    const guint8* ptr = aPos->ptr;
+    quint64 value = 0;
+
+    for (int shift = 0; shift < 64 && ptr < aPos->end; shift += 7) {
+        const guint8 b = *ptr++;
+
+        if (shift == 63 && (b & 0xfe)) {
+            // Doesn't fit into 64 bits
+            return false;
+        }
+        value |= ((quint64)(b & 0x7f)) << shift;
+        if (!(b & 0x80)) {
+            aPos->ptr = ptr;
+            *aValue = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* static */
+bool
+YubiKeyMigrationPayload::OtpParameters::readDelimited(
+    GUtilRange* aPos,
+    GUtilData* aData)
+{
+    GUtilRange pos = *aPos;
+    quint64 len;
+
+    if (readVarInt(&pos, &len) && len <= (quint64)(pos.end - pos.ptr)) {
+        aData->bytes = pos.ptr;
+        aData->size = (gsize) len;
+        aPos->ptr = pos.ptr + len;
+        return true;
+    }
+    return false;
+}
+
+/* static */
+bool
+YubiKeyMigrationPayload::OtpParameters::skipValue(
+    GUtilRange* aPos,
+    quint64 aTag)
+{
+    quint64 value;
+    GUtilData data;
+    gsize size;
+
+    switch (aTag & WIRE_TYPE_MASK) {
+    case WIRE_VARINT:
+        return readVarInt(aPos, &value);
+    case WIRE_DELIMITED:
+        return readDelimited(aPos, &data);
+    case WIRE_FIXED64:
+        size = 8;
+        break;
+    case WIRE_FIXED32:
+        size = 4;
+        break;
+    default:
+        // Groups are deprecated, the rest is garbage
+        return false;
+    }
+
+    if ((gsize)(aPos->end - aPos->ptr) >= size) {
+        aPos->ptr += size;
+        return true;
+    }
+    return false;
+}
+
+bool
+YubiKeyMigrationPayload::OtpParameters::parse(
+    const GUtilData* aMessage)
+{
+    GUtilRange pos;
+    quint64 tag, value;
+
+    clear();
+    pos.end = (pos.ptr = aMessage->bytes) + aMessage->size;
+    while (pos.ptr < pos.end) {
+        if (!readVarInt(&pos, &tag) || !(tag >> WIRE_TYPE_SHIFT)) {
+            return false;
+        }
+
+        switch (tag) {
+        case SECRET_TAG:
+            if (!readDelimited(&pos, &iSecret)) {
+                return false;
+            }
+            break;
+        case NAME_TAG:
+            if (!readDelimited(&pos, &iName)) {
+                return false;
+            }
+            break;
+        case ISSUER_TAG:
+            if (!readDelimited(&pos, &iIssuer)) {
+                return false;
+            }
+            break;
+        case ALGORITHM_TAG:
+        case DIGITS_TAG:
+        case TYPE_TAG:
+        case COUNTER_TAG:
+            if (!readVarInt(&pos, &value)) {
+                return false;
+            }
+            switch (tag) {
+            // Unknown enum values fail the isValid() check
+            case ALGORITHM_TAG:
+                iAlgorithm = (value <= ALGORITHM_MD5) ?
+                    (Algorithm) value : ALGORITHM_UNSPECIFIED;
+                break;
+            case DIGITS_TAG:
+                iDigits = (value <= DIGIT_COUNT_EIGHT) ?
+                    (DigitCount) value : DIGIT_COUNT_UNSPECIFIED;
+                break;
+            case TYPE_TAG:
+                iType = (value <= OTP_TYPE_TOTP) ?
+                    (OtpType) value : OTP_TYPE_UNSPECIFIED;
+                break;
+            case COUNTER_TAG:
+                iCounter = value;
+                break;
+            }
+            break;
+        default:
+            // Skip unknown fields
+            if (!skipValue(&pos, tag)) {
+                return false;
+            }
+            break;
+        }
+    }
+    return isValid();
+}
+
+// ==========================================================================
+// YubiKeyMigrationPayload
+// ==========================================================================
+
+YubiKeyMigrationPayload::YubiKeyMigrationPayload() :
+    iComplete(false),
+    iVersion(0),
+    iBatchSize(1),
+    iBatchIndex(0),
+    iBatchId(0)
+{
+}
+
+/* static */
+inline
+int
+YubiKeyMigrationPayload::toInt32(
+    quint64 aValue)
+{
+    // Negative int32 values are sign-extended to 64 bits
+    return (int)(qint32)aValue;
+}
+
+bool
+YubiKeyMigrationPayload::hasValidBatch() const
+{
+    return iComplete && iBatchSize > 0 &&
+        iBatchIndex >= 0 && iBatchIndex < iBatchSize;
+}
+
+bool
+YubiKeyMigrationPayload::parse(
+    gconstpointer aData,
+    gsize aSize)
+{
+    GUtilRange pos;
+    GUtilData message;
+    quint64 tag, value;
+    OtpParameters otp;
+
+    iComplete = false;
+    pos.end = (pos.ptr = (const guint8*) aData) + aSize;
+    while (pos.ptr < pos.end) {
+        if (!OtpParameters::readVarInt(&pos, &tag) ||
+            !(tag >> OtpParameters::WIRE_TYPE_SHIFT)) {
+            HDEBUG("Garbage at" << (pos.end - pos.ptr) << "bytes from end");
+            return false;
+        }
+
+        if (tag == OtpParameters::OTP_PARAMETERS_TAG) {
+            if (!OtpParameters::readDelimited(&pos, &message)) {
+                HDEBUG("Truncated OtpParameters");
+                return false;
+            }
+            // A broken entry doesn't invalidate its neighbours
+            if (otp.parse(&message)) {
+                iOtpParameters.append(otp);
+            } else {
+                HDEBUG("Skipping invalid OtpParameters");
+            }
+        } else if ((tag & OtpParameters::WIRE_TYPE_MASK) ==
+            OtpParameters::WIRE_VARINT) {
+            if (!OtpParameters::readVarInt(&pos, &value)) {
+                return false;
+            }
+            switch (tag) {
+            case OtpParameters::VERSION_TAG:
+                iVersion = toInt32(value);
+                break;
+            case OtpParameters::BATCH_SIZE_TAG:
+                iBatchSize = toInt32(value);
+                break;
+            case OtpParameters::BATCH_INDEX_TAG:
+                iBatchIndex = toInt32(value);
+                break;
+            case OtpParameters::BATCH_ID_TAG:
+                iBatchId = toInt32(value);
+                break;
+            }
+        } else if (!OtpParameters::skipValue(&pos, tag)) {
+            return false;
+        }
+    }
+    iComplete = true;
+    return true;
+}
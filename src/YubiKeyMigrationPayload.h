@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef _YUBIKEY_MIGRATION_PAYLOAD_H
+#define _YUBIKEY_MIGRATION_PAYLOAD_H
+
+#include "YubiKeyTypes.h"
+
+#include <gutil_types.h>
+
+#include <QtCore/QVector>
+
+// Single pass over the otpauth-migration payload:
+//
+// message MigrationPayload {
+// enum Algorithm {
+//   ALGORITHM_UNSPECIFIED = 0;
+//   ALGORITHM_SHA1 = 1;
+//   ALGORITHM_SHA256 = 2;
+//   ALGORITHM_SHA512 = 3;
+//   ALGORITHM_MD5 = 4;  really???
+// }
+//
+// enum DigitCount {
+//   DIGIT_COUNT_UNSPECIFIED = 0;
+//   DIGIT_COUNT_SIX = 1;
+//   DIGIT_COUNT_EIGHT = 2;
+// }
+//
+// enum OtpType {
+//   OTP_TYPE_UNSPECIFIED = 0;
+//   OTP_TYPE_HOTP = 1;
+//   OTP_TYPE_TOTP = 2;
+// }
+//
+// message OtpParameters {
+//   bytes secret = 1;
+//   string name = 2;
+//   string issuer = 3;
+//   Algorithm algorithm = 4;
+//   DigitCount digits = 5;
+//   OtpType type = 6;
+//   int64 counter = 7;
+// }
+//
+// repeated OtpParameters otp_parameters = 1;
+// int32 version = 2;
+// int32 batch_size = 3;
+// int32 batch_index = 4;
+// int32 batch_id = 5;
+// }
+//
+// Every length and varint is checked against the end of the buffer.
+// The parsed OtpParameters reference the buffer, which must stay alive
+// while they are in use.
+
+class YubiKeyMigrationPayload
+{
+public:
+    class OtpParameters
+    {
+    public:
+        enum Algorithm {
+            ALGORITHM_UNSPECIFIED,
+            ALGORITHM_SHA1,
+            ALGORITHM_SHA256,
+            ALGORITHM_SHA512,
+            ALGORITHM_MD5
+        };
+
+        enum DigitCount {
+            DIGIT_COUNT_UNSPECIFIED,
+            DIGIT_COUNT_SIX,
+            DIGIT_COUNT_EIGHT,
+        };
+
+        enum OtpType {
+            OTP_TYPE_UNSPECIFIED,
+            OTP_TYPE_HOTP,
+            OTP_TYPE_TOTP
+        };
+
+        // Protobuf wire types
+        enum WireType {
+            WIRE_VARINT = 0,
+            WIRE_FIXED64 = 1,
+            WIRE_DELIMITED = 2,
+            WIRE_FIXED32 = 5
+        };
+
+        static const int WIRE_TYPE_SHIFT = 3;
+        static const int WIRE_TYPE_MASK = 0x07;
+
+#define DELIMITED_TAG(x) (((x) << WIRE_TYPE_SHIFT) | WIRE_DELIMITED)
+#define VARINT_TAG(x) (((x) << WIRE_TYPE_SHIFT) | WIRE_VARINT)
+
+        static const uchar OTP_PARAMETERS_TAG = DELIMITED_TAG(1);
+        static const uchar SECRET_TAG = DELIMITED_TAG(1);
+        static const uchar NAME_TAG = DELIMITED_TAG(2);
+        static const uchar ISSUER_TAG = DELIMITED_TAG(3);
+        static const uchar ALGORITHM_TAG = VARINT_TAG(4);
+        static const uchar DIGITS_TAG = VARINT_TAG(5);
+        static const uchar TYPE_TAG = VARINT_TAG(6);
+        static const uchar COUNTER_TAG = VARINT_TAG(7);
+
+        static const uchar VERSION_TAG = VARINT_TAG(2);
+        static const uchar BATCH_SIZE_TAG = VARINT_TAG(3);
+        static const uchar BATCH_INDEX_TAG = VARINT_TAG(4);
+        static const uchar BATCH_ID_TAG = VARINT_TAG(5);
+
+#undef DELIMITED_TAG
+#undef VARINT_TAG
+
+        static const uchar VERSION = 1;
+
+    public:
+        OtpParameters();
+
+        bool parse(const GUtilData*);
+        void clear();
+        bool isValid() const;
+        int numDigits() const;
+        int counter() const;
+        YubiKeyAlgorithm yubiKeyAlgorithm() const;
+        YubiKeyTokenType yubiKeyTokenType() const;
+
+        static bool readVarInt(GUtilRange*, quint64*);
+        static bool readDelimited(GUtilRange*, GUtilData*);
+        static bool skipValue(GUtilRange*, quint64);
+
+    public:
+        // These point into the payload, nothing is copied until the
+        // token gets created
+        GUtilData iSecret;
+        GUtilData iName;
+        GUtilData iIssuer;
+        Algorithm iAlgorithm;
+        DigitCount iDigits;
+        OtpType iType;
+        quint64 iCounter;
+    };
+
+public:
+    YubiKeyMigrationPayload();
+
+    bool parse(gconstpointer, gsize);
+    bool hasValidBatch() const;
+
+    static int toInt32(quint64);
+
+public:
+    QVector<OtpParameters> iOtpParameters;
+    bool iComplete;
+    int iVersion;
+    int iBatchSize;
+    int iBatchIndex;
+    int iBatchId;
+};
+
+#endif // _YUBIKEY_MIGRATION_PAYLOAD_H
@@ -46,7 +46,6 @@
 #include "YubiKeyNfcIo.h"
 
 #include "HarbourDebug.h"
-#include "HarbourUtil.h"
 
 // ==========================================================================
 // YubiKeyNfcIo::Lock declaration
@@ -68,6 +67,46 @@ public:
     NfcTagClientLock* iNfcLock;
 };
 
+// ==========================================================================
+// YubiKeyNfcIo::TxRecord
+//
+// Pooled completion record. Cancelled records get a fresh GCancellable
+// when they are reused.
+// ==========================================================================
+
+class YubiKeyNfcIo::TxRecord
+{
+public:
+    TxRecord() :
+        iNext(Q_NULLPTR),
+        iOwner(Q_NULLPTR),
+        iHandler(Q_NULLPTR),
+        iCancel(Q_NULLPTR),
+        iId(0)
+    {}
+
+    ~TxRecord()
+    {
+        if (iCancel) {
+            g_object_unref(iCancel);
+        }
+    }
+
+    void cancel()
+    {
+        g_cancellable_cancel(iCancel);
+        g_object_unref(iCancel);
+        iCancel = Q_NULLPTR;
+    }
+
+public:
+    TxRecord* iNext;
+    Private* iOwner;
+    YubiKeyIoTxHandler* iHandler;
+    GCancellable* iCancel;
+    TxId iId;
+};
+
 // ==========================================================================
 // YubiKeyNfcIo::Private
 // ==========================================================================
@@ -85,17 +124,27 @@ public:
     static void lockResponse(NfcTagClient*, NfcTagClientLock*, const GError*, void*);
     static void tagEvent(NfcTagClient*, NFC_TAG_PROPERTY, void*);
     static void isoDepValidEvent(NfcIsoDepClient*, NFC_ISODEP_PROPERTY, void*);
+    static void txResponse(NfcIsoDepClient*, const GUtilData*, guint, const GError*, void*);
 
     void setState(IoState);
     void emitQueuedSignals();
 
     IoLock requestLock();
 
+    TxId submit(const APDU&, YubiKeyIoTxHandler*);
+    static TxRecord* takeTx(TxRecord**, TxId);
+    TxRecord* takeTx(TxId);
+    void queueCancelledTx(TxRecord*);
+    void recycleTx(TxRecord*);
+
     void handleLockResponse(NfcTagClientLock*, const GError*);
     bool checkIsoDepHB();
     void updateTagState();
     bool updateSerial();
 
+public Q_SLOTS:
+    void onTxCancelled();
+
 public:
     IoState iState;
     IoState iPrevState;
@@ -107,6 +156,9 @@ public:
     NfcIsoDepClient* iIsoDep;
     gulong iIsoDepValidId;
     Lock* iLock;
+    TxRecord* iFreeTx;
+    TxRecord* iPendingTx;
+    TxRecord* iCancelledTx;
     int iActiveTx;
 };
 
@@ -125,6 +177,9 @@ YubiKeyNfcIo::Private::Private(
     iIsoDep(Q_NULLPTR),
     iIsoDepValidId(0),
     iLock(Q_NULLPTR),
+    iFreeTx(Q_NULLPTR),
+    iPendingTx(Q_NULLPTR),
+    iCancelledTx(Q_NULLPTR),
     iActiveTx(0)
 {
     updateTagState();
@@ -136,6 +191,27 @@ YubiKeyNfcIo::Private::~Private()
         iLock->iPrivate = Q_NULLPTR;
     }
     g_cancellable_cancel(iCancel);
+    while (iPendingTx) {
+        TxRecord* tx = iPendingTx;
+
+        // Cancelled transactions don't complete
+        iPendingTx = tx->iNext;
+        tx->cancel();
+        delete tx;
+    }
+    while (iCancelledTx) {
+        TxRecord* tx = iCancelledTx;
+
+        // Nobody is going to be notified anymore
+        iCancelledTx = tx->iNext;
+        delete tx;
+    }
+    while (iFreeTx) {
+        TxRecord* tx = iFreeTx;
+
+        iFreeTx = tx->iNext;
+        delete tx;
+    }
     nfc_isodep_client_remove_handler(iIsoDep, iIsoDepValidId);
     nfc_isodep_client_unref(iIsoDep);
     nfc_tag_client_remove_handler(iTag, iTagEventId);
@@ -216,6 +292,169 @@ YubiKeyNfcIo::Private::requestLock()
     return IoLock(iLock);
 }
 
+YubiKeyIo::TxId
+YubiKeyNfcIo::Private::submit(
+    const APDU& aApdu,
+    YubiKeyIoTxHandler* aHandler)
+{
+    if (iIsoDep) {
+        TxRecord* tx = iFreeTx;
+        NfcIsoDepApdu apdu;
+
+        if (tx) {
+            iFreeTx = tx->iNext;
+        } else {
+            tx = new TxRecord;
+        }
+        if (!tx->iCancel) {
+            tx->iCancel = g_cancellable_new();
+        }
+
+        memset(&apdu, 0, sizeof(apdu));
+        apdu.cla = aApdu.cla;
+        apdu.ins = aApdu.ins;
+        apdu.p1 = aApdu.p1;
+        apdu.p2 = aApdu.p2;
+        apdu.data.bytes = (guint8*) aApdu.data.constData();
+        apdu.data.size = aApdu.data.size();
+        apdu.le = aApdu.le;
+
+        if (nfc_isodep_client_transmit(iIsoDep, &apdu, tx->iCancel,
+            txResponse, tx, Q_NULLPTR)) {
+            HDEBUG(aApdu.name << hex << aApdu.cla << aApdu.ins <<
+                aApdu.p1 << aApdu.p2 << aApdu.data.toHex().constData());
+            tx->iOwner = this;
+            tx->iHandler = aHandler;
+            tx->iId = nextTxId();
+            tx->iNext = iPendingTx;
+            iPendingTx = tx;
+            iActiveTx++;
+            setState(IoActive);
+            return tx->iId;
+        }
+
+        tx->iNext = iFreeTx;
+        iFreeTx = tx;
+    }
+    return 0;
+}
+
+/* static */
+YubiKeyNfcIo::TxRecord*
+YubiKeyNfcIo::Private::takeTx(
+    TxRecord** aList,
+    TxId aId)
+{
+    if (aId) {
+        TxRecord** ptr = aList;
+
+        while (*ptr) {
+            TxRecord* tx = *ptr;
+
+            if (tx->iId == aId) {
+                *ptr = tx->iNext;
+                tx->iNext = Q_NULLPTR;
+                return tx;
+            }
+            ptr = &tx->iNext;
+        }
+    }
+    return Q_NULLPTR;
+}
+
+YubiKeyNfcIo::TxRecord*
+YubiKeyNfcIo::Private::takeTx(
+    TxId aId)
+{
+    return takeTx(&iPendingTx, aId);
+}
+
+void
+YubiKeyNfcIo::Private::queueCancelledTx(
+    TxRecord* aTx)
+{
+    // The record remains active until the handler gets notified
+    // from the event loop, or until the transaction gets released.
+    TxRecord** ptr = &iCancelledTx;
+
+    while (*ptr) {
+        ptr = &(*ptr)->iNext;
+    }
+    *ptr = aTx;
+    if (aTx == iCancelledTx) {
+        QMetaObject::invokeMethod(this, "onTxCancelled", Qt::QueuedConnection);
+    }
+}
+
+void
+YubiKeyNfcIo::Private::onTxCancelled()
+{
+    while (iCancelledTx) {
+        TxRecord* tx = iCancelledTx;
+        YubiKeyIoTxHandler* handler = tx->iHandler;
+        const TxId id = tx->iId;
+
+        iCancelledTx = tx->iNext;
+        tx->iNext = Q_NULLPTR;
+        recycleTx(tx);
+        handler->ioTxCancelled(id);
+    }
+    emitQueuedSignals();
+}
+
+void
+YubiKeyNfcIo::Private::recycleTx(
+    TxRecord* aTx)
+{
+    // The record must have already been removed from the pending list
+    aTx->iOwner = Q_NULLPTR;
+    aTx->iHandler = Q_NULLPTR;
+    aTx->iId = 0;
+    aTx->iNext = iFreeTx;
+    iFreeTx = aTx;
+
+    HASSERT(iActiveTx > 0);
+    iActiveTx--;
+    if (!iActiveTx && iState == IoActive) {
+        setState(iLock ? IoLocked : IoReady);
+    }
+}
+
+/* static */
+void
+YubiKeyNfcIo::Private::txResponse(
+    NfcIsoDepClient*,
+    const GUtilData* aResp,
+    guint aSw,
+    const GError* aError,
+    void* aTx)
+{
+    TxRecord* tx = (TxRecord*) aTx;
+    Private* self = tx->iOwner;
+    YubiKeyIoTxHandler* handler = tx->iHandler;
+    const TxId id = tx->iId;
+
+    // Cancelled (and released) transactions don't complete, i.e. the
+    // record is still pending and the handler is still there.
+    self->takeTx(id);
+    self->recycleTx(tx);
+    if (aError) {
+        handler->ioTxFailed(id);
+    } else {
+        YubiKeyIoTx::Result code(aSw);
+        QByteArray data;
+
+        if (aResp && aResp->size) {
+            data = QByteArray((char*) aResp->bytes, aResp->size);
+            HDEBUG(data.toHex().constData() << code);
+        } else {
+            HDEBUG(code);
+        }
+        handler->ioTxFinished(id, code, data);
+    }
+    self->emitQueuedSignals();
+}
+
 /* static */
 void
 YubiKeyNfcIo::Private::tagEvent(
@@ -432,201 +671,6 @@ YubiKeyNfcIo::Lock::unlock()
     }
 }
 
-// ==========================================================================
-// YubiKeyNfcIo::Tx
-// ==========================================================================
-
-class YubiKeyNfcIo::Tx :
-    public YubiKeyIoTx
-{
-    Q_OBJECT
-
-public:
-    Tx(YubiKeyNfcIo*);
-    ~Tx() Q_DECL_OVERRIDE;
-
-    static void cancelHandler(GCancellable*, Tx*);
-    static void responseHandler(NfcIsoDepClient*, const GUtilData*, guint, const GError*, void*);
-
-    YubiKeyNfcIo* nfcIo() const;
-    void activate();
-    void deactivate(bool aMayDelete = true);
-    void cancelled();
-    void failed();
-    void finished(Result, QByteArray);
-    void emitQueuedIoSignals();
-
-    // YubiKeyTx
-    TxState txState() const  Q_DECL_OVERRIDE;
-    void txSetAutoDelete(bool) Q_DECL_OVERRIDE;
-    void txCancel() Q_DECL_OVERRIDE;
-
-public:
-    GCancellable* iCancel;
-    gulong iCancelId;
-    TxState iState;
-    bool iActive;
-    bool iAutoDelete;
-};
-
-YubiKeyNfcIo::Tx::Tx(
-    YubiKeyNfcIo* aParent) :
-    YubiKeyIoTx(aParent),
-    iCancel(g_cancellable_new()),
-    iCancelId(g_cancellable_connect(iCancel, G_CALLBACK(cancelHandler), this, NULL)),
-    iState(TxPending),
-    iActive(false),
-    iAutoDelete(false)
-{}
-
-YubiKeyNfcIo::Tx::~Tx()
-{
-    deactivate(false);
-    g_signal_handler_disconnect(iCancel, iCancelId);
-    g_cancellable_cancel(iCancel);
-    g_object_unref(iCancel);
-}
-
-YubiKeyIoTx::TxState
-YubiKeyNfcIo::Tx::txState() const
-{
-    return iState;
-}
-
-void
-YubiKeyNfcIo::Tx::txSetAutoDelete(
-    bool aAutoDelete)
-{
-    if (iAutoDelete != aAutoDelete) {
-        iAutoDelete = aAutoDelete;
-        if (aAutoDelete && iState != TxPending) {
-            HarbourUtil::scheduleDeleteLater(this);
-        }
-    }
-}
-
-void
-YubiKeyNfcIo::Tx::txCancel()
-{
-    if (iState == TxPending) {
-        g_cancellable_cancel(iCancel);
-    }
-}
-
-inline
-YubiKeyNfcIo*
-YubiKeyNfcIo::Tx::nfcIo() const
-{
-    return qobject_cast<YubiKeyNfcIo*>(parent());
-}
-
-void
-YubiKeyNfcIo::Tx::activate()
-{
-    if (!iActive) {
-        YubiKeyNfcIo::Private* priv = nfcIo()->iPrivate;
-
-        iActive = true;
-        priv->iActiveTx++;
-        priv->setState(IoActive);
-    }
-}
-
-void
-YubiKeyNfcIo::Tx::deactivate(
-    bool aMayDelete)
-{
-    if (iActive) {
-        YubiKeyNfcIo::Private* priv = nfcIo()->iPrivate;
-
-        iActive = false;
-        HASSERT(priv->iActiveTx > 0);
-        priv->iActiveTx--;
-        if (!priv->iActiveTx && priv->iState == IoActive) {
-            priv->setState(priv->iLock ? IoLocked : IoReady);
-        }
-        if (aMayDelete && iAutoDelete) {
-            HarbourUtil::scheduleDeleteLater(this);
-        }
-    }
-}
-
-void
-YubiKeyNfcIo::Tx::cancelled()
-{
-    if (iState == TxPending) {
-        iState = TxCancelled;
-        Q_EMIT txCancelled();
-    }
-}
-
-void
-YubiKeyNfcIo::Tx::failed()
-{
-    if (iState == TxPending) {
-        iState = TxFailed;
-        Q_EMIT txFailed();
-    }
-}
-
-void
-YubiKeyNfcIo::Tx::finished(
-    Result aCode,
-    QByteArray aData)
-{
-    if (iState == TxPending) {
-        iState = TxFinished;
-        Q_EMIT txFinished(aCode, aData);
-    }
-}
-
-inline
-void
-YubiKeyNfcIo::Tx::emitQueuedIoSignals()
-{
-    nfcIo()->iPrivate->emitQueuedSignals();
-}
-
-/* static */
-void
-YubiKeyNfcIo::Tx::cancelHandler(
-    GCancellable*,
-    Tx* aSelf)
-{
-    aSelf->cancelled();
-    aSelf->deactivate();
-    aSelf->emitQueuedIoSignals();
-}
-
-/* static */
-void
-YubiKeyNfcIo::Tx::responseHandler(
-    NfcIsoDepClient*,
-    const GUtilData* aResp,
-    guint aSw,
-    const GError* aError,
-    void* aSelf)
-{
-    Tx* self = (Tx*) aSelf;
-
-    if (aError) {
-        self->failed();
-    } else {
-        Result code(aSw);
-        QByteArray data;
-
-        if (aResp && aResp->size) {
-            data = QByteArray((char*) aResp->bytes, aResp->size);
-            HDEBUG(data.toHex().constData() << code);
-        } else {
-            HDEBUG(code);
-        }
-        self->finished(code, data);
-    }
-    self->deactivate();
-    self->emitQueuedIoSignals();
-}
-
 // ==========================================================================
 // YubiKeyNfcIo
 // ==========================================================================
@@ -676,33 +720,46 @@ YubiKeyNfcIo::ioLock()
     return lock;
 }
 
-YubiKeyIoTx*
-YubiKeyNfcIo::ioTransmit(
-    const APDU& aApdu)
+YubiKeyIo::TxId
+YubiKeyNfcIo::ioSubmit(
+    const APDU& aApdu,
+    YubiKeyIoTxHandler* aHandler)
 {
-    if (iPrivate->iIsoDep) {
-        Tx* tx = new Tx(this);
-        NfcIsoDepApdu apdu;
+    const TxId id = iPrivate->submit(aApdu, aHandler);
 
-        memset(&apdu, 0, sizeof(apdu));
-        apdu.cla = aApdu.cla;
-        apdu.ins = aApdu.ins;
-        apdu.p1 = aApdu.p1;
-        apdu.p2 = aApdu.p2;
-        apdu.data.bytes = (guint8*) aApdu.data.constData();
-        apdu.data.size = aApdu.data.size();
-        apdu.le = aApdu.le;
+    iPrivate->emitQueuedSignals();
+    return id;
+}
 
-        if (nfc_isodep_client_transmit(iPrivate->iIsoDep, &apdu,
-            tx->iCancel, Tx::responseHandler, tx, Q_NULLPTR)) {
-            HDEBUG(aApdu.name << hex << aApdu.cla << aApdu.ins <<
-                aApdu.p1 << aApdu.p2 << aApdu.data.toHex().constData());
-            tx->activate();
-            return tx;
-        }
-        delete tx;
+void
+YubiKeyNfcIo::ioCancel(
+    TxId aId)
+{
+    TxRecord* tx = iPrivate->takeTx(aId);
+
+    if (tx) {
+        // Don't call the handler from here, it's most likely the caller
+        tx->cancel();
+        iPrivate->queueCancelledTx(tx);
+    }
+}
+
+void
+YubiKeyNfcIo::ioRelease(
+    TxId aId)
+{
+    TxRecord* tx = iPrivate->takeTx(aId);
+
+    if (tx) {
+        tx->cancel();
+    } else {
+        // Cancelled but the handler hasn't been notified yet
+        tx = Private::takeTx(&iPrivate->iCancelledTx, aId);
+    }
+    if (tx) {
+        iPrivate->recycleTx(tx);
+        iPrivate->emitQueuedSignals();
     }
-    return Q_NULLPTR;
 }
 
 #include "YubiKeyNfcIo.moc"
@@ -58,10 +58,12 @@ public:
     IoState ioState() const Q_DECL_OVERRIDE;
     uint ioSerial() const Q_DECL_OVERRIDE;
     IoLock ioLock() Q_DECL_OVERRIDE;
-    YubiKeyIoTx* ioTransmit(const APDU&) Q_DECL_OVERRIDE;
+    TxId ioSubmit(const APDU&, YubiKeyIoTxHandler*) Q_DECL_OVERRIDE;
+    void ioCancel(TxId) Q_DECL_OVERRIDE;
+    void ioRelease(TxId) Q_DECL_OVERRIDE;
 
 private:
-    class Tx;
+    class TxRecord;
     class Lock;
     class Private;
     Private* iPrivate;
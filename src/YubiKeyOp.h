@@ -45,6 +45,11 @@
 // in the order they have been queued (considering the priorities).
 // YubiKeyOps are owned by YubiKeyOpQueue.
 //
+// A batch op consists of several commands which are sent one after
+// another without releasing the lock. Its opCount() is the number of
+// commands in the batch and opProgress() is the number of commands
+// completed so far.
+//
 // State diagram:
 //
 //                      START
@@ -71,6 +76,8 @@ class YubiKeyOp :
     Q_OBJECT
     Q_PROPERTY(int opId READ opId CONSTANT)
     Q_PROPERTY(int opState READ opState NOTIFY opStateChanged)
+    Q_PROPERTY(int opCount READ opCount CONSTANT)
+    Q_PROPERTY(int opProgress READ opProgress NOTIFY opProgressChanged)
     Q_ENUMS(OpState)
 
 public:
@@ -95,10 +102,13 @@ public:
     virtual int opId() const = 0;
     virtual void opCancel() = 0;
     virtual bool opIsDone() const = 0;
+    virtual int opCount() const = 0;
+    virtual int opProgress() const = 0;
 
 Q_SIGNALS:
     void opFinished(uint, QByteArray);
     void opStateChanged();
+    void opProgressChanged();
 
 protected:
     YubiKeyOp(QObject*);
@@ -106,24 +106,24 @@ operator<<(
 }
 #endif // HARBOUR_DEBUG
 
-typedef QScopedPointer<YubiKeyIoTx, HarbourUtil::ScopedPointerDeleteLater>
-    TxScopedPointer;
-
 // ==========================================================================
 // YubiKeyOpQueue::Entry (internal representation of YubiKeyOp)
 // ==========================================================================
 
 class YubiKeyOpQueue::Entry :
-    public YubiKeyOp
+    public YubiKeyOp,
+    public YubiKeyIoTxHandler
 {
     Q_OBJECT
 
 public:
     Entry(Private*, const YubiKeyIo::APDU&, Flags, Priority, int, OpData*);
+    Entry(Private*, const QList<YubiKeyIo::APDU>&, Flags, Priority, int, OpData*);
     ~Entry();
 
     Private* owner() const;
     void setOpState(OpState);
+    const YubiKeyIo::APDU& currentApdu() const;
     const char* name() const;
     bool start();
     void resetTx();
@@ -136,28 +136,36 @@ public:
     int opId() const Q_DECL_OVERRIDE;
     void opCancel() Q_DECL_OVERRIDE;
     bool opIsDone() const Q_DECL_OVERRIDE;
+    int opCount() const Q_DECL_OVERRIDE;
+    int opProgress() const Q_DECL_OVERRIDE;
+
+    // YubiKeyIoTxHandler
+    void ioTxCancelled(YubiKeyIo::TxId) Q_DECL_OVERRIDE;
+    void ioTxFailed(YubiKeyIo::TxId) Q_DECL_OVERRIDE;
+    void ioTxFinished(YubiKeyIo::TxId, YubiKeyIoTx::Result, const QByteArray&) Q_DECL_OVERRIDE;
 
 private:
-    bool setTx(YubiKeyIoTx*);
+    bool submitTx(const YubiKeyIo::APDU&);
     void sendRemaining(uint);
-
-private Q_SLOTS:
-    void onTxCancelled();
-    void onTxFailed();
-    void onTxFinished(YubiKeyIoTx::Result, const QByteArray&);
+    void batchCommandFinished(const YubiKeyIoTx::Result&);
 
 public:
     const YubiKeyIo::APDU iApdu;
+    const QList<YubiKeyIo::APDU> iBatch;  // Empty unless it's a batch
     const Flags iFlags;
     const Priority iPriority;
     const int iId;
     bool iTxFinished;
-    TxScopedPointer iTx;
+    YubiKeyIo::TxId iTxId;
     YubiKeyIoTx::Result iTxResult;
     QByteArray iTxRespBuf;
     OpData* iOpData;
     OpState iPrevOpState;
     OpState iOpState;
+    int iBatchPos;
+    int iPrevBatchPos;
+    YubiKeyIoTx::Result iBatchResult;
+    QByteArray iBatchStatus;
 };
 
 // ==========================================================================
@@ -177,13 +185,15 @@ typedef HarbourParentSignalQueueObject<YubiKeyOpQueue,
 
 class YubiKeyOpQueue::Private :
     public YubiKeyOpQueuePrivateBase,
-    public YubiKeyConstants
+    public YubiKeyConstants,
+    public YubiKeyIoTxHandler
 {
     Q_OBJECT
 
     friend class Entry;
     static const SignalEmitter gSignalEmitters[];
-    typedef bool (YubiKeyIo::APDU::*MatchFn)(const YubiKeyIo::APDU&) const;
+    typedef void (Private::*TxFinishedFn)(YubiKeyIoTx::Result, const QByteArray&);
+    typedef void (Private::*TxFailedFn)();
 
 public:
     typedef QQueue<Entry*> Queue;
@@ -211,11 +221,13 @@ public:
     YubiKeyOp* lookup(int);
     YubiKeyOp* queue(Entry*);
     YubiKeyOp* queue(const YubiKeyIo::APDU&, Flags, Priority, YubiKeyOp::OpData*);
-    int drop(const YubiKeyIo::APDU&, MatchFn);
+    YubiKeyOp* queueBatch(const QList<YubiKeyIo::APDU>&, Flags, Priority, YubiKeyOp::OpData*);
+    int newOpId();
+    int drop(const YubiKeyIo::APDU&, bool);
 
     QList<int> opIds();
     void setIo(YubiKeyIo*);
-    bool setInternalTx(YubiKeyIoTx*);
+    bool submitInternalTx(const YubiKeyIo::APDU&, TxFinishedFn, TxFailedFn);
     void setPassword(const QString&, bool);
     void resetInternalTx();
     void revalidate();
@@ -229,9 +241,7 @@ public:
     YubiKeyIo::APDU makeValidateApdu(const QByteArray&);
     void validate(const QByteArray&);
 
-public Q_SLOTS:
-    void onIoStateChanged(YubiKeyIo::IoState);
-    void onIoDestroyed(QObject*);
+    // Internal transaction completion handlers
     void onGetSerialFailed();
     void onSelectOtpFinished(YubiKeyIoTx::Result, const QByteArray&);
     void onGetSerialFinished(YubiKeyIoTx::Result, const QByteArray&);
@@ -239,14 +249,26 @@ public Q_SLOTS:
     void onSelectOathFinished(YubiKeyIoTx::Result, const QByteArray&);
     void onValidateFailed();
     void onValidateFinished(YubiKeyIoTx::Result, const QByteArray&);
+
+    // YubiKeyIoTxHandler
+    void ioTxCancelled(YubiKeyIo::TxId) Q_DECL_OVERRIDE;
+    void ioTxFailed(YubiKeyIo::TxId) Q_DECL_OVERRIDE;
+    void ioTxFinished(YubiKeyIo::TxId, YubiKeyIoTx::Result, const QByteArray&) Q_DECL_OVERRIDE;
+
+public Q_SLOTS:
+    void onIoStateChanged(YubiKeyIo::IoState);
+    void onIoDestroyed(QObject*);
     void onActiveOpStateChanged();
+    void onPasswordDerived(YubiKeyAlgorithm);
 
 public:
     State iState;
     Queue iQueue;
     Entry* iActiveOp;
     QPointer<YubiKeyIo> iIo;
-    TxScopedPointer iInternalTx;
+    YubiKeyIo::TxId iInternalTx;
+    TxFinishedFn iInternalTxFinished;
+    TxFailedFn iInternalTxFailed;
     YubiKeyAuth iAuth;
     YubiKeyIo::IoLock iLock;
     QByteArray iAuthChallenge;
@@ -258,6 +280,7 @@ public:
     QByteArray iFwVersion;
     bool iIoSetupDone;
     bool iRevalidate;
+    bool iValidatePending;  // Waiting for the access key to be derived
 };
 
 /* static */
@@ -273,12 +296,19 @@ YubiKeyOpQueue::Private::Private(
     YubiKeyOpQueuePrivateBase(aQueue, gSignalEmitters),
     iState(QueueIdle),
     iActiveOp(Q_NULLPTR),
+    iInternalTx(0),
+    iInternalTxFinished(Q_NULLPTR),
+    iInternalTxFailed(Q_NULLPTR),
     iAuthAlgorithm(YubiKeyAlgorithm_Unknown),
     iAuthAccess(YubiKeyAuthAccessUnknown),
     iYubiKeySerial(0),
     iIoSetupDone(false),
-    iRevalidate(false)
-{}
+    iRevalidate(false),
+    iValidatePending(false)
+{
+    connect(&iAuth, SIGNAL(passwordDerived(YubiKeyAlgorithm)),
+        SLOT(onPasswordDerived(YubiKeyAlgorithm)));
+}
 
 YubiKeyOpQueue::Private::~Private()
 {
@@ -423,8 +453,6 @@ YubiKeyOpQueue::Private::queue(
     Priority aPriority,
     YubiKeyOp::OpData* aOpData)
 {
-    static int gLastId = 0;
-
     if (aFlags & Replace) {
         for (MutableIterator it(iQueue); it.hasNext();) {
             Entry* op = it.next();
@@ -440,6 +468,25 @@ YubiKeyOpQueue::Private::queue(
         }
     }
 
+    queueSignal(SignalOpIdsChanged);
+    return queue(new Entry(this, aApdu, aFlags, aPriority, newOpId(), aOpData));
+}
+
+YubiKeyOp*
+YubiKeyOpQueue::Private::queueBatch(
+    const QList<YubiKeyIo::APDU>& aBatch,
+    Flags aFlags,
+    Priority aPriority,
+    YubiKeyOp::OpData* aOpData)
+{
+    queueSignal(SignalOpIdsChanged);
+    return queue(new Entry(this, aBatch, aFlags, aPriority, newOpId(), aOpData));
+}
+
+int
+YubiKeyOpQueue::Private::newOpId()
+{
+    static int gLastId = 0;
     int id = qMax(gLastId + 1, 1);
 
     // Pick a unique id
@@ -448,22 +495,20 @@ YubiKeyOpQueue::Private::queue(
     }
 
     gLastId = id;
-
-    queueSignal(SignalOpIdsChanged);
-    return queue(new Entry(this, aApdu, aFlags, aPriority, id, aOpData));
+    return id;
 }
 
 int
 YubiKeyOpQueue::Private::drop(
     const YubiKeyIo::APDU& aApdu,
-    MatchFn aMatch)
+    bool aFullMatch)
 {
     int count = 0;
 
     for (MutableIterator it(iQueue); it.hasNext();) {
         Entry* op = it.next();
 
-        if (((op->iApdu).*(aMatch))(aApdu)) {
+        if (aFullMatch ? op->iApdu.equals(aApdu) : op->iApdu.sameAs(aApdu)) {
             HDEBUG("dropping queued" << op->iApdu.name <<
                    "command" << op->iId);
             it.remove();
@@ -509,6 +554,7 @@ YubiKeyOpQueue::Private::releaseIo()
     resetInternalTx();
     iIoSetupDone = false;
     iRevalidate = false;
+    iValidatePending = false;
     iAuthChallenge.clear();
     iLock.reset();
 }
@@ -615,21 +661,65 @@ YubiKeyOpQueue::Private::setIo(
 }
 
 bool
-YubiKeyOpQueue::Private::setInternalTx(
-    YubiKeyIoTx* aTx)
+YubiKeyOpQueue::Private::submitInternalTx(
+    const YubiKeyIo::APDU& aApdu,
+    TxFinishedFn aFinished,
+    TxFailedFn aFailed)
 {
-    if (iInternalTx) {
-        iInternalTx->disconnect(this);
-        iInternalTx->txCancel();
+    // Internal transactions (SELECT, VALIDATE etc.) bypass the QObject
+    // based transmit interface
+    resetInternalTx();
+    if (iIo && (iInternalTx = iIo->ioSubmit(aApdu, this)) != 0) {
+        iInternalTxFinished = aFinished;
+        iInternalTxFailed = aFailed;
+        return true;
     }
-    iInternalTx.reset(aTx);
-    return aTx != Q_NULLPTR;
+    return false;
 }
 
 void
 YubiKeyOpQueue::Private::resetInternalTx()
 {
-    setInternalTx(Q_NULLPTR);
+    if (iInternalTx) {
+        const YubiKeyIo::TxId id = iInternalTx;
+
+        iInternalTx = 0;
+        if (iIo) {
+            iIo->ioRelease(id);
+        }
+    }
+}
+
+void
+YubiKeyOpQueue::Private::ioTxCancelled(
+    YubiKeyIo::TxId aId)
+{
+    // Cancellation of an internal transaction is a failure
+    ioTxFailed(aId);
+}
+
+void
+YubiKeyOpQueue::Private::ioTxFailed(
+    YubiKeyIo::TxId aId)
+{
+    if (iInternalTx && iInternalTx == aId) {
+        // The transaction is done, no need to release it
+        iInternalTx = 0;
+        (this->*iInternalTxFailed)();
+    }
+}
+
+void
+YubiKeyOpQueue::Private::ioTxFinished(
+    YubiKeyIo::TxId aId,
+    YubiKeyIoTx::Result aResult,
+    const QByteArray& aData)
+{
+    if (iInternalTx && iInternalTx == aId) {
+        // The transaction is done, no need to release it
+        iInternalTx = 0;
+        (this->*iInternalTxFinished)(aResult, aData);
+    }
 }
 
 void
@@ -668,18 +758,44 @@ YubiKeyOpQueue::Private::setPassword(
     const QString& aPassword,
     bool aSave)
 {
-    const YubiKeyAlgorithm alg = authAlgorithm();
-    iAuth.setPassword(alg, aPassword, aSave);
-    const QByteArray accessKey(iAuth.getAccessKey(alg));
+    // PBKDF2 runs on worker threads. If the algorithm isn't known yet,
+    // the keys are derived for all of them, so that VALIDATE can be sent
+    // as soon as SELECT tells us which one is needed. In that case SELECT
+    // goes out right away and then waits for the key.
+    HDEBUG("deriving" << iAuthAlgorithm << "access key");
+    iAuth.derivePassword(iAuthAlgorithm, aPassword, aSave);
+    if (iAuthAlgorithm == YubiKeyAlgorithm_Unknown) {
+        revalidate();
+    }
+}
 
-#if HARBOUR_DEBUG
-    if (accessKey.isEmpty()) {
-        HDEBUG("trying open access");
-    } else {
+void
+YubiKeyOpQueue::Private::onPasswordDerived(
+    YubiKeyAlgorithm aAlgorithm)
+{
+    const QByteArray accessKey(iAuth.getAccessKey(aAlgorithm));
+
+    if (iValidatePending) {
+        // SELECT has already been sent and we've been waiting for this key
+        if (aAlgorithm == iAuthAlgorithm) {
+            iValidatePending = false;
+            if (accessKey.isEmpty()) {
+                // Derivation was cancelled
+                setAuthAccess(YubiKeyAuthAccessDenied);
+                setState(QueueIdle);
+            } else {
+                HDEBUG("trying access key" << accessKey.toHex().constData());
+                validate(accessKey);
+            }
+            emitQueuedSignals();
+        }
+    } else if (!accessKey.isEmpty() && aAlgorithm == iAuthAlgorithm) {
+        // If the algorithm was unknown, revalidation has already been
+        // started by setPassword()
         HDEBUG("trying access key" << accessKey.toHex().constData());
+        revalidate();
+        emitQueuedSignals();
     }
-#endif // HARBOUR_DEBUG
-    revalidate();
 }
 
 void
@@ -712,14 +828,8 @@ YubiKeyOpQueue::Private::selectOtp()
 
     resetInternalTx();
     requeueActiveOp();
-    if (setInternalTx(iIo->ioTransmit(CMD_SELECT_OTP))) {
-        YubiKeyIoTx* tx = iInternalTx.data();
-
-        connect(tx, SIGNAL(txFailed()), SLOT(onGetSerialFailed()));
-        connect(tx, SIGNAL(txCancelled()), SLOT(onGetSerialFailed()));
-        connect(tx, SIGNAL(txFinished(YubiKeyIoTx::Result,QByteArray)),
-            SLOT(onSelectOtpFinished(YubiKeyIoTx::Result,QByteArray)));
-    } else {
+    if (!submitInternalTx(CMD_SELECT_OTP, &Private::onSelectOtpFinished,
+        &Private::onGetSerialFailed)) {
         selectOath();
     }
 }
@@ -731,17 +841,11 @@ YubiKeyOpQueue::Private::onSelectOtpFinished(
 {
     resetInternalTx();
     if (aResult.success()) {
-        static const YubiKeyIo::APDU CMD_GET_SERIAL("GET_SERIAL", 0x00, 0x01, 0x10);
+        static const YubiKeyIo::Header CMD_GET_SERIAL("GET_SERIAL", 0x00, 0x01, 0x10);
 
         HDEBUG("SELECT ok");
-        if (setInternalTx(iIo->ioTransmit(CMD_GET_SERIAL))) {
-            YubiKeyIoTx* tx = iInternalTx.data();
-
-            connect(tx, SIGNAL(txFailed()), SLOT(onGetSerialFailed()));
-            connect(tx, SIGNAL(txCancelled()), SLOT(onGetSerialFailed()));
-            connect(tx, SIGNAL(txFinished(YubiKeyIoTx::Result,QByteArray)),
-                SLOT(onGetSerialFinished(YubiKeyIoTx::Result,QByteArray)));
-        } else {
+        if (!submitInternalTx(CMD_GET_SERIAL, &Private::onGetSerialFinished,
+            &Private::onGetSerialFailed)) {
             selectOath();
         }
     } else {
@@ -791,15 +895,9 @@ YubiKeyOpQueue::Private::selectOath()
 
     resetInternalTx();
     requeueActiveOp();
-    if (setInternalTx(iIo->ioTransmit(CMD_SELECT_OATH))) {
-        YubiKeyIoTx* tx = iInternalTx.data();
-
-        // SELECT requires special handling upon completion
-        connect(tx, SIGNAL(txFailed()), SLOT(onSelectOathFailed()));
-        connect(tx, SIGNAL(txCancelled()), SLOT(onSelectOathFailed()));
-        connect(tx, SIGNAL(txFinished(YubiKeyIoTx::Result,QByteArray)),
-            SLOT(onSelectOathFinished(YubiKeyIoTx::Result,QByteArray)));
-    } else {
+    // SELECT requires special handling upon completion
+    if (!submitInternalTx(CMD_SELECT_OATH, &Private::onSelectOathFinished,
+        &Private::onSelectOathFailed)) {
         setState(QueueIdle);
     }
 }
@@ -829,8 +927,12 @@ YubiKeyOpQueue::Private::calculateAuthResponse(
     const QByteArray& aAccessKey,
     const QByteArray& aChallenge)
 {
-    return YubiKeyAuth::calculateResponse(aAccessKey,
-        aChallenge, authAlgorithm());
+    const YubiKeyAlgorithm alg = authAlgorithm();
+
+    // Use the cached HMAC context if it's our key
+    return (aAccessKey == iAuth.getAccessKey(alg)) ?
+        iAuth.calculateResponse(aChallenge, alg) :
+        YubiKeyAuth::calculateResponse(aAccessKey, aChallenge, alg);
 }
 
 YubiKeyIo::APDU
@@ -849,7 +951,7 @@ YubiKeyOpQueue::Private::makeValidateApdu(
     // the response. The application will then respond with a similar
     // calculation that the host software can verify.
     //
-    static const YubiKeyIo::APDU CMD_VALIDATE("VALIDATE", 0x00, 0xa3);
+    static const YubiKeyIo::Header CMD_VALIDATE("VALIDATE", 0x00, 0xa3);
 
     const QByteArray response(calculateAuthResponse(aAccessKey, iAuthChallenge));
     iHostChallenge = YubiKeyUtil::randomAuthChallenge();
@@ -881,14 +983,8 @@ YubiKeyOpQueue::Private::validate(
 {
     resetInternalTx();
     requeueActiveOp();
-    if (setInternalTx(iIo->ioTransmit(makeValidateApdu(aAccessKey)))) {
-        YubiKeyIoTx* tx = iInternalTx.data();
-
-        connect(tx, SIGNAL(txFailed()), SLOT(onValidateFailed()));
-        connect(tx, SIGNAL(txCancelled()), SLOT(onValidateFailed()));
-        connect(tx, SIGNAL(txFinished(YubiKeyIoTx::Result,QByteArray)),
-            SLOT(onValidateFinished(YubiKeyIoTx::Result,QByteArray)));
-    } else {
+    if (!submitInternalTx(makeValidateApdu(aAccessKey),
+        &Private::onValidateFinished, &Private::onValidateFailed)) {
         setState(QueueIdle);
     }
 }
@@ -1001,9 +1097,18 @@ YubiKeyOpQueue::Private::onSelectOathFinished(
                     authorized();
                     startNextOp();
                 } else {
-                    // See if we have the access key for it
+                    // See if we have the access key for it. If the keys
+                    // have been derived for all algorithms, this one is
+                    // kept and the rest are dropped.
+                    iAuth.setAuthAlgorithm(iAuthAlgorithm);
                     QByteArray accessKey(iAuth.getAccessKey(iAuthAlgorithm));
-                    if (accessKey.isEmpty()) {
+                    if (iAuth.isDerivingPassword(iAuthAlgorithm)) {
+                        // The password has just been changed. Keep the
+                        // lock, VALIDATE will be sent when the key is ready
+                        HDEBUG("Waiting for" << iAuthAlgorithm <<
+                            "access key");
+                        iValidatePending = true;
+                    } else if (accessKey.isEmpty()) {
                         if (haveKeySpecificOp()) {
                             queueSetupSignal(SignalInvalidYubiKeyConnected);
                             setState(QueueBlocked);
@@ -1159,11 +1264,39 @@ YubiKeyOpQueue::Entry::Entry(
     iPriority(aPriority),
     iId(aId),
     iTxFinished(false),
+    iTxId(0),
     iOpData(aOpData),
     iPrevOpState(OpQueued),
-    iOpState(OpQueued)
+    iOpState(OpQueued),
+    iBatchPos(0),
+    iPrevBatchPos(0)
 {}
 
+YubiKeyOpQueue::Entry::Entry(
+    Private* aPrivate,
+    const QList<YubiKeyIo::APDU>& aBatch,
+    Flags aFlags,
+    Priority aPriority,
+    int aId,
+    OpData* aOpData) :
+    YubiKeyOp(aPrivate),
+    iApdu(aBatch.first()),
+    iBatch(aBatch),
+    iFlags(aFlags),
+    iPriority(aPriority),
+    iId(aId),
+    iTxFinished(false),
+    iTxId(0),
+    iOpData(aOpData),
+    iPrevOpState(OpQueued),
+    iOpState(OpQueued),
+    iBatchPos(0),
+    iPrevBatchPos(0),
+    iBatchResult(YubiKeyConstants::RC_OK)
+{
+    iBatchStatus.reserve(2 * aBatch.count());
+}
+
 YubiKeyOpQueue::Entry::~Entry()
 {
     resetTx();
@@ -1216,7 +1349,8 @@ YubiKeyOpQueue::Entry::setOpState(
 bool
 YubiKeyOpQueue::Entry::hasQueuedSignals() const
 {
-    return iTxFinished || iPrevOpState != iOpState;
+    return iTxFinished || iPrevOpState != iOpState ||
+        iPrevBatchPos != iBatchPos;
 }
 
 void
@@ -1232,16 +1366,27 @@ YubiKeyOpQueue::Entry::emitQueuedSignals()
         iTxRespBuf.swap(data);
         Q_EMIT opFinished(code, data);
     }
+    if (iPrevBatchPos != iBatchPos) {
+        iPrevBatchPos = iBatchPos;
+        Q_EMIT opProgressChanged();
+    }
     if (iPrevOpState != iOpState) {
         iPrevOpState = iOpState;
         Q_EMIT opStateChanged();
     }
 }
 
+inline
+const YubiKeyIo::APDU&
+YubiKeyOpQueue::Entry::currentApdu() const
+{
+    return iBatch.isEmpty() ? iApdu : iBatch.at(iBatchPos);
+}
+
 const char*
 YubiKeyOpQueue::Entry::name() const
 {
-    return iApdu.name;
+    return currentApdu().name;
 }
 
 YubiKeyOp::OpData*
@@ -1267,12 +1412,14 @@ YubiKeyOpQueue::Entry::opCancel()
 {
     Private* p = owner();
 
-    if (iTx) {
+    if (iTxId) {
         // Cancel the transaction and wait until it actually gets cancelled
         // The op remains active for the time being.
         HASSERT(p->iActiveOp == this);
         HASSERT(iOpState == OpActive);
-        iTx->txCancel();
+        if (p->iIo) {
+            p->iIo->ioCancel(iTxId);
+        }
     } else {
         HASSERT(iOpState != OpActive);
         switch (iOpState) {
@@ -1313,27 +1460,26 @@ YubiKeyOpQueue::Entry::opIsDone() const
     return false;
 }
 
+int
+YubiKeyOpQueue::Entry::opCount() const
+{
+    return iBatch.isEmpty() ? 1 : iBatch.count();
+}
+
+int
+YubiKeyOpQueue::Entry::opProgress() const
+{
+    return iBatch.isEmpty() ? (iOpState == OpFinished ? 1 : 0) : iBatchPos;
+}
+
 bool
 YubiKeyOpQueue::Entry::start()
 {
-    Private* p = owner();
-
     HASSERT(!iTxFinished);
     iTxRespBuf.resize(0);
-    if (iTx) {
-        iTx->disconnect(this);
-        iTx->txCancel();
-    }
-    if (p->iIo && setTx(p->iIo->ioTransmit(iApdu))) {
-        connect(iTx.data(),
-            SIGNAL(txCancelled()),
-            SLOT(onTxCancelled()));
-        connect(iTx.data(),
-            SIGNAL(txFailed()),
-            SLOT(onTxFailed()));
-        connect(iTx.data(),
-            SIGNAL(txFinished(YubiKeyIoTx::Result,QByteArray)),
-            SLOT(onTxFinished(YubiKeyIoTx::Result,QByteArray)));
+    // If the batch gets interrupted and then restarted, it continues
+    // from the command which didn't get completed
+    if (submitTx(currentApdu())) {
         setOpState(OpActive);
         return true;
     }
@@ -1341,76 +1487,85 @@ YubiKeyOpQueue::Entry::start()
 }
 
 bool
-YubiKeyOpQueue::Entry::setTx(
-    YubiKeyIoTx* aTx)
+YubiKeyOpQueue::Entry::submitTx(
+    const YubiKeyIo::APDU& aApdu)
 {
-    if (iTx) {
-        iTx->disconnect(this);
-        iTx->txCancel();
-    }
-    iTx.reset(aTx);
-    if (aTx) {
-        connect(aTx, SIGNAL(txCancelled()), SLOT(onTxCancelled()));
-        connect(aTx, SIGNAL(txFailed()), SLOT(onTxFailed()));
-        connect(aTx, SIGNAL(txFinished(YubiKeyIoTx::Result,QByteArray)),
-            SLOT(onTxFinished(YubiKeyIoTx::Result,QByteArray)));
-    }
-    return aTx != Q_NULLPTR;
+    YubiKeyIo* io = owner()->iIo;
+
+    resetTx();
+    return io && (iTxId = io->ioSubmit(aApdu, this)) != 0;
 }
 
 void
 YubiKeyOpQueue::Entry::resetTx()
 {
-    setTx(Q_NULLPTR);
+    if (iTxId) {
+        // If the parent is being deleted, owner() returns NULL
+        const YubiKeyIo::TxId id = iTxId;
+        Private* p = owner();
+
+        iTxId = 0;
+        if (p && p->iIo) {
+            p->iIo->ioRelease(id);
+        }
+    }
 }
 
 void
 YubiKeyOpQueue::Entry::sendRemaining(
     uint aAmount)
 {
-    static const YubiKeyIo::APDU SEND_REMAINING("SEND_REMAINING", 0x00, 0xa5);
-
-    Private* p = owner();
-    YubiKeyIo* io = p->iIo;
+    static const YubiKeyIo::Header SEND_REMAINING("SEND_REMAINING", 0x00, 0xa5);
 
     HDEBUG(iTxRespBuf.size() << "bytes +" << aAmount << "more");
-    if (!io || !setTx(io->ioTransmit(SEND_REMAINING))) {
+    if (!submitTx(SEND_REMAINING)) {
         setOpState(OpFailed);
     }
 }
 
-
 void
-YubiKeyOpQueue::Entry::onTxCancelled()
+YubiKeyOpQueue::Entry::ioTxCancelled(
+    YubiKeyIo::TxId aId)
 {
-    resetTx();
-    setOpState(OpCancelled);
-    emitQueuedSignals();
+    if (iTxId && iTxId == aId) {
+        iTxId = 0;
+        setOpState(OpCancelled);
+        emitQueuedSignals();
+    }
 }
 
 void
-YubiKeyOpQueue::Entry::onTxFailed()
+YubiKeyOpQueue::Entry::ioTxFailed(
+    YubiKeyIo::TxId aId)
 {
-    resetTx();
-    setOpState(OpFailed);
-    emitQueuedSignals();
+    if (iTxId && iTxId == aId) {
+        iTxId = 0;
+        setOpState(OpFailed);
+        emitQueuedSignals();
+    }
 }
 
 void
-YubiKeyOpQueue::Entry::onTxFinished(
+YubiKeyOpQueue::Entry::ioTxFinished(
+    YubiKeyIo::TxId aId,
     YubiKeyIoTx::Result aResult,
     const QByteArray& aData)
 {
     uint amount;
 
-    iTx->disconnect(this);
-    iTx->txCancel();
-    iTx.reset();
+    if (!iTxId || iTxId != aId) {
+        // Stale transaction
+        return;
+    }
 
+    // The transaction is done, no need to release it
+    iTxId = 0;
     iTxRespBuf.append(aData);
     if (aResult.moreData(&amount)) {
         HDEBUG(name() << "(partial)" << aData.size() << "bytes");
         sendRemaining(amount);
+    } else if (!iBatch.isEmpty()) {
+        batchCommandFinished(aResult);
     } else {
 #if HARBOUR_DEBUG
         if (aResult.success()) {
@@ -1426,6 +1581,34 @@ YubiKeyOpQueue::Entry::onTxFinished(
     emitQueuedSignals();
 }
 
+void
+YubiKeyOpQueue::Entry::batchCommandFinished(
+    const YubiKeyIoTx::Result& aResult)
+{
+    HDEBUG(name() << (iBatchPos + 1) << "of" << iBatch.count() << aResult);
+    iBatchStatus.append((char)aResult.sw1());
+    iBatchStatus.append((char)aResult.sw2());
+    if (!aResult.success() && iBatchResult.success()) {
+        iBatchResult = aResult;
+    }
+
+    iBatchPos++;
+    if (iBatchPos < iBatch.count() &&
+        aResult.code != YubiKeyConstants::RC_NO_SPACE) {
+        // Send the next one right away, without going through the queue
+        iTxRespBuf.resize(0);
+        if (!submitTx(currentApdu())) {
+            setOpState(OpFailed);
+        }
+    } else {
+        // Done (or no point in continuing)
+        iTxFinished = true;
+        iTxResult = iBatchResult;
+        iTxRespBuf = iBatchStatus;
+        setOpState(OpFinished);
+    }
+}
+
 // ==========================================================================
 // YubiKeyOpQueue
 // ==========================================================================
@@ -1527,14 +1710,31 @@ YubiKeyOpQueue::queue(
     return op;
 }
 
+YubiKeyOp*
+YubiKeyOpQueue::queueBatch(
+    const QList<YubiKeyIo::APDU>& aBatch,
+    Flags aFlags,
+    Priority aPriority,
+    YubiKeyOp::OpData* aOpData)
+{
+    if (aBatch.isEmpty()) {
+        delete aOpData;
+        return Q_NULLPTR;
+    } else {
+        YubiKeyOp* op = iPrivate->queueBatch(aBatch, aFlags, aPriority, aOpData);
+
+        iPrivate->tryToStartNextOp();
+        iPrivate->emitQueuedSignals();
+        return op;
+    }
+}
+
 int
 YubiKeyOpQueue::drop(
     const YubiKeyIo::APDU& aApdu,
     bool aFullMatch)
 {
-    const int count = iPrivate->drop(aApdu, aFullMatch ?
-        &YubiKeyIo::APDU::equals :
-        &YubiKeyIo::APDU::sameAs);
+    const int count = iPrivate->drop(aApdu, aFullMatch);
 
     iPrivate->emitQueuedSignals();
     return count;
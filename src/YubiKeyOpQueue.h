@@ -128,6 +128,14 @@ public:
     YubiKeyOp* queue(const YubiKeyIo::APDU&, Flags, YubiKeyOp::OpData*);
     YubiKeyOp* queue(const YubiKeyIo::APDU&, Flags, Priority, YubiKeyOp::OpData*);
 
+    // The commands are sent one after another, under the same lock.
+    // The batch stops at the first RC_NO_SPACE error. The result code
+    // of the batch is the first error code (or RC_OK if everything went
+    // well) and the response data are the status words (2 bytes each)
+    // of the commands which have been completed.
+    YubiKeyOp* queueBatch(const QList<YubiKeyIo::APDU>&, Flags, Priority,
+        YubiKeyOp::OpData* aOpData = Q_NULLPTR);
+
     int drop(const YubiKeyIo::APDU&, bool aFullMatch = false);
     State opQueueState() const;
     QList<int> opIds() const;
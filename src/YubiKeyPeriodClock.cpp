@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "YubiKeyPeriodClock.h"
+
+#include "YubiKeyConstants.h"
+
+#include "HarbourDebug.h"
+
+#include <QtCore/QDateTime>
+#include <QtCore/QMetaMethod>
+#include <QtCore/QTimer>
+#include <QtCore/QWeakPointer>
+
+static QWeakPointer<YubiKeyPeriodClock> gSharedInstance;
+
+// ==========================================================================
+// YubiKeyPeriodClock::Private
+// ==========================================================================
+
+class YubiKeyPeriodClock::Private :
+    public QObject,
+    public YubiKeyConstants
+{
+    Q_OBJECT
+
+public:
+    static const qint64 PERIOD_MS = TOTP_PERIOD_SEC * 1000;
+
+    Private(YubiKeyPeriodClock*);
+
+    void updateTimer();
+
+public Q_SLOTS:
+    void onBoundaryTimer();
+
+public:
+    YubiKeyPeriodClock* iClock;
+    const QMetaMethod iPeriodChangedSignal;
+    QTimer iBoundaryTimer;
+    qint64 iPeriod;
+};
+
+YubiKeyPeriodClock::Private::Private(
+    YubiKeyPeriodClock* aClock) :
+    iClock(aClock),
+    iPeriodChangedSignal(QMetaMethod::fromSignal(&YubiKeyPeriodClock::periodChanged)),
+    iPeriod(periodAt(QDateTime::currentMSecsSinceEpoch()))
+{
+    // Boundary timer fires once per period and has to be reasonably accurate
+    iBoundaryTimer.setSingleShot(true);
+    iBoundaryTimer.setTimerType(Qt::PreciseTimer);
+    connect(&iBoundaryTimer, SIGNAL(timeout()), SLOT(onBoundaryTimer()));
+}
+
+void
+YubiKeyPeriodClock::Private::updateTimer()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    if (iClock->isSignalConnected(iPeriodChangedSignal)) {
+        if (!iBoundaryTimer.isActive()) {
+            // iPeriod is the period which the boundary timer is armed for
+            iPeriod = periodAt(now);
+            iBoundaryTimer.start((int)((iPeriod + 1) * PERIOD_MS - now));
+            HDEBUG("period" << iPeriod << "ends in" <<
+                iBoundaryTimer.interval() << "ms");
+        }
+    } else if (iBoundaryTimer.isActive()) {
+        HDEBUG("no period listeners");
+        iBoundaryTimer.stop();
+    }
+}
+
+void
+YubiKeyPeriodClock::Private::onBoundaryTimer()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const qint64 period = periodAt(now);
+
+    if (period == iPeriod) {
+        // Woke up a bit too early
+        iBoundaryTimer.start(qMax((int)((iPeriod + 1) * PERIOD_MS - now), 1));
+    } else {
+        HDEBUG("period" << period);
+        updateTimer();
+        Q_EMIT iClock->periodChanged();
+    }
+}
+
+// ==========================================================================
+// YubiKeyPeriodClock
+// ==========================================================================
+
+YubiKeyPeriodClock::YubiKeyPeriodClock() :
+    iPrivate(new Private(this))
+{
+}
+
+YubiKeyPeriodClock::~YubiKeyPeriodClock()
+{
+    // Make sure that (dis)connectNotify doesn't touch the dead Private
+    Private* priv = iPrivate;
+
+    iPrivate = Q_NULLPTR;
+    delete priv;
+}
+
+/* static */
+QSharedPointer<YubiKeyPeriodClock>
+YubiKeyPeriodClock::sharedInstance()
+{
+    QSharedPointer<YubiKeyPeriodClock> instance(gSharedInstance);
+
+    if (instance.isNull()) {
+        instance = QSharedPointer<YubiKeyPeriodClock>(new YubiKeyPeriodClock,
+            &QObject::deleteLater);
+        gSharedInstance = instance;
+    }
+    return instance;
+}
+
+/* static */
+qint64
+YubiKeyPeriodClock::periodAt(
+    qint64 aMsecsSinceEpoch)
+{
+    return aMsecsSinceEpoch / Private::PERIOD_MS;
+}
+
+qint64
+YubiKeyPeriodClock::currentPeriod() const
+{
+    return periodAt(QDateTime::currentMSecsSinceEpoch());
+}
+
+int
+YubiKeyPeriodClock::msecsLeft() const
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    return (int)((periodAt(now) + 1) * Private::PERIOD_MS - now);
+}
+
+void
+YubiKeyPeriodClock::connectNotify(
+    const QMetaMethod& aSignal)
+{
+    if (iPrivate && aSignal == iPrivate->iPeriodChangedSignal) {
+        iPrivate->updateTimer();
+    }
+}
+
+void
+YubiKeyPeriodClock::disconnectNotify(
+    const QMetaMethod& aSignal)
+{
+    // Note that disconnectNotify may be invoked with an invalid QMetaMethod
+    // (e.g. when a receiver gets destroyed), check everything in that case
+    if (iPrivate && (!aSignal.isValid() ||
+        aSignal == iPrivate->iPeriodChangedSignal)) {
+        iPrivate->updateTimer();
+    }
+}
+
+#include "YubiKeyPeriodClock.moc"
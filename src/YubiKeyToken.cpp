@@ -36,6 +36,7 @@
  */
 
 #include "YubiKeyToken.h"
+#include "YubiKeyUtil.h"
 
 #include "HarbourBase32.h"
 #include "HarbourDebug.h"
@@ -261,98 +262,52 @@ YubiKeyToken
 YubiKeyToken::withType(
     YubiKeyTokenType aType) const
 {
-    if (!iPrivate) {
-        return YubiKeyToken();
-    } else if (iPrivate->iType == aType) {
-        return *this;
-    } else {
-        return YubiKeyToken(new Private(aType, iPrivate->iAlgorithm,
-            iPrivate->iLabel, iPrivate->iIssuer, iPrivate->iSecret,
-            iPrivate->iSecretBase32, iPrivate->iDigits, iPrivate->iCounter));
-    }
+    return iPrivate ? Builder(*this).setType(aType).build() : YubiKeyToken();
 }
 
 YubiKeyToken
 YubiKeyToken::withAlgorithm(
     YubiKeyAlgorithm aAlgorithm) const
 {
-    if (!iPrivate) {
-        return YubiKeyToken();
-    } else if (iPrivate->iAlgorithm == aAlgorithm) {
-        return *this;
-    } else {
-        return YubiKeyToken(new Private(iPrivate->iType, aAlgorithm,
-            iPrivate->iLabel, iPrivate->iIssuer, iPrivate->iSecret,
-            iPrivate->iSecretBase32, iPrivate->iDigits, iPrivate->iCounter));
-    }
+    return iPrivate ? Builder(*this).setAlgorithm(aAlgorithm).build() :
+        YubiKeyToken();
 }
 
 YubiKeyToken
 YubiKeyToken::withLabel(
     const QString aLabel) const
 {
-    if (!iPrivate) {
-        return YubiKeyToken();
-    } else if (iPrivate->iLabel == aLabel) {
-        return *this;
-    } else {
-        return YubiKeyToken(new Private(iPrivate->iType, iPrivate->iAlgorithm,
-            aLabel, iPrivate->iIssuer, iPrivate->iSecret,
-            iPrivate->iSecretBase32, iPrivate->iDigits, iPrivate->iCounter));
-    }
+    return iPrivate ? Builder(*this).setLabel(aLabel).build() :
+        YubiKeyToken();
 }
 
 YubiKeyToken
 YubiKeyToken::withIssuer(
     const QString aIssuer) const
 {
-    if (!iPrivate) {
-        return YubiKeyToken();
-    } else if (iPrivate->iIssuer == aIssuer) {
-        return *this;
-    } else {
-        return YubiKeyToken(new Private(iPrivate->iType, iPrivate->iAlgorithm,
-            iPrivate->iLabel, aIssuer, iPrivate->iSecret,
-            iPrivate->iSecretBase32, iPrivate->iDigits, iPrivate->iCounter));
-    }
+    return iPrivate ? Builder(*this).setIssuer(aIssuer).build() :
+        YubiKeyToken();
 }
 
 YubiKeyToken
 YubiKeyToken::withSecret(
     const QByteArray aSecret) const
 {
-    if (!iPrivate) {
-        return YubiKeyToken();
-    } else if (iPrivate->iSecret == aSecret) {
-        return *this;
-    } else {
-        return YubiKeyToken(new Private(iPrivate->iType, iPrivate->iAlgorithm,
-            iPrivate->iLabel, iPrivate->iIssuer, aSecret,
-            HarbourBase32::toBase32(aSecret, true), iPrivate->iDigits,
-            iPrivate->iCounter));
-    }
-
+    return iPrivate ? Builder(*this).setSecret(aSecret).build() :
+        YubiKeyToken();
 }
 
 YubiKeyToken
 YubiKeyToken::withSecretBase32(
     const QString aBase32) const
 {
-    if (!iPrivate) {
-        return YubiKeyToken();
-    } else if (!HarbourBase32::isValidBase32(aBase32)) {
-        return *this;
-    }  else {
-        const QByteArray secret(HarbourBase32::fromBase32(aBase32));
+    if (iPrivate) {
+        const QByteArray secret(YubiKeyUtil::fromBase32(aBase32));
 
-        if (iPrivate->iSecret == secret) {
-            return *this;
-        } else {
-            return YubiKeyToken(new Private(iPrivate->iType, iPrivate->iAlgorithm,
-                iPrivate->iLabel, iPrivate->iIssuer, secret,
-                HarbourBase32::toBase32(secret, true), iPrivate->iDigits,
-                iPrivate->iCounter));
-        }
+        return secret.isEmpty() ? *this :
+            Builder(*this).setSecret(secret).build();
+    } else {
+        return YubiKeyToken();
     }
 }
 
@@ -360,30 +315,170 @@ YubiKeyToken
 YubiKeyToken::withDigits(
     int aDigits) const
 {
-    if (!iPrivate) {
-        return YubiKeyToken();
-    } else if (iPrivate->iDigits == aDigits) {
-        return *this;
-    } else {
-        return YubiKeyToken(new Private(iPrivate->iType, iPrivate->iAlgorithm,
-            iPrivate->iLabel, iPrivate->iIssuer, iPrivate->iSecret,
-            iPrivate->iSecretBase32, aDigits, iPrivate->iCounter));
-    }
+    return iPrivate ? Builder(*this).setDigits(aDigits).build() :
+        YubiKeyToken();
 }
 
 YubiKeyToken
 YubiKeyToken::withCounter(
     int aCounter) const
 {
-    if (!iPrivate) {
-        return YubiKeyToken();
-    } else if (iPrivate->iCounter == aCounter) {
-        return *this;
-    } else {
-        return YubiKeyToken(new Private(iPrivate->iType, iPrivate->iAlgorithm,
-            iPrivate->iLabel, iPrivate->iIssuer, iPrivate->iSecret,
-            iPrivate->iSecretBase32, iPrivate->iDigits, aCounter));
+    return iPrivate ? Builder(*this).setCounter(aCounter).build() :
+        YubiKeyToken();
+}
+
+// ==========================================================================
+// YubiKeyToken::Builder
+// ==========================================================================
+
+YubiKeyToken::Builder::Builder() :
+    iEdit(Q_NULLPTR),
+    iSecretChanged(false)
+{
+}
+
+YubiKeyToken::Builder::Builder(
+    const YubiKeyToken& aToken) :
+    iToken(aToken),
+    iEdit(Q_NULLPTR),
+    iSecretChanged(false)
+{
+}
+
+YubiKeyToken::Builder::~Builder()
+{
+    delete iEdit;
+}
+
+const YubiKeyToken::Private*
+YubiKeyToken::Builder::data() const
+{
+    return iEdit ? iEdit : iToken.iPrivate;
+}
+
+YubiKeyToken::Private*
+YubiKeyToken::Builder::edit()
+{
+    if (!iEdit) {
+        const Private* src = iToken.iPrivate;
+
+        if (src) {
+            iEdit = new Private(src->iType, src->iAlgorithm, src->iLabel,
+                src->iIssuer, src->iSecret, src->iSecretBase32,
+                src->iDigits, src->iCounter);
+        } else {
+            iEdit = new Private(YubiKeyTokenType_Default,
+                YubiKeyAlgorithm_Default, QString(), QString(), QByteArray(),
+                QString(), DefaultDigits, 0);
+        }
+    }
+    return iEdit;
+}
+
+YubiKeyToken::Builder&
+YubiKeyToken::Builder::setType(
+    YubiKeyTokenType aType)
+{
+    const Private* d = data();
+
+    if (!d || d->iType != aType) {
+        edit()->iType = aType;
+    }
+    return *this;
+}
+
+YubiKeyToken::Builder&
+YubiKeyToken::Builder::setAlgorithm(
+    YubiKeyAlgorithm aAlgorithm)
+{
+    const Private* d = data();
+
+    if (!d || d->iAlgorithm != aAlgorithm) {
+        edit()->iAlgorithm = aAlgorithm;
+    }
+    return *this;
+}
+
+YubiKeyToken::Builder&
+YubiKeyToken::Builder::setLabel(
+    const QString aLabel)
+{
+    const Private* d = data();
+
+    if (!d || d->iLabel != aLabel) {
+        edit()->iLabel = aLabel;
+    }
+    return *this;
+}
+
+YubiKeyToken::Builder&
+YubiKeyToken::Builder::setIssuer(
+    const QString aIssuer)
+{
+    const Private* d = data();
+
+    if (!d || d->iIssuer != aIssuer) {
+        edit()->iIssuer = aIssuer;
+    }
+    return *this;
+}
+
+YubiKeyToken::Builder&
+YubiKeyToken::Builder::setSecret(
+    const QByteArray aSecret)
+{
+    const Private* d = data();
+
+    if (!d || d->iSecret != aSecret) {
+        edit()->iSecret = aSecret;
+        iSecretChanged = true;
+    }
+    return *this;
+}
+
+YubiKeyToken::Builder&
+YubiKeyToken::Builder::setDigits(
+    int aDigits)
+{
+    const Private* d = data();
+
+    if (!d || d->iDigits != aDigits) {
+        edit()->iDigits = aDigits;
+    }
+    return *this;
+}
+
+YubiKeyToken::Builder&
+YubiKeyToken::Builder::setCounter(
+    int aCounter)
+{
+    const Private* d = data();
+
+    if (!d || d->iCounter != aCounter) {
+        edit()->iCounter = aCounter;
+    }
+    return *this;
+}
+
+YubiKeyToken
+YubiKeyToken::Builder::build()
+{
+    if (iEdit) {
+        if (iSecretChanged) {
+            // Encode the secret once, no matter how many times it was set
+            iEdit->iSecretBase32 = HarbourBase32::toBase32(iEdit->iSecret,
+                true);
+            iSecretChanged = false;
+        }
+        // The token takes over the reference held by the builder
+        iToken = YubiKeyToken(iEdit);
+        iEdit = Q_NULLPTR;
+    } else if (!iToken.iPrivate) {
+        // Nothing has been set, build a token with the default parameters
+        iToken = YubiKeyToken(edit());
+        iEdit = Q_NULLPTR;
     }
+    return iToken;
 }
 
 #if HARBOUR_DEBUG
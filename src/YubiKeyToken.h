@@ -65,6 +65,8 @@ public:
         MaxDigits = 8
     };
 
+    class Builder;
+
     YubiKeyToken();
     YubiKeyToken(const YubiKeyToken&);
     YubiKeyToken(YubiKeyTokenType, YubiKeyAlgorithm, const QString,
@@ -102,6 +104,39 @@ private:
     Private* iPrivate;
 };
 
+// Collects any number of changes and applies them in a single allocation.
+// The data is copied on the first actual change, unchanged fields (and the
+// base32 form of the secret, unless the secret changes) are shared with
+// the original token.
+class YubiKeyToken::Builder
+{
+    Q_DISABLE_COPY(Builder)
+
+public:
+    Builder();
+    Builder(const YubiKeyToken&);
+    ~Builder();
+
+    Builder& setType(YubiKeyTokenType);
+    Builder& setAlgorithm(YubiKeyAlgorithm);
+    Builder& setLabel(const QString);
+    Builder& setIssuer(const QString);
+    Builder& setSecret(const QByteArray);
+    Builder& setDigits(int);
+    Builder& setCounter(int);
+
+    Q_REQUIRED_RESULT YubiKeyToken build();
+
+private:
+    const Private* data() const;
+    Private* edit();
+
+private:
+    YubiKeyToken iToken;
+    Private* iEdit;
+    bool iSecretChanged;
+};
+
 // Debug output
 QDebug operator<<(QDebug, const YubiKeyToken&);
 
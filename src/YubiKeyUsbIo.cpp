@@ -39,7 +39,6 @@
 #include "YubiKeyUsbIo.h"
 
 #include "HarbourDebug.h"
-#include "HarbourUtil.h"
 
 #include <QtCore/QAtomicInt>
 #include <QtCore/QtEndian>
@@ -191,6 +190,50 @@ public:
     const int iIntfNum;
 };
 
+// ==========================================================================
+// YubiKeyUsbIo::TxRecord declaration
+//
+// Pooled completion record of a single CCID transaction. The record
+// (along with its libusb transfers and buffers) is returned to the pool
+// when both transfers complete. If YubiKeyUsbIo gets destroyed while
+// the transfers are still in flight, the record becomes an orphan and
+// deletes itself on completion.
+// ==========================================================================
+
+class YubiKeyUsbIo::TxRecord
+{
+public:
+    // Enough for any short APDU (4 header bytes + Lc + 255 + Le)
+    enum { DefaultReqBufSize = sizeof(PC_to_RDR_XfrBlock) + 261 };
+
+    TxRecord(Private*);
+    ~TxRecord();
+
+    static void dataSent(libusb_transfer*);
+    static void dataReceived(libusb_transfer*);
+
+    bool submit(const APDU&);
+    void deactivate();
+    void failed();
+    void finished(YubiKeyIoTx::Result, const QByteArray&);
+    void transferDone();
+
+public:
+    TxRecord* iNext;
+    Private* iOwner;
+    YubiKeyIoTxHandler* iHandler;
+    TxId iId;
+    int iTransfers;
+    bool iActive;
+    uchar iSeq;
+    libusb_transfer* iReq;
+    libusb_transfer* iResp;
+    uchar* iReqBuf;
+    uint iReqBufSize;
+    uchar* iRespBuf;
+    uint iRespBufSize;
+};
+
 // ==========================================================================
 // YubiKeyUsbIo::Handle
 // ==========================================================================
@@ -359,6 +402,10 @@ public:
     IoLock lock();
     void deactivate();
 
+    TxRecord* newTx(YubiKeyIoTxHandler*);
+    TxRecord* findTx(TxId) const;
+    void recycleTx(TxRecord*);
+
     template <typename T> static QByteArray byteArray(T*);
     template <typename T> static T* alloc0();
     static bool submitTransfer(libusb_transfer*);
@@ -369,6 +416,8 @@ public:
     IoState iState, iPrevState;
     Handle iHandle;
     Lock* iLock;
+    TxRecord* iFreeTx;
+    TxRecord* iPendingTx;
     int iActiveTx;
     uchar iSeq;
     uint iMaxCCIDMessageLength;
@@ -386,6 +435,8 @@ YubiKeyUsbIo::Private::Private(
     iState(IoError),
     iHandle(aContext, aDevice),
     iLock(Q_NULLPTR),
+    iFreeTx(Q_NULLPTR),
+    iPendingTx(Q_NULLPTR),
     iActiveTx(0),
     iSeq(0),
     iMaxCCIDMessageLength(0),
@@ -445,6 +496,25 @@ YubiKeyUsbIo::Private::~Private()
     if (iLock) {
         iLock->iPrivate = Q_NULLPTR;
     }
+
+    // Transfers can't be cancelled, the pending records will delete
+    // themselves when their transfers complete
+    while (iPendingTx) {
+        TxRecord* tx = iPendingTx;
+
+        iPendingTx = tx->iNext;
+        tx->iNext = Q_NULLPTR;
+        tx->iOwner = Q_NULLPTR;
+        tx->iHandler = Q_NULLPTR;
+        tx->iActive = false;
+    }
+
+    while (iFreeTx) {
+        TxRecord* tx = iFreeTx;
+
+        iFreeTx = tx->iNext;
+        delete tx;
+    }
 }
 
 void
@@ -509,6 +579,58 @@ YubiKeyUsbIo::Private::deactivate()
     }
 }
 
+YubiKeyUsbIo::TxRecord*
+YubiKeyUsbIo::Private::newTx(
+    YubiKeyIoTxHandler* aHandler)
+{
+    TxRecord* tx = iFreeTx;
+
+    if (tx) {
+        iFreeTx = tx->iNext;
+    } else {
+        tx = new TxRecord(this);
+    }
+
+    tx->iHandler = aHandler;
+    tx->iId = nextTxId();
+    tx->iSeq = iSeq++;
+    tx->iNext = iPendingTx;
+    iPendingTx = tx;
+    return tx;
+}
+
+YubiKeyUsbIo::TxRecord*
+YubiKeyUsbIo::Private::findTx(
+    TxId aId) const
+{
+    for (TxRecord* tx = iPendingTx; tx; tx = tx->iNext) {
+        if (tx->iId == aId) {
+            return tx;
+        }
+    }
+    return Q_NULLPTR;
+}
+
+void
+YubiKeyUsbIo::Private::recycleTx(
+    TxRecord* aTx)
+{
+    TxRecord** ptr = &iPendingTx;
+
+    HASSERT(!aTx->iTransfers);
+    HASSERT(!aTx->iActive);
+    while (*ptr && *ptr != aTx) {
+        ptr = &((*ptr)->iNext);
+    }
+    if (*ptr) {
+        *ptr = aTx->iNext;
+    }
+    aTx->iHandler = Q_NULLPTR;
+    aTx->iId = 0;
+    aTx->iNext = iFreeTx;
+    iFreeTx = aTx;
+}
+
 /* static */
 template <typename T>
 QByteArray
@@ -804,261 +926,165 @@ YubiKeyUsbIo::Lock::iccPowerOffResponseReceived(
 }
 
 // ==========================================================================
-// YubiKeyUsbIo::Tx
+// YubiKeyUsbIo::TxRecord
 // ==========================================================================
 
-class YubiKeyUsbIo::Tx :
-    public YubiKeyIoTx
-{
-public:
-    Tx(YubiKeyUsbIo*, const APDU&);
-    ~Tx() Q_DECL_OVERRIDE;
-
-    static void dataSent(libusb_transfer*);
-    static void dataReceived(libusb_transfer*);
-    static QByteArray encodeApdu(const APDU&);
-
-    YubiKeyUsbIo* usbIo() const;
-    void deactivate();
-    void failed();
-    void finished(Result, QByteArray);
-
-    // YubiKeyTx
-    TxState txState() const  Q_DECL_OVERRIDE;
-    void txSetAutoDelete(bool) Q_DECL_OVERRIDE;
-    void txCancel() Q_DECL_OVERRIDE;
+YubiKeyUsbIo::TxRecord::TxRecord(
+    Private* aOwner) :
+    iNext(Q_NULLPTR),
+    iOwner(aOwner),
+    iHandler(Q_NULLPTR),
+    iId(0),
+    iTransfers(0),
+    iActive(false),
+    iSeq(0),
+    iReq(libusb_alloc_transfer(0)),
+    iResp(libusb_alloc_transfer(0)),
+    iReqBuf((uchar*) malloc(DefaultReqBufSize)),
+    iReqBufSize(DefaultReqBufSize),
+    iRespBuf((uchar*) malloc(aOwner->iMaxCCIDMessageLength)),
+    iRespBufSize(aOwner->iMaxCCIDMessageLength)
+{}
 
-public:
-    TxState iState;
-    bool iActive;
-    bool iAutoDelete;
-    const uchar iSeq;
-};
+YubiKeyUsbIo::TxRecord::~TxRecord()
+{
+    HASSERT(!iTransfers);
+    libusb_free_transfer(iReq);
+    libusb_free_transfer(iResp);
+    free(iReqBuf);
+    free(iRespBuf);
+}
 
-YubiKeyUsbIo::Tx::Tx(
-    YubiKeyUsbIo* aUsb,
-    const APDU& aApdu) :
-    YubiKeyIoTx(aUsb),
-    iState(TxFailed),
-    iActive(false),
-    iAutoDelete(false),
-    iSeq(aUsb->iPrivate->iSeq++)
+bool
+YubiKeyUsbIo::TxRecord::submit(
+    const APDU& aApdu)
 {
-    Private* priv = aUsb->iPrivate;
-    libusb_transfer* resp = libusb_alloc_transfer(0);
+    // Unlike Private::submitTransfer(), this doesn't invoke the completion
+    // callback on failure. The caller takes care of the cleanup.
+    libusb_device_handle* handle = iOwner->iHandle;
+    const uint apduSize = aApdu.encodedSize();
+    int r;
+
+    if (!apduSize) {
+        HWARN("Can't encode" << aApdu.name);
+        return false;
+    }
 
-    // Tx may be deallocated before completion of the USB transfer,
-    // hence QPointer<Tx>
-    libusb_fill_bulk_transfer(resp, priv->iHandle, priv->iBulkInEp,
-        (uchar*) malloc(priv->iMaxCCIDMessageLength),
-        priv->iMaxCCIDMessageLength, dataReceived, new QPointer<Tx>(this),
-        Private::TIMEOUT_MS);
-    if (Private::submitTransfer(resp)) {
-        libusb_transfer* req = libusb_alloc_transfer(0);
-        const QByteArray apdu(encodeApdu(aApdu));
-        const uint xfrSize = sizeof(PC_to_RDR_XfrBlock) + apdu.size();
-        PC_to_RDR_XfrBlock* xfr = (PC_to_RDR_XfrBlock*) malloc(xfrSize);
+    libusb_fill_bulk_transfer(iResp, handle, iOwner->iBulkInEp, iRespBuf,
+        iRespBufSize, dataReceived, this, Private::TIMEOUT_MS);
+    if ((r = libusb_submit_transfer(iResp)) == LIBUSB_SUCCESS) {
+        const uint xfrSize = sizeof(PC_to_RDR_XfrBlock) + apduSize;
+        PC_to_RDR_XfrBlock* xfr;
+
+        iTransfers++;
+        if (iReqBufSize < xfrSize) {
+            free(iReqBuf);
+            iReqBuf = (uchar*) malloc(iReqBufSize = xfrSize);
+        }
 
+        // Encode the APDU directly into the request buffer
+        xfr = (PC_to_RDR_XfrBlock*) iReqBuf;
         memset(xfr, 0, sizeof(*xfr));
-        memcpy(xfr + 1, apdu.constData(), apdu.size());
+        aApdu.encode((uchar*)(xfr + 1));
         xfr->hdr.bMessageType = PC_to_RDR_Message_XfrBlock;
-        xfr->hdr.dwLength = TO_USB_ENDIAN((uint32_t) apdu.size());
+        xfr->hdr.dwLength = TO_USB_ENDIAN((uint32_t) apduSize);
         xfr->hdr.bSeq = iSeq;
-        libusb_fill_bulk_transfer(req, priv->iHandle, priv->iBulkOutEp,
-            (uchar*) xfr, xfrSize, dataSent, new QPointer<Tx>(this),
-            Private::TIMEOUT_MS);
-        if (Private::submitTransfer(req)) {
-            HDEBUG(aApdu.name << apdu.toHex().constData());
+        libusb_fill_bulk_transfer(iReq, handle, iOwner->iBulkOutEp, iReqBuf,
+            xfrSize, dataSent, this, Private::TIMEOUT_MS);
+        if ((r = libusb_submit_transfer(iReq)) == LIBUSB_SUCCESS) {
+            HDEBUG(aApdu.name << QByteArray((char*)(xfr + 1), apduSize).
+                toHex().constData());
             HDEBUG("USB xfr" << iSeq);
-            iState = TxPending;
-            iActive = true;
-            priv->iActiveTx++;
+            iTransfers++;
+            return true;
         }
     }
+    HWARN("USB tx error" << r);
+    return false;
 }
 
-YubiKeyUsbIo::Tx::~Tx()
+void
+YubiKeyUsbIo::TxRecord::deactivate()
 {
     if (iActive) {
-        // If the parent is being deleted, usbIo() return NULL
-        YubiKeyUsbIo* io = usbIo();
-
-        if (io) {
-            YubiKeyUsbIo::Private* priv = io->iPrivate;
-
-            iActive = false;
-            priv->deactivate();
-            priv->emitQueuedSignals();
+        iActive = false;
+        if (iOwner) {
+            iOwner->deactivate();
         }
     }
 }
 
-YubiKeyIoTx::TxState
-YubiKeyUsbIo::Tx::txState() const
-{
-    return iState;
-}
-
 void
-YubiKeyUsbIo::Tx::txCancel()
+YubiKeyUsbIo::TxRecord::failed()
 {
-    // CCID Abort functionality doesn't seem to be supported by Yubikeys :(
-    // At least by firmware versions up to and including 5.7.4
+    YubiKeyIoTxHandler* handler = iHandler;
 
-    // Control pipe ABORT followed by PC_to_RDR_Abort over the Bulk-OUT pipe
-    // results in a RDR_to_PC_SlotStatus Bulk-IN response like this:
-    //
-    // 8100000000000A400000 i.e.
-    //
-    //   bMessageType 81h        RDR_to_PC_SlotStatus
-    //   dwLength     00000000h
-    //   bSlot        00h
-    //   bSeq         0Ah
-    //   bStatus      40h        Failed
-    //   bError       00h        Command not supported
-    //   bClockStatus 00h
-    //
-    // Sounds like it's trying to tell us that the CCID Abort request is not
-    // supported.
-
-    // This is especially painful when HOTP code is being refreshed. The
-    // CALCULATE transaction may remain pending for up to 30 sec (if no one
-    // touches the key) and there seems to be no way to cancel that. And
-    // until its completion, any other request fails with XFR_OVERRUN error.
+    if (handler) {
+        iHandler = Q_NULLPTR;
+        deactivate();
+        handler->ioTxFailed(iId);
+    }
 }
 
 void
-YubiKeyUsbIo::Tx::txSetAutoDelete(
-    bool aAutoDelete)
+YubiKeyUsbIo::TxRecord::finished(
+    YubiKeyIoTx::Result aCode,
+    const QByteArray& aData)
 {
-    if (iAutoDelete != aAutoDelete) {
-        iAutoDelete = aAutoDelete;
-        if (aAutoDelete && iState != TxPending) {
-            HarbourUtil::scheduleDeleteLater(this);
-        }
-    }
-}
+    YubiKeyIoTxHandler* handler = iHandler;
 
-/* static */
-QByteArray
-YubiKeyUsbIo::Tx::encodeApdu(
-    const APDU& aApdu)
-{
-    // Command APDU encoding options (ISO/IEC 7816-4):
-    //
-    // Case 1:  |CLA|INS|P1|P2|                                n = 4
-    // Case 2s: |CLA|INS|P1|P2|LE|                             n = 5
-    // Case 3s: |CLA|INS|P1|P2|LC|...BODY...|                  n = 6..260
-    // Case 4s: |CLA|INS|P1|P2|LC|...BODY...|LE|               n = 7..261
-    // Case 2e: |CLA|INS|P1|P2|00|LE1|LE2|                     n = 7
-    // Case 3e: |CLA|INS|P1|P2|00|LC1|LC2|...BODY...|          n = 8..65542
-    // Case 4e: |CLA|INS|P1|P2|00|LC1|LC2|...BODY...|LE1|LE2|  n = 10..65544
-    //
-    // LE, LE1, LE2 may be 0x00, 0x00|0x00 (means the maximum, 256 or 65536)
-    // LC must not be 0x00 and LC1|LC2 must not be 0x00|0x00
-
-    QByteArray out;
-    const int n = aApdu.data.size();
-
-    if (n <= 0xffff && aApdu.le <= 0x10000) {
-        out.reserve(4);
-        out.append(aApdu.cla);
-        out.append(aApdu.ins);
-        out.append(aApdu.p1);
-        out.append(aApdu.p2);
-        if (n > 0) {
-            if (n <= 0xff) {
-                /* Cases 3s and 4s */
-                out.append((char) n);
-            } else {
-                /* Cases 3e and 4e */
-                out.append('\0');
-                out.append((char) (n >> 8));
-                out.append((char) n);
-            }
-            out.append(aApdu.data);
-        }
-        if (aApdu.le > 0) {
-            if (aApdu.le <= 0x100 && n <= 0xff) {
-                /* Cases 2s and 4s */
-                out.append((aApdu.le == 0x100) ? '\0' : ((char) aApdu.le));
-            } else {
-                /* Cases 4e and 2e */
-                char le[2];
-
-                if (aApdu.le == 0x10000) {
-                    le[0] = le[1] = 0;
-                } else {
-                    le[0] = (char) (aApdu.le >> 8);
-                    le[1] = (char) aApdu.le;
-                }
-                if (!n) {
-                    /* Case 2e */
-                    out.append('\0');
-                }
-                out.append(le, sizeof(le));
-            }
-        }
+    if (handler) {
+        iHandler = Q_NULLPTR;
+        deactivate();
+        handler->ioTxFinished(iId, aCode, aData);
     }
-    return out;
-}
-
-inline
-YubiKeyUsbIo*
-YubiKeyUsbIo::Tx::usbIo() const
-{
-    return qobject_cast<YubiKeyUsbIo*>(parent());
 }
 
 void
-YubiKeyUsbIo::Tx::deactivate()
+YubiKeyUsbIo::TxRecord::transferDone()
 {
-    if (iActive) {
-        YubiKeyUsbIo::Private* priv = usbIo()->iPrivate;
-
-        iActive = false;
-        priv->deactivate();
-        priv->emitQueuedSignals();
-        if (iAutoDelete) {
-            HarbourUtil::scheduleDeleteLater(this);
+    HASSERT(iTransfers > 0);
+    if (!--iTransfers) {
+        deactivate();
+        if (iOwner) {
+            Private* owner = iOwner;
+
+            owner->recycleTx(this);
+            owner->emitQueuedSignals();
+        } else {
+            delete this;
         }
+    } else if (iOwner) {
+        iOwner->emitQueuedSignals();
     }
 }
 
 /* static */
 void
-YubiKeyUsbIo::Tx::dataSent(
+YubiKeyUsbIo::TxRecord::dataSent(
     libusb_transfer* aTransfer)
 {
-    QPointer<Tx>* ptr = (QPointer<Tx>*) aTransfer->user_data;
-    Tx* self = ptr->data();
+    TxRecord* self = (TxRecord*) aTransfer->user_data;
 
-    // Tx may be deallocated by now
-    if (self) {
-        if (aTransfer->status == LIBUSB_TRANSFER_COMPLETED) {
-            HDEBUG("USB req" << self->iSeq << "sent");
-        } else {
-            HWARN("USB req" << self->iSeq << "failed," <<
-                libusb_error_name(aTransfer->status));
-            self->failed();
-        }
+    if (aTransfer->status == LIBUSB_TRANSFER_COMPLETED) {
+        HDEBUG("USB req" << self->iSeq << "sent");
+    } else {
+        HWARN("USB req" << self->iSeq << "failed," <<
+            libusb_error_name(aTransfer->status));
+        self->failed();
     }
-
-    delete ptr;
-    free(aTransfer->buffer);
-    libusb_free_transfer(aTransfer);
+    self->transferDone();
 }
 
 /* static */
 void
-YubiKeyUsbIo::Tx::dataReceived(
+YubiKeyUsbIo::TxRecord::dataReceived(
     libusb_transfer* aTransfer)
 {
-    QPointer<Tx>* ptr = (QPointer<Tx>*) aTransfer->user_data;
-    Tx* self = ptr->data();
+    TxRecord* self = (TxRecord*) aTransfer->user_data;
 
-    // Tx may be deallocated by now
-    if (self) {
+    // The handler may be gone by now
+    if (self->iHandler) {
         bool ok = false;
         const uint len = aTransfer->actual_length;
         const RDR_to_PC_MsgHeader* msg = (RDR_to_PC_MsgHeader*)
@@ -1073,8 +1099,9 @@ YubiKeyUsbIo::Tx::dataReceived(
                 // Resubmit the transfer
                 HWARN("Ignoring USB msg" << QByteArray((char*)msg, len).
                     toHex().constData());
-                Private::submitTransfer(aTransfer);
-                return;
+                if (libusb_submit_transfer(aTransfer) == LIBUSB_SUCCESS) {
+                    return;
+                }
             } else if (msg->bMessageType == RDR_to_PC_Message_DataBlock &&
                 len >= (datalen + sizeof(RDR_to_PC_DataBlock))) {
                 if (!datalen && (msg->bStatus & CCID_COMMAND_STATUS_MASK) ==
@@ -1082,15 +1109,16 @@ YubiKeyUsbIo::Tx::dataReceived(
                     // Time extension, resubmit the transfer
                     HDEBUG("Time extension" <<
                         QByteArray((char*)msg, len).toHex().constData());
-                    Private::submitTransfer(aTransfer);
-                    return;
+                    if (libusb_submit_transfer(aTransfer) == LIBUSB_SUCCESS) {
+                        return;
+                    }
                 } else if (datalen >= 2) {
                     const RDR_to_PC_DataBlock* db = (RDR_to_PC_DataBlock*) msg;
                     const uchar* buf = (uchar*)(db + 1);
                     // Split R-APDU into data and status
                     const QByteArray data((char*) buf, datalen - 2);
-                    const Result code(((uint)(buf[datalen - 2]) << 8) |
-                        buf[datalen - 1]);
+                    const YubiKeyIoTx::Result code(((uint)(buf[datalen - 2])
+                        << 8) | buf[datalen - 1]);
 
                     HDEBUG("USB xfr" << self->iSeq << "ok" <<
                         QByteArray((char*)msg, len).toHex().constData());
@@ -1109,33 +1137,8 @@ YubiKeyUsbIo::Tx::dataReceived(
             }
             self->failed();
         }
-
-        self->deactivate();
-    }
-
-    delete ptr;
-    free(aTransfer->buffer);
-    libusb_free_transfer(aTransfer);
-}
-
-void
-YubiKeyUsbIo::Tx::failed()
-{
-    if (iState == TxPending) {
-        iState = TxFailed;
-        Q_EMIT txFailed();
-    }
-}
-
-void
-YubiKeyUsbIo::Tx::finished(
-    Result aCode,
-    QByteArray aData)
-{
-    if (iState == TxPending) {
-        iState = TxFinished;
-        Q_EMIT txFinished(aCode, aData);
     }
+    self->transferDone();
 }
 
 // ==========================================================================
@@ -1190,20 +1193,76 @@ YubiKeyUsbIo::ioLock()
     return lock;
 }
 
-YubiKeyIoTx*
-YubiKeyUsbIo::ioTransmit(
-    const APDU& aApdu)
+YubiKeyIo::TxId
+YubiKeyUsbIo::ioSubmit(
+    const APDU& aApdu,
+    YubiKeyIoTxHandler* aHandler)
 {
-    YubiKeyIoTx* tx = new Tx(this, aApdu);
+    Private* priv = iPrivate;
 
-    if (tx->txState() == YubiKeyIoTx::TxFailed) {
-        // We have failed to actually submit USB transaction, drop this tx
-        delete tx;
-        return Q_NULLPTR;
-    } else {
-        iPrivate->setState(IoActive);
+    if (priv->iHandle) {
+        TxRecord* tx = priv->newTx(aHandler);
+
+        if (tx->submit(aApdu)) {
+            tx->iActive = true;
+            priv->iActiveTx++;
+            priv->setState(IoActive);
+            priv->emitQueuedSignals();
+            return tx->iId;
+        }
+
+        // We have failed to actually submit USB transaction. If the
+        // response transfer has been submitted, the record gets recycled
+        // when it completes.
+        tx->iHandler = Q_NULLPTR;
+        if (!tx->iTransfers) {
+            priv->recycleTx(tx);
+        }
+    }
+    return 0;
+}
+
+void
+YubiKeyUsbIo::ioCancel(
+    TxId)
+{
+    // CCID Abort functionality doesn't seem to be supported by Yubikeys :(
+    // At least by firmware versions up to and including 5.7.4
+
+    // Control pipe ABORT followed by PC_to_RDR_Abort over the Bulk-OUT pipe
+    // results in a RDR_to_PC_SlotStatus Bulk-IN response like this:
+    //
+    // 8100000000000A400000 i.e.
+    //
+    //   bMessageType 81h        RDR_to_PC_SlotStatus
+    //   dwLength     00000000h
+    //   bSlot        00h
+    //   bSeq         0Ah
+    //   bStatus      40h        Failed
+    //   bError       00h        Command not supported
+    //   bClockStatus 00h
+    //
+    // Sounds like it's trying to tell us that the CCID Abort request is not
+    // supported.
+
+    // This is especially painful when HOTP code is being refreshed. The
+    // CALCULATE transaction may remain pending for up to 30 sec (if no one
+    // touches the key) and there seems to be no way to cancel that. And
+    // until its completion, any other request fails with XFR_OVERRUN error.
+}
+
+void
+YubiKeyUsbIo::ioRelease(
+    TxId aId)
+{
+    TxRecord* tx = aId ? iPrivate->findTx(aId) : Q_NULLPTR;
+
+    if (tx && tx->iHandler) {
+        // The transaction can't be cancelled (see above), just make sure
+        // that the handler doesn't get invoked.
+        tx->iHandler = Q_NULLPTR;
+        tx->deactivate();
         iPrivate->emitQueuedSignals();
-        return tx;
     }
 }
 
@@ -44,7 +44,6 @@
 #include "YubiKeyUtil.h"
 #include "YubiKeyConstants.h"
 
-#include "HarbourBase32.h"
 #include "HarbourDebug.h"
 
 #include <QtCore/QCryptographicHash>
@@ -142,7 +141,66 @@ public:
     static QList<YubiKeyAlgorithm> allAlgorithms();
     static QDir configRootDir();
     static bool isHexString(const QString&);
+
+    // Base32 character classes. Values below 32 are the data bits
+    enum Base32Code {
+        Base32Data = 0x1f,
+        Base32Pad = 0x20,
+        Base32Space = 0x40,
+        Base32Invalid = 0x80
+    };
+
+    static const uchar BASE32_CODES[256];
+    static inline uint base32Code(char aChar)
+        { return BASE32_CODES[(uchar)aChar]; }
+    static inline uint base32Code(QChar aChar)
+        { return aChar.unicode() < 0x100 ?
+            BASE32_CODES[aChar.unicode()] : Base32Invalid; }
+
+    template<typename C> static int decodeBase32(const C*, int, uchar*);
+    template<typename C> static QByteArray fromBase32(const C*, int);
+};
+
+#define X YubiKeyUtil::Private::Base32Invalid
+#define S YubiKeyUtil::Private::Base32Space
+#define P YubiKeyUtil::Private::Base32Pad
+const uchar YubiKeyUtil::Private::BASE32_CODES[256] = {
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    S,    S,    X,    X,    S,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       S,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+       X,    X,    X,    X,    X,    P,    X,    X,
+       X, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+    0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+    0x17, 0x18, 0x19,    X,    X,    X,    X,    X,
+       X, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+    0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+    0x17, 0x18, 0x19,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X,
+       X,    X,    X,    X,    X,    X,    X,    X
 };
+#undef X
+#undef S
+#undef P
 
 QList<YubiKeyAlgorithm>
 YubiKeyUtil::Private::allAlgorithms()
@@ -183,6 +241,104 @@ YubiKeyUtil::Private::isHexString(
     return false;
 }
 
+// Validates and decodes base32 in a single pass, without any intermediate
+// strings. Both cases are accepted, whitespace is ignored and the padding
+// is optional. Returns the number of decoded bytes or -1 if the input is
+// invalid. With aOut being NULL, the input is only being validated.
+template<typename C>
+int
+YubiKeyUtil::Private::decodeBase32(
+    const C* aChars,
+    int aLen,
+    uchar* aOut)
+{
+    const C* ptr = aChars;
+    const C* end = aChars + aLen;
+    quint64 acc = 0;
+    int bits = 0;
+    int n = 0;
+    bool pad = false;
+
+    while (ptr < end) {
+        if (!pad && (end - ptr) >= 8) {
+            // Fast path: 8 data characters give exactly 5 bytes
+            const uint c0 = base32Code(ptr[0]);
+            const uint c1 = base32Code(ptr[1]);
+            const uint c2 = base32Code(ptr[2]);
+            const uint c3 = base32Code(ptr[3]);
+            const uint c4 = base32Code(ptr[4]);
+            const uint c5 = base32Code(ptr[5]);
+            const uint c6 = base32Code(ptr[6]);
+            const uint c7 = base32Code(ptr[7]);
+
+            if (!((c0 | c1 | c2 | c3 | c4 | c5 | c6 | c7) & ~Base32Data)) {
+                acc = (acc << 40) |
+                    ((quint64)c0 << 35) | ((quint64)c1 << 30) |
+                    ((quint64)c2 << 25) | ((quint64)c3 << 20) |
+                    ((quint64)c4 << 15) | ((quint64)c5 << 10) |
+                    ((quint64)c6 << 5) | c7;
+                bits += 40;
+                ptr += 8;
+                if (aOut) {
+                    while (bits >= 8) {
+                        bits -= 8;
+                        aOut[n++] = (uchar)(acc >> bits);
+                    }
+                } else {
+                    n += bits / 8;
+                    bits %= 8;
+                }
+                continue;
+            }
+        }
+
+        // Slow path: whitespace, padding or the tail of the input
+        const uint c = base32Code(*ptr++);
+
+        if (c & Base32Invalid) {
+            return -1;
+        } else if (c & Base32Pad) {
+            pad = true;
+        } else if (!(c & Base32Space)) {
+            if (pad) {
+                // Data after padding
+                return -1;
+            }
+            acc = (acc << 5) | c;
+            bits += 5;
+            if (bits >= 8) {
+                bits -= 8;
+                if (aOut) {
+                    aOut[n] = (uchar)(acc >> bits);
+                }
+                n++;
+            }
+        }
+    }
+
+    // RFC 4648 never leaves 5 or more bits over, i.e. 1, 3 or 6 data
+    // characters in the last group means that the input is truncated
+    return (bits < 5) ? n : -1;
+}
+
+template<typename C>
+QByteArray
+YubiKeyUtil::Private::fromBase32(
+    const C* aChars,
+    int aLen)
+{
+    QByteArray out;
+
+    // Every character carries at most 5 bits
+    out.resize(aLen * 5 / 8);
+    const int n = decodeBase32(aChars, aLen, (uchar*)out.data());
+    if (n > 0) {
+        out.resize(n);
+        return out;
+    }
+    return QByteArray();
+}
+
 // ==========================================================================
 // YubiKeyUtil
 // ==========================================================================
@@ -192,6 +348,12 @@ const QString YubiKeyUtil::ALGORITHM_SHA256("SHA256");
 const QString YubiKeyUtil::ALGORITHM_SHA512("SHA512");
 const QList<YubiKeyAlgorithm> YubiKeyUtil::AllAlgorithms(Private::allAlgorithms());
 
+QDir
+YubiKeyUtil::configRootDir()
+{
+    return Private::configRootDir();
+}
+
 QDir
 YubiKeyUtil::configDir(
     const QByteArray& aYubiKeyId)
@@ -439,11 +601,46 @@ YubiKeyUtil::randomAuthChallenge()
     return toByteArray(foil_random_bytes(YubiKeyConstants::CHALLENGE_LEN));
 }
 
+void
+YubiKeyUtil::wipe(
+    QByteArray* aData)
+{
+    // Zeroes the key material in place before the memory is released.
+    // Going through data() would detach a shared array and only zero
+    // the fresh copy, so the caller must make sure that the buffer is
+    // not shared with anyone who still needs it. The volatile pointer
+    // keeps the compiler from dropping the stores to the memory which
+    // is about to be freed.
+    if (!aData->isEmpty()) {
+        volatile char* ptr = const_cast<char*>(aData->constData());
+
+        for (int i = aData->size(); i > 0; i--) {
+            *ptr++ = 0;
+        }
+        aData->clear();
+    }
+}
+
+QByteArray
+YubiKeyUtil::fromBase32(
+    const QString& aBase32)
+{
+    return Private::fromBase32(aBase32.constData(), aBase32.length());
+}
+
+QByteArray
+YubiKeyUtil::fromBase32(
+    const QByteArray& aBase32)
+{
+    return Private::fromBase32(aBase32.constData(), aBase32.size());
+}
+
 bool
 YubiKeyUtil::isValidBase32(
     const QString& aBase32)
 {
-    return HarbourBase32::isValidBase32(aBase32);
+    return Private::decodeBase32(aBase32.constData(), aBase32.length(),
+        Q_NULLPTR) > 0;
 }
 
 QObject*
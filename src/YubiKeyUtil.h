@@ -80,6 +80,7 @@ public:
     static const QString ALGORITHM_SHA512;
     static const QList<YubiKeyAlgorithm> AllAlgorithms;
 
+    static QDir configRootDir();
     static QDir configDir(const QByteArray&);
     static QList<QDir> configDirs();
 
@@ -118,7 +119,10 @@ public:
     static YubiKeyTokenType validType(int);
 
     static QByteArray randomAuthChallenge();
+    static void wipe(QByteArray*);
 
+    static QByteArray fromBase32(const QString&);
+    static QByteArray fromBase32(const QByteArray&);
     Q_INVOKABLE static bool isValidBase32(const QString&);
 
     // Callback for qmlRegisterSingletonType<YubiKeyUtil>
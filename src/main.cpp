@@ -51,6 +51,7 @@
 #include "YubiKeyToken.h"
 #include "YubiKeyUtil.h"
 
+#include "QrCodeImageDecoder.h"
 #include "QrCodeScanner.h"
 
 #include "NfcAdapter.h"
@@ -65,7 +66,9 @@
 
 #include <sailfishapp.h>
 
+#include <QtCore/QEventLoop>
 #include <QtCore/QScopedPointer>
+#include <QtCore/QTextStream>
 #include <QtGui/QGuiApplication>
 #include <QtQuick>
 
@@ -93,6 +96,7 @@ static void register_types(const char* uri, int v1 = 1, int v2 = 0)
     REGISTER_TYPE(uri, v1, v2, YubiKeyNdefHandler);
     REGISTER_TYPE(uri, v1, v2, YubiKeyOpTracker);
     REGISTER_TYPE(uri, v1, v2, YubiKeyOtpListModel);
+    REGISTER_TYPE(uri, v1, v2, QrCodeImageDecoder);
     REGISTER_TYPE(uri, v1, v2, QrCodeScanner);
     REGISTER_UNCREATABLE_TYPE(uri, v1, v2, YubiKeyIo);
 
@@ -102,8 +106,43 @@ static void register_types(const char* uri, int v1 = 1, int v2 = 0)
     qRegisterMetaType<QList<YubiKeyToken> >();
 }
 
+// Decodes QR codes from the image files and prints what's going to be
+// imported. No secrets are printed. Returns zero if anything was found.
+static int decode_files(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    YubiKeyImportModel model;
+    QStringList uris;
+
+    for (int i = 2; i < argc; i++) {
+        uris.append(QrCodeImageDecoder::decodeFileSync(QString::
+            fromLocal8Bit(argv[i])));
+    }
+
+    model.setOtpUris(uris);
+    if (model.parsing()) {
+        QEventLoop loop;
+
+        QObject::connect(&model, SIGNAL(parsingFinished()), &loop, SLOT(quit()));
+        loop.exec();
+    }
+    for (int i = 0; i < model.rowCount(); i++) {
+        const QVariantMap token(model.getToken(i));
+        const QString issuer(token.value("issuer").toString());
+        const QString label(token.value("label").toString());
+
+        out << (issuer.isEmpty() ? label : (issuer + ':' + label)) << endl;
+    }
+    return model.rowCount() ? 0 : 1;
+}
+
 int main(int argc, char *argv[])
 {
+    if (argc > 2 && !strcmp(argv[1], "--decode")) {
+        return decode_files(argc, argv);
+    }
+
     QScopedPointer<QCoreApplication> app(SailfishApp::application(argc, argv));
 
     app->setApplicationName(YUBIKEY_APP_NAME);
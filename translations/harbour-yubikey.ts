@@ -308,6 +308,11 @@
         <extracomment>Page title (suggestion to scan QR code)</extracomment>
         <translation>Scan QR code</translation>
     </message>
+    <message id="yubikey-scan-batch_progress">
+        <source>Scanned %1 of %2</source>
+        <extracomment>Page title (progress of scanning a multi-part export)</extracomment>
+        <translation>Scanned %1 of %2</translation>
+    </message>
     <message id="yubikey-scan-zoom_label">
         <source>Zoom</source>
         <extracomment>Slider label</extracomment>
@@ -333,6 +338,16 @@
         <extracomment>Dialog title</extracomment>
         <translation>Select tokens</translation>
     </message>
+    <message id="yubikey-select_dialog-duplicate_on_yubikey">
+        <source>already on YubiKey</source>
+        <extracomment>Import list item suffix (a token with this name is already on the YubiKey)</extracomment>
+        <translation>already on YubiKey</translation>
+    </message>
+    <message id="yubikey-select_dialog-duplicate_in_list">
+        <source>duplicate name</source>
+        <extracomment>Import list item suffix (another token in the list has the same name)</extracomment>
+        <translation>duplicate name</translation>
+    </message>
     <message id="yubikey-confirm_password-back-button">
         <source>Back</source>
         <extracomment>Button label (confirm password)</extracomment>